@@ -1,13 +1,16 @@
 #include "Anim.h"
 #include "SpriteEffect.h"
+#include <algorithm>
+#include <cassert>
 
 Anim::Anim( int x,int y,int width,int height,int count,
 	const Surface& sheet,float holdTime,Color chroma )
 	:
+	chroma( chroma ),
 	sprite( sheet ),
-	holdTime( holdTime ),
-	chroma( chroma )
+	holdTimes( count,holdTime )
 {
+	assert( holdTime > 0.0f );
 	for( int i = 0; i < count; ++i )
 	{
 		frames.emplace_back( x + i * width,
@@ -15,11 +18,23 @@ Anim::Anim( int x,int y,int width,int height,int count,
 	}
 }
 
+Anim::Anim( const std::vector<RectI>& frames,const std::vector<float>& holdTimes,
+	const Surface& sheet,Color chroma )
+	:
+	chroma( chroma ),
+	sprite( sheet ),
+	frames( frames ),
+	holdTimes( holdTimes )
+{
+	assert( frames.size() == holdTimes.size() );
+	assert( std::all_of( holdTimes.begin(),holdTimes.end(),
+		[]( float t ) { return( t > 0.0f ); } ) );
+}
+
 Anim::Anim( const Anim& other )
 	:
 	chroma( other.chroma ),
-	sprite( other.sprite ),
-	holdTime( other.holdTime )
+	sprite( other.sprite )
 {
 	*this = other;
 }
@@ -29,16 +44,25 @@ Anim& Anim::operator=( const Anim& other )
 	iCurFrame = other.iCurFrame;
 	curFrameTime = other.curFrameTime;
 	frames = other.frames;
+	holdTimes = other.holdTimes;
+	playback = other.playback;
+	direction = other.direction;
 	return( *this );
 }
 
 void Anim::Update( float dt )
 {
 	curFrameTime += dt;
-	while( curFrameTime >= holdTime )
+	while( curFrameTime >= holdTimes[iCurFrame] )
 	{
+		// The last frame stays up for good.
+		if( IsDone() )
+		{
+			curFrameTime = 0.0f;
+			break;
+		}
+		curFrameTime -= holdTimes[iCurFrame];
 		Advance();
-		curFrameTime -= holdTime;
 	}
 }
 
@@ -56,9 +80,51 @@ void Anim::Draw( const Vec2& pos,Graphics& gfx,const RectI& clip ) const
 		SpriteEffect::Chroma{ chroma } );
 }
 
+void Anim::SetPlayback( Playback playback )
+{
+	this->playback = playback;
+	direction = 1;
+}
+
+int Anim::GetFrame() const
+{
+	return( iCurFrame );
+}
+
+void Anim::SetFrame( int frame )
+{
+	assert( frame >= 0 && frame < GetFrameCount() );
+	iCurFrame = frame;
+	curFrameTime = 0.0f;
+}
+
+int Anim::GetFrameCount() const
+{
+	return( int( frames.size() ) );
+}
+
+float Anim::GetTimeLeft() const
+{
+	return( std::max( 0.0f,holdTimes[iCurFrame] - curFrameTime ) );
+}
+
+bool Anim::IsDone() const
+{
+	return( playback == Playback::Once && iCurFrame == GetFrameCount() - 1 );
+}
+
 void Anim::Advance()
 {
-	if( ++iCurFrame >= frames.size() )
+	if( playback == Playback::PingPong && frames.size() > 1 )
+	{
+		if( iCurFrame + direction < 0 ||
+			iCurFrame + direction >= int( frames.size() ) )
+		{
+			direction = -direction;
+		}
+		iCurFrame += direction;
+	}
+	else if( ++iCurFrame >= int( frames.size() ) )
 	{
 		iCurFrame = 0;
 	}
@@ -6,14 +6,35 @@
 
 class Anim
 {
+public:
+	// What happens after the last frame.
+	enum class Playback
+	{
+		Loop,
+		PingPong,
+		Once
+	};
 public:
 	Anim( int x,int y,int width,int height,int count,const Surface& sheet,float holdTime,Color chroma = Colors::Magenta );
+	// Each frame stays up for its own hold time.
+	Anim( const std::vector<RectI>& frames,const std::vector<float>& holdTimes,
+		const Surface& sheet,Color chroma = Colors::Magenta );
 	Anim( const Anim& other );
 	Anim& operator=( const Anim& other );
 
 	void Update( float dt );
 	void Draw( const Vec2& pos,Graphics& gfx ) const;
 	void Draw( const Vec2& pos,Graphics& gfx,const RectI& clip ) const;
+
+	void SetPlayback( Playback playback );
+	int GetFrame() const;
+	// Starts frame from the beginning of its hold time.
+	void SetFrame( int frame );
+	int GetFrameCount() const;
+	// Seconds until Update moves to the next frame.
+	float GetTimeLeft() const;
+	// Playing once and already on the last frame.
+	bool IsDone() const;
 private:
 	void Advance();
 private:
@@ -21,6 +42,9 @@ private:
 	const Surface& sprite;
 	std::vector<RectI> frames;
 	int iCurFrame = 0;
-	const float holdTime;
+	std::vector<float> holdTimes;
 	float curFrameTime = 0.0f;
+	Playback playback = Playback::Loop;
+	// Ping pong flips this at either end.
+	int direction = 1;
 };
\ No newline at end of file
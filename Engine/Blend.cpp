@@ -0,0 +1,289 @@
+#include "Blend.h"
+#include "BlendKernels.h"
+#include <algorithm>
+#include <cstdlib>
+
+#ifdef AESC_BLEND_X86
+#include <emmintrin.h>
+#if defined( _MSC_VER )
+#include <intrin.h>
+#endif
+#endif
+
+namespace
+{
+	int Div255( int x )
+	{
+		x += 128;
+		return( ( x + ( x >> 8 ) ) >> 8 );
+	}
+
+	// Scalar twin of BlendKernels::Blend16, keep the two in step.
+	int BlendChannel( int cs,int as,int cb,int ab,BlendMode mode )
+	{
+		switch( mode )
+		{
+		case BlendMode::Normal:
+			return( cs + Div255( cb * ( 255 - as ) ) );
+		case BlendMode::Add:
+			return( cs + cb );
+		case BlendMode::Screen:
+			return( std::max( 0,cs + cb - Div255( cs * cb ) ) );
+		default:
+			break;
+		}
+
+		const int base = Div255( cs * ( 255 - ab ) ) +
+			Div255( cb * ( 255 - as ) );
+		const int prod = Div255( cs * cb );
+		if( mode == BlendMode::Multiply ) return( base + prod );
+
+		if( cb + cb > ab )
+		{
+			const int inv = Div255( std::max( 0,ab - cb ) *
+				std::max( 0,as - cs ) );
+			return( base + std::max( 0,Div255( as * ab ) - inv - inv ) );
+		}
+		return( base + prod + prod );
+	}
+
+#ifdef AESC_BLEND_X86
+	struct SSE2
+	{
+		typedef __m128i Reg;
+		static constexpr int nPixels = 4;
+
+		static Reg Load( const Color* p )
+		{
+			return( _mm_loadu_si128( reinterpret_cast< const __m128i* >( p ) ) );
+		}
+		static void Store( Color* p,Reg x )
+		{
+			_mm_storeu_si128( reinterpret_cast< __m128i* >( p ),x );
+		}
+		static Reg Set16( short v ) { return( _mm_set1_epi16( v ) ); }
+		static Reg Set32( unsigned int v ) { return( _mm_set1_epi32( int( v ) ) ); }
+		static Reg UnpackLo( Reg x ) { return( _mm_unpacklo_epi8( x,_mm_setzero_si128() ) ); }
+		static Reg UnpackHi( Reg x ) { return( _mm_unpackhi_epi8( x,_mm_setzero_si128() ) ); }
+		static Reg Pack( Reg lo,Reg hi ) { return( _mm_packus_epi16( lo,hi ) ); }
+		static Reg Add16( Reg a,Reg b ) { return( _mm_add_epi16( a,b ) ); }
+		static Reg Sub16( Reg a,Reg b ) { return( _mm_sub_epi16( a,b ) ); }
+		static Reg SubSat16( Reg a,Reg b ) { return( _mm_subs_epu16( a,b ) ); }
+		static Reg Mul16( Reg a,Reg b ) { return( _mm_mullo_epi16( a,b ) ); }
+		static Reg Shr8( Reg x ) { return( _mm_srli_epi16( x,8 ) ); }
+		static Reg CmpGt16( Reg a,Reg b ) { return( _mm_cmpgt_epi16( a,b ) ); }
+		static Reg CmpEq32( Reg a,Reg b ) { return( _mm_cmpeq_epi32( a,b ) ); }
+		static Reg And( Reg a,Reg b ) { return( _mm_and_si128( a,b ) ); }
+		// ~a & b
+		static Reg AndNot( Reg a,Reg b ) { return( _mm_andnot_si128( a,b ) ); }
+		static Reg Or( Reg a,Reg b ) { return( _mm_or_si128( a,b ) ); }
+		static Reg SubSat8( Reg a,Reg b ) { return( _mm_subs_epu8( a,b ) ); }
+		static Reg Sub32( Reg a,Reg b ) { return( _mm_sub_epi32( a,b ) ); }
+		static int Sum32( Reg x )
+		{
+			const Reg pair = _mm_add_epi32( x,_mm_shuffle_epi32( x,0x4E ) );
+			return( _mm_cvtsi128_si32( _mm_add_epi32( pair,_mm_shuffle_epi32( pair,0xB1 ) ) ) );
+		}
+		static Reg BroadcastAlpha( Reg x )
+		{
+			return( _mm_shufflehi_epi16( _mm_shufflelo_epi16( x,0xFF ),0xFF ) );
+		}
+	};
+
+	int CompositeSpanSSE2( Color* dst,const Color* src,int count,
+		BlendMode mode,Color chroma,unsigned char opacity )
+	{
+		return( BlendKernels::CompositeSpan<SSE2>( dst,src,count,
+			mode,chroma,opacity ) );
+	}
+
+	int ReplaceSpanSSE2( Color* dst,int count,Color from,Color to,
+		int tolerance,int& changed )
+	{
+		return( BlendKernels::ReplaceSpan<SSE2>( dst,count,from,to,
+			tolerance,changed ) );
+	}
+
+	int UnderSpanSSE2( Color* dst,const Color* src,int count )
+	{
+		return( BlendKernels::UnderSpan<SSE2>( dst,src,count ) );
+	}
+
+	bool CpuHasAVX2()
+	{
+#if defined( _MSC_VER )
+		int info[4];
+		__cpuid( info,0 );
+		if( info[0] < 7 ) return( false );
+		__cpuid( info,1 );
+		const bool osxsave = ( info[2] & ( 1 << 27 ) ) != 0;
+		const bool avx = ( info[2] & ( 1 << 28 ) ) != 0;
+		// Make sure the os saves ymm registers too.
+		if( !osxsave || !avx || ( _xgetbv( 0 ) & 6 ) != 6 ) return( false );
+		__cpuidex( info,7,0 );
+		return( ( info[1] & ( 1 << 5 ) ) != 0 );
+#else
+		return( __builtin_cpu_supports( "avx2" ) != 0 );
+#endif
+	}
+#endif
+
+	typedef int( *SpanKernel )( Color*,const Color*,int,BlendMode,Color,unsigned char );
+	typedef int( *ReplaceKernel )( Color*,int,Color,Color,int,int& );
+	typedef int( *UnderKernel )( Color*,const Color*,int );
+
+	struct KernelChoice
+	{
+		KernelChoice()
+		{
+#ifdef AESC_BLEND_X86
+			if( CpuHasAVX2() )
+			{
+				kernel = BlendKernels::CompositeSpanAVX2;
+				replace = BlendKernels::ReplaceSpanAVX2;
+				under = BlendKernels::UnderSpanAVX2;
+				name = "avx2";
+			}
+			else
+			{
+				kernel = CompositeSpanSSE2;
+				replace = ReplaceSpanSSE2;
+				under = UnderSpanSSE2;
+				name = "sse2";
+			}
+#endif
+		}
+		SpanKernel kernel = nullptr;
+		ReplaceKernel replace = nullptr;
+		UnderKernel under = nullptr;
+		const char* name = "scalar";
+	};
+
+	const KernelChoice& GetKernel()
+	{
+		static const KernelChoice choice;
+		return( choice );
+	}
+}
+
+void Blend::CompositeSpan( Color* dst,const Color* src,int count,
+	BlendMode mode,unsigned char opacity,Color chroma )
+{
+	if( opacity == 0 ) return;
+
+	const auto& choice = GetKernel();
+	int i = 0;
+	if( choice.kernel != nullptr )
+	{
+		i = choice.kernel( dst,src,count,mode,chroma,opacity );
+	}
+	for( ; i < count; ++i )
+	{
+		if( src[i] != chroma )
+		{
+			dst[i] = CompositePixel( dst[i],src[i],mode,opacity );
+		}
+	}
+}
+
+bool Blend::IsNear( Color c,Color target,int tolerance )
+{
+	if( tolerance == 0 ) return( c == target );
+	return( std::abs( int( c.GetR() ) - int( target.GetR() ) ) <= tolerance &&
+		std::abs( int( c.GetG() ) - int( target.GetG() ) ) <= tolerance &&
+		std::abs( int( c.GetB() ) - int( target.GetB() ) ) <= tolerance );
+}
+
+int Blend::ReplaceSpan( Color* dst,int count,Color from,Color to,int tolerance )
+{
+	const auto& choice = GetKernel();
+	int changed = 0;
+	int i = 0;
+	if( choice.replace != nullptr )
+	{
+		i = choice.replace( dst,count,from,to,tolerance,changed );
+	}
+	for( ; i < count; ++i )
+	{
+		if( dst[i] != to && IsNear( dst[i],from,tolerance ) )
+		{
+			dst[i] = to;
+			++changed;
+		}
+	}
+	return( changed );
+}
+
+void Blend::UnderSpan( Color* dst,const Color* src,int count )
+{
+	const auto& choice = GetKernel();
+	int i = 0;
+	if( choice.under != nullptr ) i = choice.under( dst,src,count );
+
+	typedef unsigned char uchar;
+	for( ; i < count; ++i )
+	{
+		const int inv = 255 - dst[i].GetA();
+		const auto channel = [inv]( int d,int s )
+		{
+			return( uchar( std::min( 255,d + Div255( s * inv ) ) ) );
+		};
+		dst[i] = Color{ channel( dst[i].GetA(),src[i].GetA() ),
+			channel( dst[i].GetR(),src[i].GetR() ),
+			channel( dst[i].GetG(),src[i].GetG() ),
+			channel( dst[i].GetB(),src[i].GetB() ) };
+	}
+}
+
+Color Blend::CompositePixel( Color dst,Color src,BlendMode mode,
+	unsigned char alpha )
+{
+	const int as = alpha;
+	const int ab = dst.GetA();
+	typedef unsigned char uchar;
+	const auto channel = [&]( int s,int b )
+	{
+		return( uchar( std::min( 255,
+			BlendChannel( Div255( s * as ),as,b,ab,mode ) ) ) );
+	};
+	return( Color{ channel( 255,ab ),
+		channel( src.GetR(),dst.GetR() ),
+		channel( src.GetG(),dst.GetG() ),
+		channel( src.GetB(),dst.GetB() ) } );
+}
+
+Color Blend::Over( Color dst,Color src )
+{
+	const int inv = 255 - src.GetA();
+	typedef unsigned char uchar;
+	return( Color{ dst.GetX(),
+		uchar( std::min( 255,src.GetR() + Div255( dst.GetR() * inv ) ) ),
+		uchar( std::min( 255,src.GetG() + Div255( dst.GetG() * inv ) ) ),
+		uchar( std::min( 255,src.GetB() + Div255( dst.GetB() * inv ) ) ) } );
+}
+
+Color Blend::Unpremultiply( Color c )
+{
+	const int a = c.GetA();
+	if( a == 0 ) return( Color{ 0u } );
+	if( a == 255 ) return( c );
+
+	typedef unsigned char uchar;
+	const auto channel = [a]( int v )
+	{
+		return( uchar( std::min( 255,( v * 255 + a / 2 ) / a ) ) );
+	};
+	return( Colors::MakeRGBA( channel( c.GetR() ),channel( c.GetG() ),
+		channel( c.GetB() ),uchar( a ) ) );
+}
+
+BlendMode Blend::GetNextMode( BlendMode mode )
+{
+	const int next = ( int( mode ) + 1 ) % int( BlendMode::Count );
+	return( BlendMode( next ) );
+}
+
+const char* Blend::GetKernelName()
+{
+	return( GetKernel().name );
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "Colors.h"
+
+enum class BlendMode
+{
+	Normal,
+	Multiply,
+	Screen,
+	Add,
+	Overlay,
+	Count
+};
+
+// Integer only compositing.  Backdrops are premultiplied argb with the
+//  alpha in the top byte, sources are chroma keyed layer pixels that get
+//  premultiplied by the layer opacity on the fly.
+namespace Blend
+{
+	// Blend count src pixels over dst, skipping src pixels equal to chroma.
+	void CompositeSpan( Color* dst,const Color* src,int count,
+		BlendMode mode,unsigned char opacity,
+		Color chroma = Colors::Magenta );
+
+	// Blend a single pixel, matches CompositeSpan exactly.
+	Color CompositePixel( Color dst,Color src,BlendMode mode,
+		unsigned char alpha );
+
+	// Premultiplied src under premultiplied dst, for guides that go
+	//  behind the art instead of over it.
+	void UnderSpan( Color* dst,const Color* src,int count );
+
+	// Premultiplied src over an opaque dst, result is opaque.
+	Color Over( Color dst,Color src );
+	Color Unpremultiply( Color c );
+
+	// Whether c counts as target for ReplaceSpan.  Tolerance 0 only takes
+	//  the exact pixel, anything higher takes r, g and b each that close.
+	bool IsNear( Color c,Color target,int tolerance );
+	// Sets every pixel of count at dst that's near from to to, returns
+	//  how many actually changed.
+	int ReplaceSpan( Color* dst,int count,Color from,Color to,int tolerance );
+
+	BlendMode GetNextMode( BlendMode mode );
+
+	// What the span blender picked for this cpu, for profiling.
+	const char* GetKernelName();
+}
@@ -0,0 +1,73 @@
+#include "BlendKernels.h"
+
+// This file is the only one built with avx2 enabled, Blend.cpp checks the
+//  cpu before calling into it.
+#ifdef AESC_BLEND_X86
+#include <immintrin.h>
+
+namespace
+{
+	struct AVX2
+	{
+		typedef __m256i Reg;
+		static constexpr int nPixels = 8;
+
+		static Reg Load( const Color* p )
+		{
+			return( _mm256_loadu_si256( reinterpret_cast< const __m256i* >( p ) ) );
+		}
+		static void Store( Color* p,Reg x )
+		{
+			_mm256_storeu_si256( reinterpret_cast< __m256i* >( p ),x );
+		}
+		static Reg Set16( short v ) { return( _mm256_set1_epi16( v ) ); }
+		static Reg Set32( unsigned int v ) { return( _mm256_set1_epi32( int( v ) ) ); }
+		// Unpack and pack both work per 128 bit lane, so pixel order
+		//  survives the round trip.
+		static Reg UnpackLo( Reg x ) { return( _mm256_unpacklo_epi8( x,_mm256_setzero_si256() ) ); }
+		static Reg UnpackHi( Reg x ) { return( _mm256_unpackhi_epi8( x,_mm256_setzero_si256() ) ); }
+		static Reg Pack( Reg lo,Reg hi ) { return( _mm256_packus_epi16( lo,hi ) ); }
+		static Reg Add16( Reg a,Reg b ) { return( _mm256_add_epi16( a,b ) ); }
+		static Reg Sub16( Reg a,Reg b ) { return( _mm256_sub_epi16( a,b ) ); }
+		static Reg SubSat16( Reg a,Reg b ) { return( _mm256_subs_epu16( a,b ) ); }
+		static Reg Mul16( Reg a,Reg b ) { return( _mm256_mullo_epi16( a,b ) ); }
+		static Reg Shr8( Reg x ) { return( _mm256_srli_epi16( x,8 ) ); }
+		static Reg CmpGt16( Reg a,Reg b ) { return( _mm256_cmpgt_epi16( a,b ) ); }
+		static Reg CmpEq32( Reg a,Reg b ) { return( _mm256_cmpeq_epi32( a,b ) ); }
+		static Reg And( Reg a,Reg b ) { return( _mm256_and_si256( a,b ) ); }
+		// ~a & b
+		static Reg AndNot( Reg a,Reg b ) { return( _mm256_andnot_si256( a,b ) ); }
+		static Reg Or( Reg a,Reg b ) { return( _mm256_or_si256( a,b ) ); }
+		static Reg SubSat8( Reg a,Reg b ) { return( _mm256_subs_epu8( a,b ) ); }
+		static Reg Sub32( Reg a,Reg b ) { return( _mm256_sub_epi32( a,b ) ); }
+		static int Sum32( Reg x )
+		{
+			const __m128i half = _mm_add_epi32( _mm256_castsi256_si128( x ),
+				_mm256_extracti128_si256( x,1 ) );
+			const __m128i pair = _mm_add_epi32( half,_mm_shuffle_epi32( half,0x4E ) );
+			return( _mm_cvtsi128_si32( _mm_add_epi32( pair,_mm_shuffle_epi32( pair,0xB1 ) ) ) );
+		}
+		static Reg BroadcastAlpha( Reg x )
+		{
+			return( _mm256_shufflehi_epi16( _mm256_shufflelo_epi16( x,0xFF ),0xFF ) );
+		}
+	};
+}
+
+int BlendKernels::CompositeSpanAVX2( Color* dst,const Color* src,int count,
+	BlendMode mode,Color chroma,unsigned char opacity )
+{
+	return( CompositeSpan<AVX2>( dst,src,count,mode,chroma,opacity ) );
+}
+
+int BlendKernels::ReplaceSpanAVX2( Color* dst,int count,Color from,Color to,
+	int tolerance,int& changed )
+{
+	return( ReplaceSpan<AVX2>( dst,count,from,to,tolerance,changed ) );
+}
+
+int BlendKernels::UnderSpanAVX2( Color* dst,const Color* src,int count )
+{
+	return( UnderSpan<AVX2>( dst,src,count ) );
+}
+#endif
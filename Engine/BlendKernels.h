@@ -0,0 +1,189 @@
+#pragma once
+
+#include "Blend.h"
+#include <algorithm>
+
+// The simd kernels are x86 only, other targets get the scalar path.
+#if defined( _M_X64 ) || defined( _M_IX86 ) || defined( __x86_64__ ) || defined( __i386__ )
+#define AESC_BLEND_X86
+#endif
+
+// Shared body of the simd span blenders, V wraps the intrinsics for one
+//  register width.  Only include from the Blend translation units, each
+//  one is built with the instruction set its V needs.
+namespace BlendKernels
+{
+	// Exact x / 255 for x in [0,255 * 255].
+	template<typename V>
+	inline typename V::Reg Div255( typename V::Reg x )
+	{
+		x = V::Add16( x,V::Set16( 128 ) );
+		return( V::Shr8( V::Add16( x,V::Shr8( x ) ) ) );
+	}
+
+	// Separable blend term alpha_s * alpha_b * B( cb,cs ) in premultiplied
+	//  form, cs/cb are premultiplied and as/ab are alpha broadcast per pixel.
+	template<typename V,BlendMode mode>
+	inline typename V::Reg Blend16( typename V::Reg cs,typename V::Reg as,
+		typename V::Reg cb,typename V::Reg ab )
+	{
+		typedef typename V::Reg Reg;
+		const Reg full = V::Set16( 255 );
+		switch( mode )
+		{
+		case BlendMode::Normal:
+			return( V::Add16( cs,Div255<V>( V::Mul16( cb,V::Sub16( full,as ) ) ) ) );
+		case BlendMode::Add:
+			return( V::Add16( cs,cb ) );
+		case BlendMode::Screen:
+			return( V::SubSat16( V::Add16( cs,cb ),
+				Div255<V>( V::Mul16( cs,cb ) ) ) );
+		default:
+			break;
+		}
+
+		// Everything else is cs * ( 1 - ab ) + cb * ( 1 - as ) + term.
+		const Reg base = V::Add16(
+			Div255<V>( V::Mul16( cs,V::Sub16( full,ab ) ) ),
+			Div255<V>( V::Mul16( cb,V::Sub16( full,as ) ) ) );
+		const Reg prod = Div255<V>( V::Mul16( cs,cb ) );
+		if( mode == BlendMode::Multiply )
+		{
+			return( V::Add16( base,prod ) );
+		}
+
+		// Overlay multiplies where the backdrop is dark and screens where
+		//  it's light, 2 * cb <= ab picks the dark side without dividing.
+		const Reg dark = V::Add16( prod,prod );
+		const Reg inv = Div255<V>( V::Mul16( V::SubSat16( ab,cb ),
+			V::SubSat16( as,cs ) ) );
+		const Reg light = V::SubSat16( Div255<V>( V::Mul16( as,ab ) ),
+			V::Add16( inv,inv ) );
+		const Reg isLight = V::CmpGt16( V::Add16( cb,cb ),ab );
+		return( V::Add16( base,V::Or( V::And( isLight,light ),
+			V::AndNot( isLight,dark ) ) ) );
+	}
+
+	template<typename V,BlendMode mode>
+	inline void CompositeBlock( Color* dst,const Color* src,
+		typename V::Reg chroma,typename V::Reg opacity )
+	{
+		typedef typename V::Reg Reg;
+		const Reg s = V::Load( src );
+		const Reg d = V::Load( dst );
+
+		// Keyed pixels get zero alpha, everything else gets the layer
+		//  opacity in every byte so it unpacks straight to a multiplier.
+		const Reg alpha = V::AndNot( V::CmpEq32( s,chroma ),opacity );
+		// Force the source alpha byte to 255 so premultiplying leaves
+		//  the alpha lane holding the opacity.
+		const Reg opaque = V::Or( s,V::Set32( 0xFF000000u ) );
+
+		const Reg csLo = Div255<V>( V::Mul16( V::UnpackLo( opaque ),V::UnpackLo( alpha ) ) );
+		const Reg csHi = Div255<V>( V::Mul16( V::UnpackHi( opaque ),V::UnpackHi( alpha ) ) );
+		const Reg cbLo = V::UnpackLo( d );
+		const Reg cbHi = V::UnpackHi( d );
+
+		const Reg lo = Blend16<V,mode>( csLo,V::UnpackLo( alpha ),
+			cbLo,V::BroadcastAlpha( cbLo ) );
+		const Reg hi = Blend16<V,mode>( csHi,V::UnpackHi( alpha ),
+			cbHi,V::BroadcastAlpha( cbHi ) );
+		V::Store( dst,V::Pack( lo,hi ) );
+	}
+
+	// Returns how many pixels were done, the caller finishes the tail.
+	template<typename V,BlendMode mode>
+	inline int CompositeSpan( Color* dst,const Color* src,int count,
+		Color chroma,unsigned char opacity )
+	{
+		const auto vChroma = V::Set32( chroma.dword );
+		const auto vOpacity = V::Set32( opacity * 0x01010101u );
+		int i = 0;
+		for( ; i + V::nPixels <= count; i += V::nPixels )
+		{
+			CompositeBlock<V,mode>( dst + i,src + i,vChroma,vOpacity );
+		}
+		return( i );
+	}
+
+	template<typename V>
+	inline int CompositeSpan( Color* dst,const Color* src,int count,
+		BlendMode mode,Color chroma,unsigned char opacity )
+	{
+		switch( mode )
+		{
+		case BlendMode::Normal:
+			return( CompositeSpan<V,BlendMode::Normal>( dst,src,count,chroma,opacity ) );
+		case BlendMode::Multiply:
+			return( CompositeSpan<V,BlendMode::Multiply>( dst,src,count,chroma,opacity ) );
+		case BlendMode::Screen:
+			return( CompositeSpan<V,BlendMode::Screen>( dst,src,count,chroma,opacity ) );
+		case BlendMode::Add:
+			return( CompositeSpan<V,BlendMode::Add>( dst,src,count,chroma,opacity ) );
+		case BlendMode::Overlay:
+			return( CompositeSpan<V,BlendMode::Overlay>( dst,src,count,chroma,opacity ) );
+		default:
+			return( 0 );
+		}
+	}
+
+	// Per byte distance both ways, whatever's left after taking the
+	//  tolerance off has to be 0 on every byte care keeps.  Pixels that are
+	//  already to don't count as changed.  Returns how many pixels were
+	//  done, the caller finishes the tail.
+	template<typename V>
+	inline int ReplaceSpan( Color* dst,int count,Color from,Color to,
+		int tolerance,int& changed )
+	{
+		typedef typename V::Reg Reg;
+		const Reg key = V::Set32( from.dword );
+		const Reg with = V::Set32( to.dword );
+		const Reg tol = V::Set32( unsigned( std::min( tolerance,255 ) ) * 0x01010101u );
+		const Reg care = V::Set32( tolerance == 0 ? 0xFFFFFFFFu : 0x00FFFFFFu );
+		const Reg zero = V::Set32( 0u );
+		Reg hits = zero;
+		int i = 0;
+		for( ; i + V::nPixels <= count; i += V::nPixels )
+		{
+			const Reg p = V::Load( dst + i );
+			const Reg dist = V::Or( V::SubSat8( p,key ),V::SubSat8( key,p ) );
+			const Reg within = V::CmpEq32( V::And( V::SubSat8( dist,tol ),care ),zero );
+			const Reg hit = V::AndNot( V::CmpEq32( p,with ),within );
+			V::Store( dst + i,V::Or( V::And( hit,with ),V::AndNot( hit,p ) ) );
+			// Hits are -1 in their lane.
+			hits = V::Sub32( hits,hit );
+		}
+		changed += V::Sum32( hits );
+		return( i );
+	}
+
+	// dst + src * ( 1 - alpha_d ) on every byte, alpha included.  Returns
+	//  how many pixels were done, the caller finishes the tail.
+	template<typename V>
+	inline int UnderSpan( Color* dst,const Color* src,int count )
+	{
+		typedef typename V::Reg Reg;
+		const Reg full = V::Set16( 255 );
+		int i = 0;
+		for( ; i + V::nPixels <= count; i += V::nPixels )
+		{
+			const Reg s = V::Load( src + i );
+			const Reg d = V::Load( dst + i );
+			const Reg dLo = V::UnpackLo( d );
+			const Reg dHi = V::UnpackHi( d );
+			const Reg lo = V::Add16( dLo,Div255<V>( V::Mul16( V::UnpackLo( s ),
+				V::Sub16( full,V::BroadcastAlpha( dLo ) ) ) ) );
+			const Reg hi = V::Add16( dHi,Div255<V>( V::Mul16( V::UnpackHi( s ),
+				V::Sub16( full,V::BroadcastAlpha( dHi ) ) ) ) );
+			V::Store( dst + i,V::Pack( lo,hi ) );
+		}
+		return( i );
+	}
+
+	// Built in its own translation unit with avx2 codegen enabled.
+	int CompositeSpanAVX2( Color* dst,const Color* src,int count,
+		BlendMode mode,Color chroma,unsigned char opacity );
+	int ReplaceSpanAVX2( Color* dst,int count,Color from,Color to,
+		int tolerance,int& changed );
+	int UnderSpanAVX2( Color* dst,const Color* src,int count );
+}
\ No newline at end of file
@@ -1,26 +1,33 @@
 #include "Canvas.h"
 
-Canvas::Canvas( Mouse& mouse,MainWindow& wnd )
+Canvas::Canvas( Mouse& mouse,Keyboard& kbd,CursorControl& cursor,Wakeup& wakeup )
 	:
 	mouse( mouse ),
 	pal( "Palettes/Default.bmp" ),
-	imgHand( screenArea,curTool,mouse,wnd.kbd ),
+	imgHand( screenArea,curTool,mouse,kbd ),
 	toolHand( curTool ),
-	fMenu( screenArea,imgHand.GetArt(),wnd )
-{}
+	fMenu( screenArea,cursor ),
+	preview( RectI{ screenArea.right + 5,Graphics::ScreenWidth - 5,
+		screenArea.top + 40,screenArea.top + 190 },wakeup )
+{
+	imgHand.SetPalette( pal.GetColors() );
+}
 
 void Canvas::Update( const Keyboard& kbd )
 {
 	pal.Update( mouse );
 	imgHand.Update( kbd,curTool,mainCol,offCol );
 	toolHand.Update( mouse,kbd,mainCol,offCol );
-	if( fMenu.Update( mouse,kbd,imgHand ) )
+	if( fMenu.Update( mouse,kbd,imgHand,preview.IsShowingStrip() ) )
 	{
 		imgHand.ResizeCanvas( imgHand.GetArt().GetSize() );
 		imgHand.UpdateSelectArea();
 		// imgHand.CreateNewLayer();
 		imgHand.UpdateArt();
 	}
+	usagePanel.Update( mouse,imgHand,mainCol );
+	timeline.Update( mouse,kbd,imgHand );
+	preview.Update( mouse,kbd,imgHand );
 }
 
 void Canvas::Draw( Graphics& gfx ) const
@@ -37,6 +44,25 @@ void Canvas::Draw( Graphics& gfx ) const
 	imgHand.Draw( gfx );
 	toolHand.Draw( gfx );
 	fMenu.Draw( gfx );
+	usagePanel.Draw( gfx );
+	timeline.Draw( gfx );
+	preview.Draw( gfx );
 
 	imgHand.DrawCursor( gfx );
 }
+
+bool Canvas::IsBusy() const
+{
+	return( imgHand.IsBusy() || GetTimeToChange() <= 0.0f || preview.HasNewFrame() );
+}
+
+const ImageHandler& Canvas::GetImageHandler() const
+{
+	return( imgHand );
+}
+
+float Canvas::GetTimeToChange() const
+{
+	// The preview wakes things up itself.
+	return( timeline.GetTimeLeft() );
+}
\ No newline at end of file
@@ -10,15 +10,28 @@
 #include "ToolMode.h"
 #include "ToolHandler.h"
 #include "FileMenu.h"
-#include "MainWindow.h"
+#include "ColorUsagePanel.h"
+#include "TimelinePanel.h"
+#include "PreviewPanel.h"
+#include "CursorControl.h"
+#include "Wakeup.h"
 
 class Canvas
 {
 public:
-	Canvas( Mouse& mouse,MainWindow& wnd );
+	// wakeup gets called from the preview's thread when it shows a new
+	//  frame.
+	Canvas( Mouse& mouse,Keyboard& kbd,CursorControl& cursor,Wakeup& wakeup );
 
 	void Update( const Keyboard& kbd );
 	void Draw( Graphics& gfx ) const;
+	// True if something is changing on its own and needs redrawing.
+	bool IsBusy() const;
+	// Seconds until the next thing that changes on its own is due, very
+	//  large if nothing is.
+	float GetTimeToChange() const;
+	// The document being edited, for replays to check.
+	const ImageHandler& GetImageHandler() const;
 private:
 	Mouse& mouse;
 	const RectI screenArea = { 70,Graphics
@@ -33,4 +46,10 @@ private:
 	ToolMode curTool = ToolMode::Brush;
 	ToolHandler toolHand;
 	FileMenu fMenu;
+	// Right of the canvas between the file buttons and the layers.
+	PreviewPanel preview;
+	ColorUsagePanel usagePanel = { RectI{ screenArea.right + 5,
+		Graphics::ScreenWidth - 5,screenArea.top + 195,screenArea.bottom - 242 } };
+	// Top right, past the tool buttons.
+	TimelinePanel timeline = { RectI{ 710,Graphics::ScreenWidth - 5,4,46 } };
 };
\ No newline at end of file
@@ -0,0 +1,83 @@
+#include "CelStore.h"
+#include <algorithm>
+#include <cassert>
+
+int CelStore::Add( const Surface& surf,const ColorHistogram* counts )
+{
+	const auto hash = Hash( surf );
+	auto& ids = byHash[hash];
+	// Same hash isn't proof, only the pixels are.
+	for( const int id : ids )
+	{
+		auto& cel = cels.at( id );
+		if( !( cel.pixels != surf ) )
+		{
+			++cel.refs;
+			return( id );
+		}
+	}
+
+	const int id = nextId++;
+	auto& cel = cels.emplace( id,
+		Cel{ surf,hash,1,counts ? *counts : ColorHistogram{} } ).first->second;
+	if( !counts ) cel.histogram.Rebuild( surf );
+	ids.emplace_back( id );
+	return( id );
+}
+
+void CelStore::AddRef( int id )
+{
+	++cels.at( id ).refs;
+}
+
+void CelStore::Release( int id )
+{
+	const auto it = cels.find( id );
+	assert( it != cels.end() && it->second.refs > 0 );
+	if( --it->second.refs > 0 ) return;
+
+	auto& ids = byHash.at( it->second.hash );
+	ids.erase( std::find( ids.begin(),ids.end(),id ) );
+	if( ids.empty() ) byHash.erase( it->second.hash );
+	cels.erase( it );
+}
+
+const Surface& CelStore::Get( int id ) const
+{
+	return( cels.at( id ).pixels );
+}
+
+const ColorHistogram& CelStore::GetHistogram( int id ) const
+{
+	return( cels.at( id ).histogram );
+}
+
+int CelStore::GetCount() const
+{
+	return( int( cels.size() ) );
+}
+
+size_t CelStore::GetBytes() const
+{
+	size_t bytes = 0u;
+	for( const auto& cel : cels )
+	{
+		bytes += cel.second.pixels.GetRawPixelData().size() * sizeof( Color );
+	}
+	return( bytes );
+}
+
+uint64_t CelStore::Hash( const Surface& surf )
+{
+	// FNV-1a a pixel at a time, size first so differently shaped cels
+	//  with the same pixels don't collide.
+	uint64_t hash = 14695981039346656037ull;
+	const auto mix = [&hash]( uint64_t v )
+	{
+		hash ^= v;
+		hash *= 1099511628211ull;
+	};
+	mix( uint64_t( surf.GetWidth() ) << 32 | unsigned( surf.GetHeight() ) );
+	for( const auto c : surf.GetRawPixelData() ) mix( c.dword );
+	return( hash );
+}
\ No newline at end of file
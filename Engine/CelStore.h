@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Surface.h"
+#include "ColorHistogram.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Layer pixels shared between animation frames.  Identical pixels are
+//  only kept once, found by a hash of their content, and nothing ever
+//  writes to a stored cel so sharing one is safe.  Edits come back as a
+//  new cel instead.
+class CelStore
+{
+public:
+	// Id of a cel holding surf's pixels, an existing one if it's the same.
+	//  Every Add needs a Release once its owner is done with it.  counts
+	//  saves counting a new cel's pixels, it has to match them.
+	int Add( const Surface& surf,const ColorHistogram* counts = nullptr );
+	void AddRef( int id );
+	void Release( int id );
+	const Surface& Get( int id ) const;
+	// Pixels of each color, counted once when the cel was added.
+	const ColorHistogram& GetHistogram( int id ) const;
+
+	// Unique cels currently kept.
+	int GetCount() const;
+	size_t GetBytes() const;
+private:
+	static uint64_t Hash( const Surface& surf );
+private:
+	struct Cel
+	{
+		Surface pixels;
+		uint64_t hash;
+		int refs;
+		ColorHistogram histogram;
+	};
+	std::unordered_map<int,Cel> cels;
+	// Ids of every cel with a hash, almost always just one.
+	std::unordered_map<uint64_t,std::vector<int>> byHash;
+	int nextId = 0;
+};
\ No newline at end of file
@@ -0,0 +1,67 @@
+#include "ColorHistogram.h"
+#include "Surface.h"
+#include <cassert>
+
+void ColorHistogram::Rebuild( const Surface& surf )
+{
+	counts.clear();
+	// Runs of the same color are common, only hash once per run.
+	const auto& pixels = surf.GetRawPixelData();
+	for( size_t i = 0; i < pixels.size(); )
+	{
+		size_t end = i + 1;
+		while( end < pixels.size() && pixels[end] == pixels[i] ) ++end;
+		counts[pixels[i].dword] += int( end - i );
+		i = end;
+	}
+	++version;
+}
+
+void ColorHistogram::Replace( Color oldColor,Color newColor )
+{
+	if( oldColor == newColor ) return;
+	Add( oldColor,-1 );
+	Add( newColor,1 );
+}
+
+void ColorHistogram::Add( Color c,int n )
+{
+	if( n == 0 ) return;
+	const auto it = counts.emplace( c.dword,0 ).first;
+	it->second += n;
+	assert( it->second >= 0 );
+	if( it->second == 0 ) counts.erase( it );
+	++version;
+}
+
+void ColorHistogram::Recolor( Color oldColor,Color newColor )
+{
+	const auto it = counts.find( oldColor.dword );
+	if( oldColor == newColor || it == counts.end() ) return;
+
+	const int n = it->second;
+	counts.erase( it );
+	counts[newColor.dword] += n;
+	++version;
+}
+
+int ColorHistogram::GetCount( Color c ) const
+{
+	const auto it = counts.find( c.dword );
+	return( it != counts.end() ? it->second : 0 );
+}
+
+int ColorHistogram::GetColorCount() const
+{
+	return( int( counts.size() ) );
+}
+
+const std::unordered_map<unsigned int,int>& ColorHistogram::GetCounts() const
+{
+	return( counts );
+}
+
+unsigned int ColorHistogram::GetVersion() const
+{
+	return( version );
+}
\ No newline at end of file
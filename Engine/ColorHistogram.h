@@ -0,0 +1,32 @@
+#pragma once
+
+#include "Colors.h"
+#include <unordered_map>
+
+class Surface;
+
+// How many pixels of each color a surface has.  A Surface it's attached
+//  to keeps it up to date as pixels get written, so it never needs
+//  rescanning unless the whole surface gets replaced.
+class ColorHistogram
+{
+public:
+	// Throws away the counts and counts every pixel of surf.
+	void Rebuild( const Surface& surf );
+	// One pixel went from oldColor to newColor.
+	void Replace( Color oldColor,Color newColor );
+	// n can be negative for pixels that went away.
+	void Add( Color c,int n );
+	// Every pixel counted as oldColor is newColor now.
+	void Recolor( Color oldColor,Color newColor );
+
+	int GetCount( Color c ) const;
+	// Colors with at least one pixel.
+	int GetColorCount() const;
+	const std::unordered_map<unsigned int,int>& GetCounts() const;
+	// Goes up whenever a count changes.
+	unsigned int GetVersion() const;
+private:
+	std::unordered_map<unsigned int,int> counts;
+	unsigned int version = 0u;
+};
\ No newline at end of file
@@ -0,0 +1,283 @@
+#include "ColorLookup.h"
+#include <algorithm>
+#include <climits>
+
+namespace
+{
+	constexpr int weightR = 2;
+	constexpr int weightG = 4;
+	constexpr int weightB = 3;
+
+	// Where error diffusion sends what's left over.
+	struct Spread
+	{
+		int dx;
+		int dy;
+		int weight;
+	};
+	constexpr Spread floydSteinberg[] = { { 1,0,7 },{ -1,1,3 },{ 0,1,5 },{ 1,1,1 } };
+	constexpr int nFloydSteinberg = int( sizeof( floydSteinberg ) / sizeof( floydSteinberg[0] ) );
+	// Weights are out of 1 << shift.
+	constexpr int floydSteinbergShift = 4;
+	// Only passes on 6/8 of the error, keeps flat areas flat.
+	constexpr Spread atkinson[] = { { 1,0,1 },{ 2,0,1 },{ -1,1,1 },
+		{ 0,1,1 },{ 1,1,1 },{ 0,2,1 } };
+	constexpr int nAtkinson = int( sizeof( atkinson ) / sizeof( atkinson[0] ) );
+	constexpr int atkinsonShift = 3;
+
+	constexpr int bayer[8][8] =
+	{
+		{ 0,32,8,40,2,34,10,42 },
+		{ 48,16,56,24,50,18,58,26 },
+		{ 12,44,4,36,14,46,6,38 },
+		{ 60,28,52,20,62,30,54,22 },
+		{ 3,35,11,43,1,33,9,41 },
+		{ 51,19,59,27,49,17,57,25 },
+		{ 15,47,7,39,13,45,5,37 },
+		{ 63,31,55,23,61,29,53,21 }
+	};
+	// How far the pattern pushes each channel, from -spread / 2 to spread / 2.
+	constexpr int bayerSpread = 32;
+
+	int Clamp255( int x )
+	{
+		return( std::min( 255,std::max( 0,x ) ) );
+	}
+}
+
+ColorLookup::ColorLookup( const ColorTable& table )
+	:
+	count( table.GetCount() )
+{
+	std::copy( table.GetColors(),table.GetColors() + ColorTable::maxColors,
+		colors.begin() );
+
+	// A color is a candidate for a cell if the closest it gets to the cell
+	//  beats the furthest the best color gets, so lookups stay exact.
+	//  Both are sums over the axes, so each axis' share is worked out once
+	//  per color and cell row instead of once per cell.
+	constexpr int cellSize = 256 >> cellBits;
+	constexpr int cellsPerAxis = 1 << cellBits;
+	constexpr int weights[3] = { weightR,weightG,weightB };
+	// [axis][cell coordinate][color], colors next to each other.
+	std::vector<int> gaps( 3 * cellsPerAxis * count );
+	std::vector<int> reaches( 3 * cellsPerAxis * count );
+	for( int axis = 0; axis < 3; ++axis )
+	{
+		for( int coord = 0; coord < cellsPerAxis; ++coord )
+		{
+			const int lo = coord * cellSize;
+			const int hi = lo + cellSize - 1;
+			const int row = ( axis * cellsPerAxis + coord ) * count;
+			for( int i = 1; i < count; ++i )
+			{
+				const int c = axis == 0 ? colors[i].GetR()
+					: axis == 1 ? colors[i].GetG() : colors[i].GetB();
+				const int gap = std::max( 0,std::max( lo - c,c - hi ) );
+				const int reach = std::max( c - lo,hi - c );
+				gaps[row + i] = weights[axis] * gap * gap;
+				reaches[row + i] = weights[axis] * reach * reach;
+			}
+		}
+	}
+	const auto axisRow = [&]( const std::vector<int>& terms,int axis,int coord )
+	{
+		return( terms.data() + ( axis * cellsPerAxis + coord ) * count );
+	};
+
+	std::vector<int> nearestRG( count );
+	std::vector<int> furthestRG( count );
+	std::vector<int> nearest( count );
+	cellStart.reserve( nCells + 1 );
+	for( int r = 0; r < cellsPerAxis; ++r )
+	{
+		for( int g = 0; g < cellsPerAxis; ++g )
+		{
+			const int* gapR = axisRow( gaps,0,r );
+			const int* gapG = axisRow( gaps,1,g );
+			const int* reachR = axisRow( reaches,0,r );
+			const int* reachG = axisRow( reaches,1,g );
+			for( int i = 1; i < count; ++i )
+			{
+				nearestRG[i] = gapR[i] + gapG[i];
+				furthestRG[i] = reachR[i] + reachG[i];
+			}
+			for( int b = 0; b < cellsPerAxis; ++b )
+			{
+				const int* gapB = axisRow( gaps,2,b );
+				const int* reachB = axisRow( reaches,2,b );
+				int best = INT_MAX;
+				for( int i = 1; i < count; ++i )
+				{
+					nearest[i] = nearestRG[i] + gapB[i];
+					best = std::min( best,furthestRG[i] + reachB[i] );
+				}
+
+				cellStart.emplace_back( static_cast<unsigned int>( candidates.size() ) );
+				for( int i = 1; i < count; ++i )
+				{
+					if( nearest[i] <= best ) candidates.emplace_back( static_cast<unsigned char>( i ) );
+				}
+			}
+		}
+	}
+	cellStart.emplace_back( static_cast<unsigned int>( candidates.size() ) );
+}
+
+unsigned char ColorLookup::GetIndex( Color c ) const
+{
+	return( GetIndex( c.GetR(),c.GetG(),c.GetB() ) );
+}
+
+IndexedSurface ColorLookup::Remap( const Surface& src,DitherMode dither,
+	Color chroma ) const
+{
+	if( dither == DitherMode::Bayer ) return( Ordered( src,chroma ) );
+	if( dither != DitherMode::None ) return( Diffuse( src,dither,chroma ) );
+
+	IndexedSurface out = { src.GetWidth(),src.GetHeight() };
+	Color last = chroma;
+	unsigned char lastIndex = 0u;
+	for( int y = 0; y < src.GetHeight(); ++y )
+	{
+		for( int x = 0; x < src.GetWidth(); ++x )
+		{
+			const Color c = src.GetPixel( x,y );
+			if( c != last )
+			{
+				last = c;
+				lastIndex = c == chroma ? 0u : GetIndex( c );
+			}
+			out.SetIndex( x,y,lastIndex );
+		}
+	}
+	return( out );
+}
+
+bool ColorLookup::IsFor( const ColorTable& table ) const
+{
+	return( count == table.GetCount() &&
+		std::equal( colors.begin(),colors.end(),table.GetColors() ) );
+}
+
+DitherMode ColorLookup::GetNextMode( DitherMode mode )
+{
+	return( DitherMode( ( int( mode ) + 1 ) % int( DitherMode::Count ) ) );
+}
+
+IndexedSurface ColorLookup::Diffuse( const Surface& src,DitherMode dither,
+	Color chroma ) const
+{
+	const Spread* spreads = floydSteinberg;
+	int nSpreads = nFloydSteinberg;
+	int shift = floydSteinbergShift;
+	if( dither == DitherMode::Atkinson )
+	{
+		spreads = atkinson;
+		nSpreads = nAtkinson;
+		shift = atkinsonShift;
+	}
+
+	// Error still owed to pixels, a ring of 3 rows padded by 2 on both
+	//  sides so spreads never need bounds checks sideways.
+	const int width = src.GetWidth();
+	const int height = src.GetHeight();
+	const int stride = width + 4;
+	std::vector<int> error( size_t( stride ) * 3 * 3,0 );
+
+	IndexedSurface out = { width,height };
+	for( int y = 0; y < height; ++y )
+	{
+		// This row and the two below it, pointing at x = 0.
+		int* rows[3];
+		for( int dy = 0; dy < 3; ++dy )
+		{
+			rows[dy] = error.data() + ( size_t( ( y + dy ) % 3 ) * stride + 2 ) * 3;
+		}
+
+		for( int x = 0; x < width; ++x )
+		{
+			int* owed = rows[0] + x * 3;
+			const Color c = src.GetPixel( x,y );
+			// Transparent pixels soak up whatever reaches them.
+			if( c == chroma )
+			{
+				std::fill( owed,owed + 3,0 );
+				continue;
+			}
+
+			const int r = Clamp255( c.GetR() + ( owed[0] >> shift ) );
+			const int g = Clamp255( c.GetG() + ( owed[1] >> shift ) );
+			const int b = Clamp255( c.GetB() + ( owed[2] >> shift ) );
+			std::fill( owed,owed + 3,0 );
+
+			const auto index = GetIndex( r,g,b );
+			out.SetIndex( x,y,index );
+			const int er = r - colors[index].GetR();
+			const int eg = g - colors[index].GetG();
+			const int eb = b - colors[index].GetB();
+			for( int i = 0; i < nSpreads; ++i )
+			{
+				if( y + spreads[i].dy >= height ) continue;
+				int* next = rows[spreads[i].dy] + ( x + spreads[i].dx ) * 3;
+				next[0] += er * spreads[i].weight;
+				next[1] += eg * spreads[i].weight;
+				next[2] += eb * spreads[i].weight;
+			}
+		}
+		// Padding got error that nobody reads, clear it before the row comes back.
+		std::fill( rows[0] - 2 * 3,rows[0],0 );
+		std::fill( rows[0] + width * 3,rows[0] + ( width + 2 ) * 3,0 );
+	}
+	return( out );
+}
+
+IndexedSurface ColorLookup::Ordered( const Surface& src,Color chroma ) const
+{
+	IndexedSurface out = { src.GetWidth(),src.GetHeight() };
+	for( int y = 0; y < src.GetHeight(); ++y )
+	{
+		for( int x = 0; x < src.GetWidth(); ++x )
+		{
+			const Color c = src.GetPixel( x,y );
+			if( c == chroma ) continue;
+
+			const int offset = ( bayer[y & 7][x & 7] * 2 - 63 ) * bayerSpread / 128;
+			out.SetIndex( x,y,GetIndex( Clamp255( c.GetR() + offset ),
+				Clamp255( c.GetG() + offset ),Clamp255( c.GetB() + offset ) ) );
+		}
+	}
+	return( out );
+}
+
+int ColorLookup::Distance( int r0,int g0,int b0,Color c )
+{
+	const int dr = r0 - int( c.GetR() );
+	const int dg = g0 - int( c.GetG() );
+	const int db = b0 - int( c.GetB() );
+	return( weightR * dr * dr + weightG * dg * dg + weightB * db * db );
+}
+
+unsigned char ColorLookup::GetIndex( int r,int g,int b ) const
+{
+	constexpr int shift = 8 - cellBits;
+	const int cell = ( ( r >> shift ) << ( cellBits * 2 ) ) |
+		( ( g >> shift ) << cellBits ) | ( b >> shift );
+	const unsigned int first = cellStart[cell];
+	const unsigned int last = cellStart[cell + 1];
+	if( first == last ) return( 0u );
+	if( last - first == 1u ) return( candidates[first] );
+
+	unsigned char best = candidates[first];
+	int bestDist = INT_MAX;
+	for( unsigned int i = first; i < last; ++i )
+	{
+		const int dist = Distance( r,g,b,colors[candidates[i]] );
+		if( dist < bestDist )
+		{
+			best = candidates[i];
+			bestDist = dist;
+		}
+	}
+	return( best );
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "IndexedSurface.h"
+#include "Surface.h"
+#include <array>
+#include <vector>
+
+enum class DitherMode
+{
+	None,
+	FloydSteinberg,
+	Atkinson,
+	Bayer,
+	Count
+};
+
+// Nearest color in a ColorTable without searching the whole table.  RGB
+//  space is cut into 32x32x32 cells and each cell keeps only the colors
+//  that could be nearest to something inside it, usually just one.
+//  Distance weighs green most and red least, closer to how eyes see it.
+class ColorLookup
+{
+public:
+	ColorLookup( const ColorTable& table );
+
+	// Never 0 unless the table has no colors besides chroma.
+	unsigned char GetIndex( Color c ) const;
+	// Every pixel of src as an index into the table, chroma goes to 0.
+	IndexedSurface Remap( const Surface& src,DitherMode dither,
+		Color chroma = ColorTable::chroma ) const;
+	// False once table has changed since this was built.
+	bool IsFor( const ColorTable& table ) const;
+
+	static DitherMode GetNextMode( DitherMode mode );
+private:
+	IndexedSurface Diffuse( const Surface& src,DitherMode dither,Color chroma ) const;
+	IndexedSurface Ordered( const Surface& src,Color chroma ) const;
+	// Channels already clamped to 0-255.
+	unsigned char GetIndex( int r,int g,int b ) const;
+	static int Distance( int r0,int g0,int b0,Color c );
+private:
+	static constexpr int cellBits = 5;
+	static constexpr int nCells = 1 << ( cellBits * 3 );
+	std::array<Color,ColorTable::maxColors> colors;
+	int count;
+	// Candidates of cell i are cellStart[i] up to cellStart[i + 1].
+	std::vector<unsigned int> cellStart;
+	std::vector<unsigned char> candidates;
+};
\ No newline at end of file
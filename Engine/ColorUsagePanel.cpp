@@ -0,0 +1,68 @@
+#include "ColorUsagePanel.h"
+#include <algorithm>
+#include <string>
+
+ColorUsagePanel::ColorUsagePanel( const RectI& area )
+	:
+	area( area )
+{}
+
+void ColorUsagePanel::Update( const Mouse& mouse,const ImageHandler& imgHand,
+	Color& main )
+{
+	const auto version = imgHand.GetUsageVersion();
+	if( !fresh || version != usageVersion )
+	{
+		usage = imgHand.GetColorUsage();
+		usageVersion = version;
+		fresh = true;
+	}
+
+	hovered = GetRowAt( mouse.GetPos() );
+	if( hovered != -1 && mouse.LeftIsPressed() ) main = usage[hovered].first;
+}
+
+void ColorUsagePanel::Draw( Graphics& gfx ) const
+{
+	gfx.DrawRect( area.left,area.top,area.GetWidth(),area.GetHeight(),
+		Colors::DarkGray );
+
+	luckyPixel.DrawText( std::to_string( usage.size() ),
+		Vei2{ area.left + padding,area.top + padding },Colors::White,gfx );
+
+	// Bars are relative to the most used color, which is always first.
+	const int barLeft = area.left + padding * 2 + swatchSize;
+	const int maxBar = area.right - padding - barLeft;
+	const int top = area.top + padding * 2 + luckyPixel.GetCharSize().y;
+	const int nRows = std::min( int( usage.size() ),GetVisibleRows() );
+	for( int i = 0; i < nRows; ++i )
+	{
+		const int y = top + i * rowHeight;
+		if( i == hovered )
+		{
+			gfx.DrawRect( area.left + padding - 1,y - 1,
+				swatchSize + 2,swatchSize + 2,Colors::White );
+		}
+		gfx.DrawRect( area.left + padding,y,swatchSize,swatchSize,
+			usage[i].first );
+
+		const int bar = std::max( 1,int( static_cast<long long>( maxBar ) *
+			usage[i].second / usage[0].second ) );
+		gfx.DrawRect( barLeft,y + 2,bar,swatchSize - 4,Colors::LightGray );
+	}
+}
+
+int ColorUsagePanel::GetRowAt( const Vei2& pos ) const
+{
+	const int top = area.top + padding * 2 + luckyPixel.GetCharSize().y;
+	if( !area.ContainsPoint( pos ) || pos.y < top ) return( -1 );
+
+	const int row = ( pos.y - top ) / rowHeight;
+	return( row < std::min( int( usage.size() ),GetVisibleRows() ) ? row : -1 );
+}
+
+int ColorUsagePanel::GetVisibleRows() const
+{
+	return( std::max( 0,( area.bottom - padding -
+		( area.top + padding * 2 + luckyPixel.GetCharSize().y ) ) / rowHeight ) );
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Graphics.h"
+#include "Mouse.h"
+#include "Rect.h"
+#include "Font.h"
+#include "ImageHandler.h"
+#include <vector>
+
+// How many colors the document uses and how many pixels of each, most
+//  used first.  Click a row to paint with that color.
+class ColorUsagePanel
+{
+public:
+	ColorUsagePanel( const RectI& area );
+
+	void Update( const Mouse& mouse,const ImageHandler& imgHand,Color& main );
+	void Draw( Graphics& gfx ) const;
+private:
+	// Row under pos or -1.
+	int GetRowAt( const Vei2& pos ) const;
+	int GetVisibleRows() const;
+private:
+	const RectI area;
+	static constexpr int padding = 5;
+	static constexpr int rowHeight = 10;
+	static constexpr int swatchSize = 8;
+	const Font luckyPixel = Font{ "Fonts/LuckyPixel24x36.bmp" };
+
+	std::vector<std::pair<Color,int>> usage;
+	// Only asked for again once the document says it's changed.
+	unsigned int usageVersion = 0u;
+	bool fresh = false;
+	int hovered = -1;
+};
\ No newline at end of file
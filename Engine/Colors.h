@@ -109,6 +109,10 @@ namespace Colors
 	{
 		return (r << 16) | (g << 8) | b;
 	}
+	static constexpr Color MakeRGBA( unsigned char r,unsigned char g,unsigned char b,unsigned char a )
+	{
+		return (unsigned( a ) << 24u) | (r << 16) | (g << 8) | b;
+	}
 	static constexpr Color White = MakeRGB( 255u,255u,255u );
 	static constexpr Color Black = MakeRGB( 0u,0u,0u );
 	static constexpr Color Gray = MakeRGB( 0x80u,0x80u,0x80u );
@@ -0,0 +1,10 @@
+#pragma once
+
+// Lets ui code show the system cursor (for native dialogs) without
+//  knowing about the window behind it.
+class CursorControl
+{
+public:
+	virtual ~CursorControl() = default;
+	virtual void HideCursor( bool hidden ) = 0;
+};
\ No newline at end of file
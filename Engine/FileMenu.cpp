@@ -1,50 +1,91 @@
 #include "FileMenu.h"
 #include "FileOpener.h"
 #include "WriteToBitmap.h"
+#include "WriteToGif.h"
+#include "PaletteSwap.h"
 
-FileMenu::FileMenu( const RectI& screenArea,Surface& art,
-	MainWindow& wnd )
+FileMenu::FileMenu( const RectI& screenArea,CursorControl& cursor )
 	:
 	screenArea( screenArea ),
-	art( art ),
-	wnd( wnd )
+	cursor( cursor )
 {}
 
-bool FileMenu::Update( const Mouse& mouse,const Keyboard& kbd,ImageHandler& imgHand )
+bool FileMenu::Update( const Mouse& mouse,const Keyboard& kbd,ImageHandler& imgHand,
+	bool asStrip )
 {
 	if( open.Update( mouse ) || ( kbd.KeyIsPressed( VK_CONTROL ) &&
 		kbd.KeyIsPressed( 'O' ) ) )
 	{
-		wnd.HideCursor( false );
+		cursor.HideCursor( false );
 		const auto path = FileOpener::OpenFile();
 		if( path.length() > 0 )
 		{
 			if( path.substr( path.length() - 4 ) == ".bmp" )
 			{
-				Surface temp = path;
-				art.Resize( Vei2{ temp.GetWidth(),temp.GetHeight() } );
-				imgHand.CreateNewLayer();
-				art.CopyInto( temp );
+				const Surface temp = path;
+				imgHand.ResizeCanvas( temp.GetSize() );
+				imgHand.CreateNewLayer( temp );
 			}
 		}
-		wnd.HideCursor( true );
+		cursor.HideCursor( true );
 
 		return( true );
 	}
 	if( save.Update( mouse ) || ( kbd.KeyIsPressed( VK_CONTROL ) &&
 		kbd.KeyIsPressed( 'S' ) ) )
 	{
-		wnd.HideCursor( false );
+		cursor.HideCursor( false );
 		auto path = FileOpener::SaveFile();
-		if( path.length() > 0 )
+		// Gifs get every frame, shift gives each one its own colors.
+		if( path.length() > 4 && path.substr( path.length() - 4 ) == ".gif" )
+		{
+			std::vector<Surface> frames;
+			std::vector<float> durations;
+			imgHand.GetAnimation( asStrip,frames,durations );
+			if( imgHand.IsIndexed() )
+			{
+				WriteToGif::Write( frames,durations,imgHand.GetColorTable(),path );
+			}
+			else
+			{
+				WriteToGif::Write( frames,durations,path,
+					kbd.KeyIsPressed( VK_SHIFT )
+					? WriteToGif::PaletteMode::PerFrame
+					: WriteToGif::PaletteMode::Global );
+			}
+		}
+		else if( path.length() > 0 )
 		{
 			if( path.substr( path.length() - 4 ) != ".bmp" )
 			{
 				path += ".bmp";
 			}
-			WriteToBitmap::Write( imgHand.GetLayeredArt(),path );
+			// Shift saves a variant per column of a PaletteSwap mapping
+			//  too, as path_1.bmp and so on.
+			if( kbd.KeyIsPressed( VK_SHIFT ) )
+			{
+				const auto mapping = FileOpener::OpenFile();
+				if( mapping.length() > 0 )
+				{
+					const auto variants = PaletteSwap{ mapping }
+						.Apply( imgHand.GetLayeredArt() );
+					for( int i = 0; i < int( variants.size() ); ++i )
+					{
+						WriteToBitmap::Write( variants[i],
+							PaletteSwap::GetVariantPath( path,i ) );
+					}
+				}
+			}
+			if( imgHand.IsIndexed() )
+			{
+				// Copy so blended colors don't end up in the document's table.
+				auto table = imgHand.GetColorTable();
+				WriteToBitmap::Write( IndexedSurface{
+					imgHand.GetLayeredArt(),table },table,path );
+			}
+			else WriteToBitmap::Write( imgHand.GetLayeredArt(),path );
 		}
-		wnd.HideCursor( true );
+		cursor.HideCursor( true );
 
 		return( true );
 	}
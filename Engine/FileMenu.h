@@ -6,21 +6,22 @@
 #include "Keyboard.h"
 #include "Graphics.h"
 #include "Button.h"
-#include "MainWindow.h"
+#include "CursorControl.h"
 #include "ImageHandler.h"
 
 class FileMenu
 {
 public:
-	FileMenu( const RectI& screenArea,Surface& art,
-		MainWindow& wnd );
+	FileMenu( const RectI& screenArea,CursorControl& cursor );
 
-	bool Update( const Mouse& mouse,const Keyboard& kbd,ImageHandler& imgHand );
+	// asStrip saves gifs of a one frame strip as its cells, see
+	//  ImageHandler::IsStrip.
+	bool Update( const Mouse& mouse,const Keyboard& kbd,ImageHandler& imgHand,
+		bool asStrip );
 	void Draw( Graphics& gfx ) const;
 private:
 	const RectI& screenArea;
-	Surface& art;
-	MainWindow& wnd;
+	CursorControl& cursor;
 
 	Button open = Button{ Surface{ { "Icons/OpenButton.bmp" },Vei2{ 3,3 } },
 		Vei2{ screenArea.right + 5,screenArea.top + 5 } };
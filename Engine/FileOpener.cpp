@@ -1,4 +1,6 @@
 #include "FileOpener.h"
+
+#ifdef _WIN32
 #include <Windows.h>
 #include <ShObjIdl.h>
 #include <ShObjIdl_core.h>
@@ -73,6 +75,7 @@ std::string FileOpener::SaveFile()
 			const COMDLG_FILTERSPEC c_rgSaveTypes[] =
 			{
 				{ L"Bitmap Image (*.bmp)",L"*.bmp" },
+				{ L"Animated GIF (*.gif)",L"*.gif" },
 				{ L"All Documents (*.*)",L"*.*" }
 			};
 			const int INDEX_BITMAP = 0;
@@ -118,3 +121,15 @@ std::string FileOpener::SaveFile()
 
 	return( path );
 }
+#else
+// No native file dialogs elsewhere, headless runs never ask for a path.
+std::string FileOpener::OpenFile()
+{
+	return( "" );
+}
+
+std::string FileOpener::SaveFile()
+{
+	return( "" );
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,110 @@
+#include "FloatingSelection.h"
+#include "SpriteEffect.h"
+#include <algorithm>
+#include <cassert>
+
+void FloatingSelection::Lift( Surface& art,History& history,int layer,
+	const SelectionMask& selection,Color chroma )
+{
+	assert( !floating );
+	const RectI bounds = selection.GetBounds();
+	this->chroma = chroma;
+	origin = { bounds.left,bounds.top };
+	pos = origin;
+	floating = true;
+
+	const Vei2 size = { bounds.GetWidth(),bounds.GetHeight() };
+	if( pixels.GetSize() != size ) pixels = Surface{ size.x,size.y };
+	pixels.DrawRect( 0,0,size.x,size.y,chroma );
+
+	// Chroma pixels stay out of it so they don't cover anything when
+	//  dropped, same as a light copy.
+	placed.clear();
+	selection.GetSpans( bounds,placed );
+	spans.clear();
+	for( const auto& span : placed )
+	{
+		int x = span.left;
+		while( x < span.right )
+		{
+			while( x < span.right && art.GetPixel( x,span.y ) == chroma ) ++x;
+			const int left = x;
+			while( x < span.right && art.GetPixel( x,span.y ) != chroma ) ++x;
+			if( left < x )
+			{
+				spans.emplace_back( Surface::Span{ span.y - origin.y,
+					left - origin.x,x - origin.x } );
+			}
+		}
+	}
+	pixels.CopySpans( spans,art,-origin );
+
+	placed.clear();
+	for( const auto& span : spans )
+	{
+		placed.emplace_back( Surface::Span{ span.y + origin.y,
+			span.left + origin.x,span.right + origin.x } );
+		history.Touch( art,layer,RectI{ placed.back().left,
+			placed.back().right,placed.back().y,placed.back().y + 1 } );
+	}
+	art.FillSpans( placed,chroma );
+}
+
+void FloatingSelection::Drop( Surface& art,History& history,int layer )
+{
+	assert( floating );
+	floating = false;
+
+	placed.clear();
+	for( const auto& span : spans )
+	{
+		const int y = span.y + pos.y;
+		if( y < 0 || y >= art.GetHeight() ) continue;
+		const int left = std::max( span.left + pos.x,0 );
+		const int right = std::min( span.right + pos.x,art.GetWidth() );
+		if( left >= right ) continue;
+
+		placed.emplace_back( Surface::Span{ y,left,right } );
+		history.Touch( art,layer,RectI{ left,right,y,y + 1 } );
+	}
+	art.CopySpans( placed,pixels,pos );
+}
+
+void FloatingSelection::MoveBy( const Vei2& amount )
+{
+	pos += amount;
+}
+
+void FloatingSelection::MoveTo( const Vei2& pos )
+{
+	this->pos = pos;
+}
+
+void FloatingSelection::Draw( Graphics& gfx,const Vei2& artPos,int scale,
+	const RectI& clip ) const
+{
+	if( !floating ) return;
+
+	gfx.DrawSpriteScaled( artPos.x + pos.x * scale,artPos.y + pos.y * scale,
+		clip,pixels,scale,SpriteEffect::Chroma{ chroma } );
+}
+
+bool FloatingSelection::IsFloating() const
+{
+	return( floating );
+}
+
+Vei2 FloatingSelection::GetPos() const
+{
+	return( pos );
+}
+
+Vei2 FloatingSelection::GetOrigin() const
+{
+	return( origin );
+}
+
+Vei2 FloatingSelection::GetSize() const
+{
+	return( pixels.GetSize() );
+}
\ No newline at end of file
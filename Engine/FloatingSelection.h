@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Surface.h"
+#include "SelectionMask.h"
+#include "History.h"
+#include "Graphics.h"
+#include "Vec2.h"
+#include <vector>
+
+// Selected pixels picked up off a layer while they get moved around.
+//  They're copied out once when lifted, drawn wherever they are now, and
+//  written back with one span copy when dropped.
+class FloatingSelection
+{
+public:
+	// Takes the selected pixels that aren't chroma out of art, leaving
+	//  chroma behind.
+	void Lift( Surface& art,History& history,int layer,
+		const SelectionMask& selection,Color chroma );
+	// Writes the pixels into art where they've been moved to, anything off
+	//  the canvas gets cut off.
+	void Drop( Surface& art,History& history,int layer );
+	void MoveBy( const Vei2& amount );
+	void MoveTo( const Vei2& pos );
+
+	// Draws over a canvas that's at artPos with scale screen pixels per
+	//  canvas pixel.
+	void Draw( Graphics& gfx,const Vei2& artPos,int scale,
+		const RectI& clip ) const;
+
+	bool IsFloating() const;
+	// Top left of the lifted area in canvas pixels now, and where it was
+	//  lifted from.
+	Vei2 GetPos() const;
+	Vei2 GetOrigin() const;
+	Vei2 GetSize() const;
+private:
+	bool floating = false;
+	Color chroma = Colors::Magenta;
+	Vei2 origin = { 0,0 };
+	Vei2 pos = { 0,0 };
+	// Selection bounds worth of pixels, chroma wherever nothing got lifted.
+	//  Only reallocated when the bounds change size.
+	Surface pixels = { 0,0 };
+	// Runs of lifted pixels, relative to the top left of pixels.
+	std::vector<Surface::Span> spans;
+	// Spans moved into canvas space, reused between lifts and drops.
+	std::vector<Surface::Span> placed;
+};
\ No newline at end of file
@@ -15,3 +15,9 @@ float FrameTimer::Mark()
 	return frameTime.count();
 }
 
+float FrameTimer::Peek() const
+{
+	const duration<float> sinceMark = steady_clock::now() - last;
+	return sinceMark.count();
+}
+
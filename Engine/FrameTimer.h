@@ -7,6 +7,8 @@ class FrameTimer
 public:
 	FrameTimer();
 	float Mark();
+	// Seconds since the last Mark without marking.
+	float Peek() const;
 private:
 	std::chrono::steady_clock::time_point last;
 };
\ No newline at end of file
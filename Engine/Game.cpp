@@ -20,24 +20,105 @@
  ******************************************************************************************/
 #include "MainWindow.h"
 #include "Game.h"
+#include "D3DBackend.h"
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <filesystem>
+
+namespace
+{
+	// User + kernel time this process has used, in seconds.
+	float GetCpuTime()
+	{
+		FILETIME creation;
+		FILETIME exit;
+		FILETIME kernel;
+		FILETIME user;
+		if( !GetProcessTimes( GetCurrentProcess(),&creation,&exit,&kernel,&user ) )
+		{
+			return( 0.0f );
+		}
+		const auto toTicks = []( const FILETIME& ft )
+		{
+			return( ULONGLONG( ft.dwHighDateTime ) << 32 |
+				ft.dwLowDateTime );
+		};
+		// Filetimes count 100ns ticks.
+		return( float( double( toTicks( kernel ) + toTicks( user ) ) * 1.0e-7 ) );
+	}
+}
 
 Game::Game( MainWindow& wnd )
 	:
 	wnd( wnd ),
-	gfx( wnd ),
-	canv( wnd.mouse,wnd )
-{}
+	gfx( std::make_unique<D3DBackend>( wnd ) ),
+	canv( wnd.mouse,wnd.kbd,wnd,wnd )
+{
+	static const std::wstring recordFlag = L"-record ";
+	const auto& args = wnd.GetArgs();
+	if( args.compare( 0,recordFlag.length(),recordFlag ) == 0 )
+	{
+		recordPath = args.substr( recordFlag.length() );
+		if( recordPath.length() >= 2 && recordPath.front() == L'"' &&
+			recordPath.back() == L'"' )
+		{
+			recordPath = recordPath.substr( 1,recordPath.length() - 2 );
+		}
+		wnd.mouse.SetRecording( &recording );
+		wnd.kbd.SetRecording( &recording );
+	}
+}
+
+Game::~Game()
+{
+	if( recordPath.empty() ) return;
+
+	wnd.mouse.SetRecording( nullptr );
+	wnd.kbd.SetRecording( nullptr );
+	recording.Save( std::filesystem::path( recordPath ).string() );
+}
 
 void Game::Go()
 {
-	gfx.BeginFrame();
-	UpdateModel();
-	ComposeFrame();
-	gfx.EndFrame();
+	// Held keys and buttons keep tools running without new messages.
+	if( wnd.ConsumeInput() || wnd.kbd.AnyKeyIsPressed() ||
+		wnd.mouse.LeftIsPressed() || wnd.mouse.RightIsPressed() ||
+		canv.IsBusy() )
+	{
+		redrawFrames = settleFrames;
+	}
+
+	if( redrawFrames > 0 )
+	{
+		--redrawFrames;
+		workTimer.Mark();
+		gfx.BeginFrame();
+		UpdateModel();
+		recording.NextFrame();
+		ComposeFrame();
+		workTime += workTimer.Mark();
+		gfx.EndFrame();
+		++nFramesDrawn;
+	}
+	else
+	{
+		// Nothing changed, the last frame stays on screen until input or
+		//  something that changes on its own is due.
+		const float untilChange = std::ceil( canv.GetTimeToChange() * 1000.0f );
+		wnd.WaitForMessage( untilChange < float( idleTimeout )
+			? static_cast< unsigned int >( std::max( 0.0f,untilChange ) ) : idleTimeout );
+		++nFramesSkipped;
+	}
+
+	UpdateStats( loopTimer.Mark() );
 }
 
 void Game::UpdateModel()
 {
+	// Nothing reads typed text yet, don't let it fill up and count as
+	//  dropped input.
+	wnd.kbd.FlushChar();
 	canv.Update( wnd.kbd );
 }
 
@@ -45,3 +126,31 @@ void Game::ComposeFrame()
 {
 	canv.Draw( gfx );
 }
+
+void Game::UpdateStats( float dt )
+{
+	statTime += dt;
+	if( statTime < 1.0f ) return;
+
+	const float cpuTime = GetCpuTime();
+	const float cpuPercent = ( cpuTime - lastCpuTime ) / statTime * 100.0f;
+	const float msPerFrame = nFramesDrawn > 0
+		? workTime / float( nFramesDrawn ) * 1000.0f : 0.0f;
+
+	// Input lost to full buffers, only worth showing once it happens.
+	const unsigned int nDropped = wnd.mouse.GetDroppedCount() +
+		wnd.kbd.GetDroppedCount();
+
+	wnd.SetTitle( L"Aesc Sprite - " +
+		std::to_wstring( int( float( nFramesDrawn ) / statTime + 0.5f ) ) + L" fps, " +
+		std::to_wstring( msPerFrame ).substr( 0,4 ) + L" ms/frame, " +
+		std::to_wstring( nFramesSkipped ) + L" idle, cpu " +
+		std::to_wstring( int( cpuPercent + 0.5f ) ) + L"%" +
+		( nDropped > 0u ? L", " + std::to_wstring( nDropped ) + L" inputs dropped" : L"" ) );
+
+	lastCpuTime = cpuTime;
+	statTime = 0.0f;
+	workTime = 0.0f;
+	nFramesDrawn = 0;
+	nFramesSkipped = 0;
+}
@@ -24,11 +24,15 @@
 #include "Mouse.h"
 #include "Graphics.h"
 #include "Canvas.h"
+#include "FrameTimer.h"
+#include "InputRecording.h"
+#include <string>
 
 class Game
 {
 public:
 	Game( class MainWindow& wnd );
+	~Game();
 	Game( const Game& ) = delete;
 	Game& operator=( const Game& ) = delete;
 	void Go();
@@ -37,6 +41,8 @@ private:
 	void UpdateModel();
 	/********************************/
 	/*  User Functions              */
+	// Puts frame and cpu counters in the title once a second.
+	void UpdateStats( float dt );
 	/********************************/
 private:
 	MainWindow& wnd;
@@ -44,5 +50,22 @@ private:
 	/********************************/
 	/*  User Variables              */
 	Canvas canv;
+	// Frames to keep drawing after the last input, lets edge
+	//  triggered ui state settle before going idle.
+	static constexpr int settleFrames = 2;
+	int redrawFrames = settleFrames;
+	// How long to sleep waiting for input when idle, in ms.
+	static constexpr unsigned int idleTimeout = 500u;
+	FrameTimer loopTimer;
+	FrameTimer workTimer;
+	float statTime = 0.0f;
+	float workTime = 0.0f;
+	int nFramesDrawn = 0;
+	int nFramesSkipped = 0;
+	float lastCpuTime = 0.0f;
+	// Started with -record <file>, input gets saved there on exit so
+	//  aesc_headless can replay it.
+	InputRecording recording;
+	std::wstring recordPath;
 	/********************************/
 };
\ No newline at end of file
@@ -18,227 +18,21 @@
 *	You should have received a copy of the GNU General Public License					  *
 *	along with The Chili DirectX Framework.  If not, see <http://www.gnu.org/licenses/>.  *
 ******************************************************************************************/
-#include "MainWindow.h"
 #include "Graphics.h"
-#include "DXErr.h"
-#include "ChiliException.h"
 #include <assert.h>
 #include <string>
-#include <array>
+#include <algorithm>
+#include <cstring>
 #include "SpriteEffect.h"
+#include "Blend.h"
 
-// Ignore the intellisense error "cannot open source file" for .shh files.
-// They will be created during the build sequence before the preprocessor runs.
-namespace FramebufferShaders
-{
-#include "FramebufferPS.shh"
-#include "FramebufferVS.shh"
-}
-
-#pragma comment( lib,"d3d11.lib" )
-
-#define CHILI_GFX_EXCEPTION( hr,note ) Graphics::Exception( hr,note,_CRT_WIDE(__FILE__),__LINE__ )
-
-using Microsoft::WRL::ComPtr;
-
-Graphics::Graphics( HWNDKey& key )
+Graphics::Graphics( std::unique_ptr<GraphicsBackend> backend )
+	:
+	pBackend( std::move( backend ) ),
+	sysBuffer( size_t( Graphics::ScreenWidth * Graphics::ScreenHeight ) ),
+	pSysBuffer( sysBuffer.data() )
 {
-	assert( key.hWnd != nullptr );
-
-	//////////////////////////////////////////////////////
-	// create device and swap chain/get render target view
-	DXGI_SWAP_CHAIN_DESC sd = {};
-	sd.BufferCount = 1;
-	sd.BufferDesc.Width = Graphics::ScreenWidth;
-	sd.BufferDesc.Height = Graphics::ScreenHeight;
-	sd.BufferDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
-	sd.BufferDesc.RefreshRate.Numerator = 1;
-	sd.BufferDesc.RefreshRate.Denominator = 60;
-	sd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-	sd.OutputWindow = key.hWnd;
-	sd.SampleDesc.Count = 1;
-	sd.SampleDesc.Quality = 0;
-	sd.Windowed = TRUE;
-
-	HRESULT				hr;
-	UINT				createFlags = 0u;
-#ifdef CHILI_USE_D3D_DEBUG_LAYER
-#ifdef _DEBUG
-	createFlags |= D3D11_CREATE_DEVICE_DEBUG;
-#endif
-#endif
-
-	// create device and front/back buffers
-	if( FAILED( hr = D3D11CreateDeviceAndSwapChain(
-		nullptr,
-		D3D_DRIVER_TYPE_HARDWARE,
-		nullptr,
-		createFlags,
-		nullptr,
-		0,
-		D3D11_SDK_VERSION,
-		&sd,
-		&pSwapChain,
-		&pDevice,
-		nullptr,
-		&pImmediateContext ) ) )
-	{
-		throw CHILI_GFX_EXCEPTION( hr,L"Creating device and swap chain" );
-	}
-
-	// get handle to backbuffer
-	ComPtr<ID3D11Resource> pBackBuffer;
-	if( FAILED( hr = pSwapChain->GetBuffer(
-		0,
-		__uuidof( ID3D11Texture2D ),
-		( LPVOID* )&pBackBuffer ) ) )
-	{
-		throw CHILI_GFX_EXCEPTION( hr,L"Getting back buffer" );
-	}
-
-	// create a view on backbuffer that we can render to
-	if( FAILED( hr = pDevice->CreateRenderTargetView(
-		pBackBuffer.Get(),
-		nullptr,
-		&pRenderTargetView ) ) )
-	{
-		throw CHILI_GFX_EXCEPTION( hr,L"Creating render target view on backbuffer" );
-	}
-
-
-	// set backbuffer as the render target using created view
-	pImmediateContext->OMSetRenderTargets( 1,pRenderTargetView.GetAddressOf(),nullptr );
-
-
-	// set viewport dimensions
-	D3D11_VIEWPORT vp;
-	vp.Width = float( Graphics::ScreenWidth );
-	vp.Height = float( Graphics::ScreenHeight );
-	vp.MinDepth = 0.0f;
-	vp.MaxDepth = 1.0f;
-	vp.TopLeftX = 0.0f;
-	vp.TopLeftY = 0.0f;
-	pImmediateContext->RSSetViewports( 1,&vp );
-
-
-	///////////////////////////////////////
-	// create texture for cpu render target
-	D3D11_TEXTURE2D_DESC sysTexDesc;
-	sysTexDesc.Width = Graphics::ScreenWidth;
-	sysTexDesc.Height = Graphics::ScreenHeight;
-	sysTexDesc.MipLevels = 1;
-	sysTexDesc.ArraySize = 1;
-	sysTexDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
-	sysTexDesc.SampleDesc.Count = 1;
-	sysTexDesc.SampleDesc.Quality = 0;
-	sysTexDesc.Usage = D3D11_USAGE_DYNAMIC;
-	sysTexDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-	sysTexDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	sysTexDesc.MiscFlags = 0;
-	// create the texture
-	if( FAILED( hr = pDevice->CreateTexture2D( &sysTexDesc,nullptr,&pSysBufferTexture ) ) )
-	{
-		throw CHILI_GFX_EXCEPTION( hr,L"Creating sysbuffer texture" );
-	}
-
-	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-	srvDesc.Format = sysTexDesc.Format;
-	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MipLevels = 1;
-	// create the resource view on the texture
-	if( FAILED( hr = pDevice->CreateShaderResourceView( pSysBufferTexture.Get(),
-		&srvDesc,&pSysBufferTextureView ) ) )
-	{
-		throw CHILI_GFX_EXCEPTION( hr,L"Creating view on sysBuffer texture" );
-	}
-
-
-	////////////////////////////////////////////////
-	// create pixel shader for framebuffer
-	// Ignore the intellisense error "namespace has no member"
-	if( FAILED( hr = pDevice->CreatePixelShader(
-		FramebufferShaders::FramebufferPSBytecode,
-		sizeof( FramebufferShaders::FramebufferPSBytecode ),
-		nullptr,
-		&pPixelShader ) ) )
-	{
-		throw CHILI_GFX_EXCEPTION( hr,L"Creating pixel shader" );
-	}
-
-
-	/////////////////////////////////////////////////
-	// create vertex shader for framebuffer
-	// Ignore the intellisense error "namespace has no member"
-	if( FAILED( hr = pDevice->CreateVertexShader(
-		FramebufferShaders::FramebufferVSBytecode,
-		sizeof( FramebufferShaders::FramebufferVSBytecode ),
-		nullptr,
-		&pVertexShader ) ) )
-	{
-		throw CHILI_GFX_EXCEPTION( hr,L"Creating vertex shader" );
-	}
-
-
-	//////////////////////////////////////////////////////////////
-	// create and fill vertex buffer with quad for rendering frame
-	const FSQVertex vertices[] =
-	{
-		{ -1.0f,1.0f,0.5f,0.0f,0.0f },
-	{ 1.0f,1.0f,0.5f,1.0f,0.0f },
-	{ 1.0f,-1.0f,0.5f,1.0f,1.0f },
-	{ -1.0f,1.0f,0.5f,0.0f,0.0f },
-	{ 1.0f,-1.0f,0.5f,1.0f,1.0f },
-	{ -1.0f,-1.0f,0.5f,0.0f,1.0f },
-	};
-	D3D11_BUFFER_DESC bd = {};
-	bd.Usage = D3D11_USAGE_DEFAULT;
-	bd.ByteWidth = sizeof( FSQVertex ) * 6;
-	bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	bd.CPUAccessFlags = 0u;
-	D3D11_SUBRESOURCE_DATA initData = {};
-	initData.pSysMem = vertices;
-	if( FAILED( hr = pDevice->CreateBuffer( &bd,&initData,&pVertexBuffer ) ) )
-	{
-		throw CHILI_GFX_EXCEPTION( hr,L"Creating vertex buffer" );
-	}
-
-
-	//////////////////////////////////////////
-	// create input layout for fullscreen quad
-	const D3D11_INPUT_ELEMENT_DESC ied[] =
-	{
-		{ "POSITION",0,DXGI_FORMAT_R32G32B32_FLOAT,0,0,D3D11_INPUT_PER_VERTEX_DATA,0 },
-	{ "TEXCOORD",0,DXGI_FORMAT_R32G32_FLOAT,0,12,D3D11_INPUT_PER_VERTEX_DATA,0 }
-	};
-
-	// Ignore the intellisense error "namespace has no member"
-	if( FAILED( hr = pDevice->CreateInputLayout( ied,2,
-		FramebufferShaders::FramebufferVSBytecode,
-		sizeof( FramebufferShaders::FramebufferVSBytecode ),
-		&pInputLayout ) ) )
-	{
-		throw CHILI_GFX_EXCEPTION( hr,L"Creating input layout" );
-	}
-
-
-	////////////////////////////////////////////////////
-	// Create sampler state for fullscreen textured quad
-	D3D11_SAMPLER_DESC sampDesc = {};
-	sampDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_POINT;
-	sampDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
-	sampDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
-	sampDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
-	sampDesc.ComparisonFunc = D3D11_COMPARISON_NEVER;
-	sampDesc.MinLOD = 0;
-	sampDesc.MaxLOD = D3D11_FLOAT32_MAX;
-	if( FAILED( hr = pDevice->CreateSamplerState( &sampDesc,&pSamplerState ) ) )
-	{
-		throw CHILI_GFX_EXCEPTION( hr,L"Creating sampler state" );
-	}
-
-	// allocate memory for sysbuffer (16-byte aligned for faster access)
-	pSysBuffer = reinterpret_cast< Color* >(
-		_aligned_malloc( sizeof( Color ) * Graphics::ScreenWidth * Graphics::ScreenHeight,16u ) );
+	assert( pBackend != nullptr );
 }
 
 void Graphics::JSDrawImage( const Surface& image,int sx,int sy,int sWidth,int sHeight,
@@ -250,70 +44,79 @@ void Graphics::JSDrawImage( const Surface& image,int sx,int sy,int sWidth,int sH
 	DrawSprite( dx,dy,clipRect,GetScreenRect(),enlarged,SpriteEffect::Copy(),false );
 }
 
-Graphics::~Graphics()
+void Graphics::DrawSpriteOnCheckerboard( int x,int y,const RectI& clip,
+	const Surface& s,int scale,int cellSize,Color c1,Color c2 )
 {
-	// free sysbuffer memory (aligned free)
-	if( pSysBuffer )
-	{
-		_aligned_free( pSysBuffer );
-		pSysBuffer = nullptr;
+	assert( scale > 0 );
+	assert( cellSize > 0 );
+
+	const int left = std::max( x,clip.left );
+	const int right = std::min( x + s.GetWidth() * scale,clip.right );
+	const int top = std::max( y,clip.top );
+	const int bottom = std::min( y + s.GetHeight() * scale,clip.bottom );
+	if( left >= right || top >= bottom ) return;
+
+	// Source columns that show, the outer two can be partly clipped.
+	const int firstCol = ( left - x ) / scale;
+	const int lastCol = ( right - 1 - x ) / scale;
+	const Color* pSrc = s.GetRawPixelData().data();
+	const int srcPitch = s.GetWidth();
+	int lastSrcY = -1;
+	int lastCellY = -1;
+	for( int dy = top; dy < bottom; ++dy )
+	{
+		Color* dstRow = &pSysBuffer[dy * ScreenWidth];
+		const int sy = ( dy - y ) / scale;
+		// Cells are counted from the unclipped corner so the pattern
+		//  moves with the sprite instead of with the clip.
+		const int cellY = ( dy - y ) / cellSize;
+
+		// Same source row and same checker row looks the same as the one
+		//  above, which happens scale - 1 times out of scale when zoomed.
+		if( sy == lastSrcY && cellY == lastCellY )
+		{
+			const Color* prevRow = dstRow - ScreenWidth;
+			std::copy( prevRow + left,prevRow + right,dstRow + left );
+			continue;
+		}
+		lastSrcY = sy;
+		lastCellY = cellY;
+
+		const Color* srcRow = &pSrc[sy * srcPitch];
+		for( int sx = firstCol; sx <= lastCol; ++sx )
+		{
+			const Color c = srcRow[sx];
+			const int runLeft = std::max( x + sx * scale,left );
+			const int runRight = std::min( x + ( sx + 1 ) * scale,right );
+			const auto a = c.GetA();
+			if( a == 255 )
+			{
+				std::fill( dstRow + runLeft,dstRow + runRight,c );
+				continue;
+			}
+
+			// Fill the block one checker cell at a time.
+			for( int dx = runLeft; dx < runRight; )
+			{
+				const int cellX = ( dx - x ) / cellSize;
+				const int cellEnd = std::min( runRight,
+					x + ( cellX + 1 ) * cellSize );
+				const Color checker = ( ( cellX + cellY ) & 1 ) == 0
+					? c1 : c2;
+				std::fill( dstRow + dx,dstRow + cellEnd,
+					a == 0 ? checker : Blend::Over( checker,c ) );
+				dx = cellEnd;
+			}
+		}
 	}
-	// clear the state of the device context before destruction
-	if( pImmediateContext ) pImmediateContext->ClearState();
 }
-
 RectI Graphics::GetScreenRect()
 {
 	return RectI{ 0,ScreenWidth,0,ScreenHeight };
 }
-
 void Graphics::EndFrame()
 {
-	HRESULT hr;
-
-	// lock and map the adapter memory for copying over the sysbuffer
-	if( FAILED( hr = pImmediateContext->Map( pSysBufferTexture.Get(),0u,
-		D3D11_MAP_WRITE_DISCARD,0u,&mappedSysBufferTexture ) ) )
-	{
-		throw CHILI_GFX_EXCEPTION( hr,L"Mapping sysbuffer" );
-	}
-	// setup parameters for copy operation
-	Color* pDst = reinterpret_cast< Color* >( mappedSysBufferTexture.pData );
-	const size_t dstPitch = mappedSysBufferTexture.RowPitch / sizeof( Color );
-	const size_t srcPitch = Graphics::ScreenWidth;
-	const size_t rowBytes = srcPitch * sizeof( Color );
-	// perform the copy line-by-line
-	for( size_t y = 0u; y < Graphics::ScreenHeight; y++ )
-	{
-		memcpy( &pDst[y * dstPitch],&pSysBuffer[y * srcPitch],rowBytes );
-	}
-	// release the adapter memory
-	pImmediateContext->Unmap( pSysBufferTexture.Get(),0u );
-
-	// render offscreen scene texture to back buffer
-	pImmediateContext->IASetInputLayout( pInputLayout.Get() );
-	pImmediateContext->VSSetShader( pVertexShader.Get(),nullptr,0u );
-	pImmediateContext->PSSetShader( pPixelShader.Get(),nullptr,0u );
-	pImmediateContext->IASetPrimitiveTopology( D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST );
-	const UINT stride = sizeof( FSQVertex );
-	const UINT offset = 0u;
-	pImmediateContext->IASetVertexBuffers( 0u,1u,pVertexBuffer.GetAddressOf(),&stride,&offset );
-	pImmediateContext->PSSetShaderResources( 0u,1u,pSysBufferTextureView.GetAddressOf() );
-	pImmediateContext->PSSetSamplers( 0u,1u,pSamplerState.GetAddressOf() );
-	pImmediateContext->Draw( 6u,0u );
-
-	// flip back/front buffers
-	if( FAILED( hr = pSwapChain->Present( 1u,0u ) ) )
-	{
-		if( hr == DXGI_ERROR_DEVICE_REMOVED )
-		{
-			throw CHILI_GFX_EXCEPTION( pDevice->GetDeviceRemovedReason(),L"Presenting back buffer [device removed]" );
-		}
-		else
-		{
-			throw CHILI_GFX_EXCEPTION( hr,L"Presenting back buffer" );
-		}
-	}
+	pBackend->Present( pSysBuffer,Graphics::ScreenWidth,Graphics::ScreenHeight );
 }
 
 void Graphics::BeginFrame()
@@ -336,10 +139,13 @@ void Graphics::PutPixel( int x,int y,Color c,unsigned char alpha )
 	const Color srcPixel = c;
 	const Color dstPixel = pSysBuffer[y * ScreenWidth + x];
 
+	const int a = alpha;
+	const int inv = 255 - alpha;
+	typedef unsigned char uchar;
 	const Color blendedPixel = {
-		unsigned char( ( dstPixel.GetR() + srcPixel.GetR() ) / 2 ),
-		unsigned char( ( dstPixel.GetG() + srcPixel.GetG() ) / 2 ),
-		unsigned char( ( dstPixel.GetB() + srcPixel.GetB() ) / 2 )
+		uchar( ( srcPixel.GetR() * a + dstPixel.GetR() * inv + 127 ) / 255 ),
+		uchar( ( srcPixel.GetG() * a + dstPixel.GetG() * inv + 127 ) / 255 ),
+		uchar( ( srcPixel.GetB() * a + dstPixel.GetB() * inv + 127 ) / 255 )
 	};
 
 	pSysBuffer[Graphics::ScreenWidth * y + x] = blendedPixel;
@@ -347,7 +153,8 @@ void Graphics::PutPixel( int x,int y,Color c,unsigned char alpha )
 
 void Graphics::PutPixel( int x,int y,Color c,float alpha )
 {
-	PutPixel( x,y,c,unsigned char( alpha * 255 ) );
+	typedef unsigned char uchar;
+	PutPixel( x,y,c,uchar( alpha * 255 ) );
 }
 
 void Graphics::PutPixelAlpha( int x,int y,Color c,float alpha )
@@ -581,46 +388,3 @@ void Graphics::DrawLineInverse( Vec2 p0,Vec2 p1 )
 		}
 	}
 }
-
-
-//////////////////////////////////////////////////
-//           Graphics Exception
-Graphics::Exception::Exception( HRESULT hr,const std::wstring& note,const wchar_t* file,unsigned int line )
-	:
-	ChiliException( file,line,note ),
-	hr( hr )
-{}
-
-std::wstring Graphics::Exception::GetFullMessage() const
-{
-	const std::wstring empty = L"";
-	const std::wstring errorName = GetErrorName();
-	const std::wstring errorDesc = GetErrorDescription();
-	const std::wstring& note = GetNote();
-	const std::wstring location = GetLocation();
-	return    ( !errorName.empty() ? std::wstring( L"Error: " ) + errorName + L"\n"
-		: empty )
-		+ ( !errorDesc.empty() ? std::wstring( L"Description: " ) + errorDesc + L"\n"
-			: empty )
-		+ ( !note.empty() ? std::wstring( L"Note: " ) + note + L"\n"
-			: empty )
-		+ ( !location.empty() ? std::wstring( L"Location: " ) + location
-			: empty );
-}
-
-std::wstring Graphics::Exception::GetErrorName() const
-{
-	return DXGetErrorString( hr );
-}
-
-std::wstring Graphics::Exception::GetErrorDescription() const
-{
-	std::array<wchar_t,512> wideDescription;
-	DXGetErrorDescription( hr,wideDescription.data(),wideDescription.size() );
-	return wideDescription.data();
-}
-
-std::wstring Graphics::Exception::GetExceptionType() const
-{
-	return L"Chili Graphics Exception";
-}
\ No newline at end of file
@@ -19,38 +19,20 @@
 *	along with The Chili DirectX Framework.  If not, see <http://www.gnu.org/licenses/>.  *
 ******************************************************************************************/
 #pragma once
-#include "ChiliWin.h"
-#include <d3d11.h>
-#include <wrl.h>
-#include "ChiliException.h"
 #include "Colors.h"
 #include "Surface.h"
 #include "Rect.h"
+#include "GraphicsBackend.h"
 #include <cassert>
+#include <algorithm>
+#include <memory>
+#include <vector>
 
 class Graphics
 {
 public:
-	class Exception : public ChiliException
-	{
-	public:
-		Exception( HRESULT hr,const std::wstring& note,const wchar_t* file,unsigned int line );
-		std::wstring GetErrorName() const;
-		std::wstring GetErrorDescription() const;
-		virtual std::wstring GetFullMessage() const override;
-		virtual std::wstring GetExceptionType() const override;
-	private:
-		HRESULT hr;
-	};
-private:
-	// vertex format for the framebuffer fullscreen textured quad
-	struct FSQVertex
-	{
-		float x,y,z;		// position
-		float u,v;			// texcoords
-	};
-public:
-	Graphics( class HWNDKey& key );
+	// Draws into a system memory buffer, EndFrame hands it to backend.
+	explicit Graphics( std::unique_ptr<GraphicsBackend> backend );
 	Graphics( const Graphics& ) = delete;
 	Graphics& operator=( const Graphics& ) = delete;
 	void EndFrame();
@@ -58,7 +40,8 @@ public:
 	void InvertPixelAt( int x,int y );
 	void PutPixel( int x,int y,int r,int g,int b )
 	{
-		PutPixel( x,y,{ unsigned char( r ),unsigned char( g ),unsigned char( b ) } );
+		typedef unsigned char uchar;
+		PutPixel( x,y,{ uchar( r ),uchar( g ),uchar( b ) } );
 	}
 	Color& GetPixel( int x,int y ) const;
 	void PutPixel( int x,int y,Color c );
@@ -210,6 +193,44 @@ public:
 		}
 	}
 
+	// Draws s zoomed in so each of its pixels is a scale by scale block,
+	//  only visiting screen pixels inside clip.
+	template<typename E>
+	void DrawSpriteScaled( int x,int y,const RectI& clip,const Surface& s,
+		int scale,E effect )
+	{
+		assert( scale > 0 );
+		const int left = std::max( x,clip.left );
+		const int right = std::min( x + s.GetWidth() * scale,clip.right );
+		const int top = std::max( y,clip.top );
+		const int bottom = std::min( y + s.GetHeight() * scale,clip.bottom );
+		if( left >= right || top >= bottom ) return;
+
+		for( int dy = top; dy < bottom; ++dy )
+		{
+			const int sy = ( dy - y ) / scale;
+			// Step through source columns instead of dividing per pixel.
+			int sx = ( left - x ) / scale;
+			int sub = ( left - x ) % scale;
+			for( int dx = left; dx < right; ++dx )
+			{
+				effect( s.GetPixel( sx,sy ),dx,dy,*this );
+				if( ++sub == scale )
+				{
+					sub = 0;
+					++sx;
+				}
+			}
+		}
+	}
+
+	// Draws premultiplied s zoomed in so each pixel is a scale by scale
+	//  block, over a checkerboard of cellSize screen pixels anchored to the
+	//  sprite's top left.  Checker only shows through pixels that aren't
+	//  fully opaque, and only screen pixels inside clip get touched.
+	void DrawSpriteOnCheckerboard( int x,int y,const RectI& clip,
+		const Surface& s,int scale,int cellSize,Color c1,Color c2 );
+
 	void JSDrawImage( const Surface& image,int dx,int dy )
 	{
 		JSDrawImage( image,dx,dy,image.GetWidth(),image.GetHeight() );
@@ -220,21 +241,10 @@ public:
 			dx,dy,dWidth,dHeight );
 	}
 	void JSDrawImage( const Surface& image,int sx,int sy,int sWidth,int sHeight,int dx,int dy,int dWidth,int dHeight );
-	~Graphics();
 private:
-	Microsoft::WRL::ComPtr<IDXGISwapChain>				pSwapChain;
-	Microsoft::WRL::ComPtr<ID3D11Device>				pDevice;
-	Microsoft::WRL::ComPtr<ID3D11DeviceContext>			pImmediateContext;
-	Microsoft::WRL::ComPtr<ID3D11RenderTargetView>		pRenderTargetView;
-	Microsoft::WRL::ComPtr<ID3D11Texture2D>				pSysBufferTexture;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>	pSysBufferTextureView;
-	Microsoft::WRL::ComPtr<ID3D11PixelShader>			pPixelShader;
-	Microsoft::WRL::ComPtr<ID3D11VertexShader>			pVertexShader;
-	Microsoft::WRL::ComPtr<ID3D11Buffer>				pVertexBuffer;
-	Microsoft::WRL::ComPtr<ID3D11InputLayout>			pInputLayout;
-	Microsoft::WRL::ComPtr<ID3D11SamplerState>			pSamplerState;
-	D3D11_MAPPED_SUBRESOURCE							mappedSysBufferTexture;
-	Color*                                              pSysBuffer = nullptr;
+	std::unique_ptr<GraphicsBackend> pBackend;
+	std::vector<Color> sysBuffer;
+	Color* pSysBuffer = nullptr;
 public:
 	static constexpr int ScreenWidth = 16 * 70;
 	static constexpr int ScreenHeight = 9 * 70;
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "Colors.h"
+
+// Where finished frames go.  Graphics does all its drawing in system
+//  memory, a backend only has to show or store the result.
+class GraphicsBackend
+{
+public:
+	virtual ~GraphicsBackend() = default;
+	// pixels is width * height with no row padding.
+	virtual void Present( const Color* pixels,int width,int height ) = 0;
+};
\ No newline at end of file
@@ -0,0 +1,39 @@
+#include "HeadlessBackend.h"
+#include "WriteToBitmap.h"
+
+HeadlessBackend::HeadlessBackend()
+	:
+	HeadlessBackend( "" )
+{}
+
+HeadlessBackend::HeadlessBackend( const std::string& outputPath )
+	:
+	outputPath( outputPath )
+{}
+
+void HeadlessBackend::Present( const Color* pixels,int width,int height )
+{
+	if( frame.GetWidth() != width || frame.GetHeight() != height )
+	{
+		frame = Surface{ width,height };
+	}
+	frame.CopyFrom( pixels );
+	++nFrames;
+
+	if( outputPath.length() > 0 ) WriteFrame( outputPath );
+}
+
+const Surface& HeadlessBackend::GetFrame() const
+{
+	return( frame );
+}
+
+int HeadlessBackend::GetFrameCount() const
+{
+	return( nFrames );
+}
+
+void HeadlessBackend::WriteFrame( const std::string& path ) const
+{
+	WriteToBitmap::Write( frame,path );
+}
\ No newline at end of file
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "GraphicsBackend.h"
+#include "Surface.h"
+#include <string>
+
+// Keeps presented frames in memory instead of showing them, for running
+//  the editor without a window (benchmarks, tests, linux builds).
+class HeadlessBackend : public GraphicsBackend
+{
+public:
+	HeadlessBackend();
+	// Also write every presented frame to outputPath as a bitmap.
+	HeadlessBackend( const std::string& outputPath );
+
+	void Present( const Color* pixels,int width,int height ) override;
+
+	// Last presented frame.
+	const Surface& GetFrame() const;
+	int GetFrameCount() const;
+	void WriteFrame( const std::string& path ) const;
+private:
+	Surface frame = { 0,0 };
+	int nFrames = 0;
+	std::string outputPath;
+};
\ No newline at end of file
@@ -0,0 +1,151 @@
+#include "Graphics.h"
+#include "HeadlessBackend.h"
+#include "Canvas.h"
+#include "CursorControl.h"
+#include "Wakeup.h"
+#include "FrameTimer.h"
+#include "Blend.h"
+#include "InputRecording.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Runs the editor without a window so rendering can be profiled on build
+//  machines.  Usage: AescHeadless [data dir] [frames] [out.bmp] [input]
+//  With an input file recorded by the app (-record <file>) it gets played
+//  back frame by frame, running longer than frames if it has to.
+namespace
+{
+	// Nothing to show or hide without a window.
+	class NoCursor : public CursorControl
+	{
+	public:
+		void HideCursor( bool ) override {}
+	};
+
+	// Frames are drawn back to back anyway.
+	class NoWakeup : public Wakeup
+	{
+	public:
+		void Wake() override {}
+	};
+
+	// FNV-1a, same document same hash on every machine.
+	void HashWord( uint64_t& hash,unsigned int word )
+	{
+		for( int i = 0; i < 4; ++i )
+		{
+			hash ^= ( word >> ( i * 8 ) ) & 0xFFu;
+			hash *= 1099511628211ull;
+		}
+	}
+
+	// Composited pixels of every animation frame, not the screen, so ui
+	//  changes don't invalidate recorded replays.
+	uint64_t HashDocument( const ImageHandler& imgHand )
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for( int i = 0; i < imgHand.GetFrameCount(); ++i )
+		{
+			// The current frame's stored cels can be behind the canvas.
+			const Surface frame = i == imgHand.GetCurFrame()
+				? imgHand.GetComposite() : imgHand.ComposeFrame( i );
+			HashWord( hash,unsigned( frame.GetWidth() ) );
+			HashWord( hash,unsigned( frame.GetHeight() ) );
+			for( const auto& c : frame.GetRawPixelData() ) HashWord( hash,c.dword );
+		}
+		return( hash );
+	}
+
+	// Nearest rank, times has to be sorted.
+	float Percentile( const std::vector<float>& times,int percent )
+	{
+		if( times.empty() ) return( 0.0f );
+		const size_t rank = ( times.size() * size_t( percent ) + 99 ) / 100;
+		return( times[std::max( rank,size_t( 1 ) ) - 1] );
+	}
+}
+
+int main( int argc,char* argv[] )
+{
+	const std::string dataDir = argc > 1 ? argv[1] : ".";
+	int nFrames = argc > 2 ? std::stoi( argv[2] ) : 60;
+	// Resolve before changing directory so they're relative to the caller.
+	const std::string outPath = argc > 3 && std::string( argv[3] ) != "-"
+		? std::filesystem::absolute( argv[3] ).string() : "";
+	const std::string inputPath = argc > 4
+		? std::filesystem::absolute( argv[4] ).string() : "";
+
+	InputRecording input;
+	if( inputPath.length() > 0 )
+	{
+		if( !input.Load( inputPath ) )
+		{
+			std::cerr << "can't read input from " << inputPath << std::endl;
+			return( 1 );
+		}
+		nFrames = std::max( nFrames,input.GetFrameCount() );
+	}
+
+	// Icons, fonts and palettes are loaded relative to the data dir.
+	std::filesystem::current_path( dataDir );
+
+	Keyboard kbd;
+	Mouse mouse;
+	NoCursor cursor;
+	NoWakeup wakeup;
+	auto backend = std::make_unique<HeadlessBackend>();
+	const auto& frames = *backend;
+	Graphics gfx( std::move( backend ) );
+	Canvas canv( mouse,kbd,cursor,wakeup );
+
+	std::vector<float> frameTimes;
+	frameTimes.reserve( nFrames );
+	FrameTimer ft;
+	for( int i = 0; i < nFrames; ++i )
+	{
+		input.Play( i,mouse,kbd );
+		ft.Mark();
+		gfx.BeginFrame();
+		canv.Update( kbd );
+		canv.Draw( gfx );
+		gfx.EndFrame();
+		frameTimes.emplace_back( ft.Mark() );
+	}
+
+	// Let background work like thumbnails finish so the last frame is the
+	//  same every run, these frames don't count towards the times.
+	for( int i = 0; i < 1000 && canv.IsBusy(); ++i )
+	{
+		std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+		gfx.BeginFrame();
+		canv.Update( kbd );
+		canv.Draw( gfx );
+		gfx.EndFrame();
+	}
+
+	float totalTime = 0.0f;
+	for( const auto t : frameTimes ) totalTime += t;
+	std::sort( frameTimes.begin(),frameTimes.end() );
+	const auto ms = [&]( int percent )
+	{
+		return( Percentile( frameTimes,percent ) * 1000.0f );
+	};
+
+	std::cout << nFrames << " frames, " <<
+		totalTime * 1000.0f / float( std::max( 1,nFrames ) ) <<
+		" ms/frame, p50 " << ms( 50 ) << " p90 " << ms( 90 ) <<
+		" p99 " << ms( 99 ) << " max " << ms( 100 ) <<
+		" ms, blend kernel " << Blend::GetKernelName() << std::endl;
+	std::cout << "document hash " << std::hex << std::setw( 16 ) <<
+		std::setfill( '0' ) << HashDocument( canv.GetImageHandler() ) << std::endl;
+
+	if( outPath.length() > 0 ) frames.WriteFrame( outPath );
+	return( 0 );
+}
\ No newline at end of file
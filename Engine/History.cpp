@@ -0,0 +1,448 @@
+#include "History.h"
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <iterator>
+
+History::History( size_t memoryBudget )
+	:
+	memoryBudget( memoryBudget )
+{}
+
+void History::Touch( const Surface& target,int layer,const RectI& area )
+{
+	if( !editing )
+	{
+		editing = true;
+		edit = Entry{};
+		editLayer = layer;
+		editSize = target.GetSize();
+		tilesWide = ( editSize.x + tileSize - 1 ) / tileSize;
+		tilesHigh = ( editSize.y + tileSize - 1 ) / tileSize;
+		// Only reallocate when the canvas changes size, EndEdit puts the
+		//  slots it used back to -1.
+		if( int( tileSlots.size() ) != tilesWide * tilesHigh )
+		{
+			tileSlots.assign( tilesWide * tilesHigh,-1 );
+		}
+	}
+	assert( layer == editLayer );
+	assert( target.GetSize() == editSize );
+
+	const int left = std::max( 0,area.left );
+	const int right = std::min( editSize.x,area.right );
+	const int top = std::max( 0,area.top );
+	const int bottom = std::min( editSize.y,area.bottom );
+	if( left >= right || top >= bottom ) return;
+
+	for( int ty = top / tileSize; ty <= ( bottom - 1 ) / tileSize; ++ty )
+	{
+		for( int tx = left / tileSize; tx <= ( right - 1 ) / tileSize; ++tx )
+		{
+			int& slot = tileSlots[ty * tilesWide + tx];
+			if( slot != -1 ) continue;
+
+			slot = int( edit.tiles.size() );
+			TileDelta tile;
+			tile.layer = layer;
+			tile.pos = { tx,ty };
+			tile.before = Pack( target,GetTileRect( tile.pos ) );
+			edit.tiles.emplace_back( std::move( tile ) );
+		}
+	}
+}
+
+void History::TouchPixel( const Surface& target,int layer,int x,int y )
+{
+	Touch( target,layer,RectI{ x,x + 1,y,y + 1 } );
+}
+
+void History::EndEdit( const Surface& target )
+{
+	if( !editing ) return;
+	editing = false;
+
+	std::vector<TileDelta> changed;
+	for( auto& tile : edit.tiles )
+	{
+		tileSlots[tile.pos.y * tilesWide + tile.pos.x] = -1;
+		// Canvas got resized under the edit, nothing sane to keep.
+		if( target.GetSize() != editSize ) continue;
+
+		tile.after = Pack( target,GetTileRect( tile.pos ) );
+		if( tile.after.data != tile.before.data )
+		{
+			changed.emplace_back( std::move( tile ) );
+		}
+	}
+	if( changed.empty() ) return;
+
+	if( grouping )
+	{
+		std::move( changed.begin(),changed.end(),
+			std::back_inserter( group.tiles ) );
+	}
+	else
+	{
+		edit.tiles = std::move( changed );
+		Push( std::move( edit ) );
+	}
+	edit = Entry{};
+}
+
+bool History::IsEditing() const
+{
+	return( editing );
+}
+
+void History::BeginGroup()
+{
+	assert( !editing && !grouping );
+	grouping = true;
+	group = Entry{};
+}
+
+void History::EndGroup()
+{
+	assert( !editing && grouping );
+	grouping = false;
+	if( !group.tiles.empty() ) Push( std::move( group ) );
+	group = Entry{};
+}
+
+void History::PushLayers( std::vector<LayerState> before,
+	std::vector<LayerState> after )
+{
+	// Whole layers are mostly long runs of magenta, so don't wait for them
+	//  to get old before packing them down.
+	const auto save = []( std::vector<LayerState>& states )
+	{
+		std::vector<SavedLayer> saved;
+		for( auto& state : states )
+		{
+			saved.emplace_back( SavedLayer{ state.pos,
+				Pack( state.surf,state.surf.GetRect() ),
+				state.opacity,state.mode,std::move( state.histogram ) } );
+			Compress( saved.back().pixels );
+		}
+		return( saved );
+	};
+
+	Entry entry;
+	entry.before = save( before );
+	entry.after = save( after );
+	Push( std::move( entry ) );
+}
+
+void History::PushMove( int from,int to )
+{
+	Entry entry;
+	entry.moveFrom = from;
+	entry.moveTo = to;
+	Push( std::move( entry ) );
+}
+
+void History::PushResize( const Vei2& oldSize,const Vei2& newSize,
+	const std::vector<Surface>& pixels,std::vector<Restore> restore )
+{
+	Entry entry;
+	entry.frame = allFrames;
+	entry.oldSize = oldSize;
+	entry.newSize = newSize;
+	for( const auto& surf : pixels )
+	{
+		entry.pixels.emplace_back( Pack( surf,surf.GetRect() ) );
+		Compress( entry.pixels.back() );
+	}
+	entry.restore = std::move( restore );
+	Push( std::move( entry ) );
+}
+
+void History::SetFrame( int frame )
+{
+	assert( !editing && !grouping );
+	this->frame = frame;
+}
+
+void History::Forget( int frame )
+{
+	assert( !editing && !grouping );
+	// Other frames' entries don't depend on it, they can stay.
+	const auto drop = [this,frame]( Entry& entry )
+	{
+		memoryUsed -= entry.bytes;
+		if( entry.frame == frame ) return( true );
+
+		// Resizes let go of pixels nothing else was getting back, indices
+		//  stay put.
+		entry.restore.erase( std::remove_if( entry.restore.begin(),
+			entry.restore.end(),[frame]( const Restore& restore )
+			{
+				return( restore.frame == frame );
+			} ),entry.restore.end() );
+		std::vector<bool> used( entry.pixels.size(),false );
+		for( const auto& restore : entry.restore ) used[restore.pixels] = true;
+		for( size_t i = 0; i < used.size(); ++i )
+		{
+			if( !used[i] ) entry.pixels[i] = Packed{};
+		}
+		entry.bytes = GetSize( entry );
+		memoryUsed += entry.bytes;
+		return( false );
+	};
+	undoStack.erase( std::remove_if( undoStack.begin(),undoStack.end(),drop ),
+		undoStack.end() );
+	redoStack.erase( std::remove_if( redoStack.begin(),redoStack.end(),drop ),
+		redoStack.end() );
+}
+
+bool History::Undo( Change& change )
+{
+	assert( !editing );
+	if( undoStack.empty() ) return( false );
+
+	FillChange( undoStack.back(),true,change );
+	redoStack.emplace_back( std::move( undoStack.back() ) );
+	undoStack.pop_back();
+	return( true );
+}
+
+bool History::Redo( Change& change )
+{
+	assert( !editing );
+	if( redoStack.empty() ) return( false );
+
+	FillChange( redoStack.back(),false,change );
+	undoStack.emplace_back( std::move( redoStack.back() ) );
+	redoStack.pop_back();
+	return( true );
+}
+
+void History::Clear()
+{
+	if( editing )
+	{
+		for( const auto& tile : edit.tiles )
+		{
+			tileSlots[tile.pos.y * tilesWide + tile.pos.x] = -1;
+		}
+		editing = false;
+		edit = Entry{};
+	}
+	grouping = false;
+	group = Entry{};
+	undoStack.clear();
+	redoStack.clear();
+	memoryUsed = 0;
+}
+
+void History::SetMemoryBudget( size_t bytes )
+{
+	memoryBudget = bytes;
+	Evict();
+}
+
+size_t History::GetMemoryUsed() const
+{
+	return( memoryUsed );
+}
+
+void History::Push( Entry&& entry )
+{
+	// A new edit makes everything that was undone unreachable.
+	for( const auto& old : redoStack ) memoryUsed -= old.bytes;
+	redoStack.clear();
+
+	// Whole document changes keep their tag.
+	if( entry.frame != allFrames ) entry.frame = frame;
+	entry.bytes = GetSize( entry );
+	memoryUsed += entry.bytes;
+	undoStack.emplace_back( std::move( entry ) );
+
+	CompressOld();
+	Evict();
+}
+
+void History::FillChange( const Entry& entry,bool undo,Change& change )
+{
+	change = Change{};
+	change.frame = entry.frame;
+	if( entry.oldSize != entry.newSize )
+	{
+		change.resize = undo ? entry.oldSize : entry.newSize;
+		// Resizing back up is enough for redo.
+		if( undo )
+		{
+			for( const auto& pixels : entry.pixels )
+			{
+				change.pixels.emplace_back( Unpack( pixels ) );
+			}
+			change.restore = entry.restore;
+		}
+	}
+	change.moveFrom = undo ? entry.moveTo : entry.moveFrom;
+	change.moveTo = undo ? entry.moveFrom : entry.moveTo;
+	for( const auto& tile : entry.tiles )
+	{
+		change.tiles.emplace_back( Tile{ tile.layer,tile.pos * tileSize,
+			Unpack( undo ? tile.before : tile.after ) } );
+	}
+
+	// Take out what the edit left behind and put back what it replaced,
+	//  or the other way around for redo.
+	const auto& taken = undo ? entry.after : entry.before;
+	const auto& given = undo ? entry.before : entry.after;
+	for( const auto& layer : taken ) change.remove.emplace_back( layer.pos );
+	// Highest first so earlier removals don't shift later ones.
+	std::sort( change.remove.begin(),change.remove.end(),std::greater<int>() );
+
+	for( const auto& layer : given )
+	{
+		change.insert.emplace_back( LayerState{ layer.pos,
+			Unpack( layer.pixels ),layer.opacity,layer.mode,layer.histogram } );
+	}
+	std::sort( change.insert.begin(),change.insert.end(),
+		[]( const LayerState& a,const LayerState& b )
+		{
+			return( a.pos < b.pos );
+		} );
+}
+
+void History::CompressOld()
+{
+	// Walk back from the newest entry that fell out of the raw window, stop
+	//  at the first one that's already done.
+	for( int i = int( undoStack.size() ) - nRawEntries - 1; i >= 0; --i )
+	{
+		auto& entry = undoStack[i];
+		if( entry.compressed ) break;
+
+		for( auto& tile : entry.tiles )
+		{
+			Compress( tile.before );
+			Compress( tile.after );
+		}
+		for( auto& layer : entry.before ) Compress( layer.pixels );
+		for( auto& layer : entry.after ) Compress( layer.pixels );
+		for( auto& pixels : entry.pixels ) Compress( pixels );
+		entry.compressed = true;
+
+		memoryUsed -= entry.bytes;
+		entry.bytes = GetSize( entry );
+		memoryUsed += entry.bytes;
+	}
+}
+
+void History::Evict()
+{
+	while( memoryUsed > memoryBudget && !undoStack.empty() )
+	{
+		memoryUsed -= undoStack.front().bytes;
+		undoStack.pop_front();
+	}
+	// Only left with redo entries, drop the ones furthest away.
+	while( memoryUsed > memoryBudget && !redoStack.empty() )
+	{
+		memoryUsed -= redoStack.front().bytes;
+		redoStack.erase( redoStack.begin() );
+	}
+}
+
+History::Packed History::Pack( const Surface& surf,const RectI& area )
+{
+	assert( area.left >= 0 && area.right <= surf.GetWidth() );
+	assert( area.top >= 0 && area.bottom <= surf.GetHeight() );
+
+	Packed packed;
+	packed.width = area.GetWidth();
+	packed.height = area.GetHeight();
+	packed.data.resize( size_t( packed.width ) * packed.height );
+
+	const auto& pixels = surf.GetRawPixelData();
+	unsigned int* out = packed.data.data();
+	for( int y = area.top; y < area.bottom; ++y )
+	{
+		const Color* row = pixels.data() + size_t( y ) * surf.GetWidth();
+		for( int x = area.left; x < area.right; ++x ) *out++ = row[x].dword;
+	}
+	return( packed );
+}
+
+Surface History::Unpack( const Packed& packed )
+{
+	Surface surf = { packed.width,packed.height };
+	if( !packed.compressed )
+	{
+		std::vector<Color> pixels( packed.data.begin(),packed.data.end() );
+		surf.CopyFrom( pixels.data() );
+		return( surf );
+	}
+
+	std::vector<Color> pixels;
+	pixels.reserve( packed.width * packed.height );
+	for( size_t i = 0; i + 1 < packed.data.size(); i += 2 )
+	{
+		pixels.insert( pixels.end(),packed.data[i],Color{ packed.data[i + 1] } );
+	}
+	assert( int( pixels.size() ) == packed.width * packed.height );
+	surf.CopyFrom( pixels.data() );
+	return( surf );
+}
+
+void History::Compress( Packed& packed )
+{
+	if( packed.compressed ) return;
+
+	std::vector<unsigned int> runs;
+	for( size_t i = 0; i < packed.data.size(); )
+	{
+		size_t end = i + 1;
+		while( end < packed.data.size() && packed.data[end] == packed.data[i] )
+		{
+			++end;
+		}
+		runs.emplace_back( unsigned( end - i ) );
+		runs.emplace_back( packed.data[i] );
+		// Noisy pixels, runs would only make it bigger.
+		if( runs.size() >= packed.data.size() ) return;
+		i = end;
+	}
+
+	packed.data = std::move( runs );
+	packed.data.shrink_to_fit();
+	packed.compressed = true;
+}
+
+size_t History::GetSize( const Packed& packed )
+{
+	return( sizeof( Packed ) + packed.data.capacity() * sizeof( unsigned int ) );
+}
+
+size_t History::GetSize( const SavedLayer& layer )
+{
+	// Roughly what a hash map node costs per color.
+	return( GetSize( layer.pixels ) + size_t( layer.histogram.GetColorCount() ) *
+		( sizeof( unsigned int ) + sizeof( int ) + 2 * sizeof( void* ) ) );
+}
+
+size_t History::GetSize( const Entry& entry )
+{
+	size_t size = sizeof( Entry );
+	for( const auto& tile : entry.tiles )
+	{
+		size += GetSize( tile.before ) + GetSize( tile.after );
+	}
+	for( const auto& layer : entry.before ) size += GetSize( layer );
+	for( const auto& layer : entry.after ) size += GetSize( layer );
+	for( const auto& pixels : entry.pixels ) size += GetSize( pixels );
+	size += entry.restore.capacity() * sizeof( Restore );
+	return( size );
+}
+
+RectI History::GetTileRect( const Vei2& tile ) const
+{
+	const int left = tile.x * tileSize;
+	const int top = tile.y * tileSize;
+	return( RectI{ left,std::min( left + tileSize,editSize.x ),
+		top,std::min( top + tileSize,editSize.y ) } );
+}
\ No newline at end of file
@@ -0,0 +1,183 @@
+#pragma once
+
+#include "Surface.h"
+#include "Blend.h"
+#include "Rect.h"
+#include "ColorHistogram.h"
+#include <deque>
+#include <vector>
+#include <cstddef>
+
+// Undo/redo storage.  Pixel edits only keep the tiles they touched, layer
+//  edits (add, delete, merge, resize...) keep copies of the layers they
+//  swapped.  Older entries get run length encoded and the oldest ones get
+//  dropped once the whole thing goes over the memory budget.  One history
+//  covers every animation frame, each entry remembers the one it was made
+//  on.
+class History
+{
+public:
+	// A layer and its settings at some position in the stack.
+	struct LayerState
+	{
+		int pos;
+		Surface surf;
+		unsigned char opacity;
+		BlendMode mode;
+		// surf's color counts, kept so putting it back doesn't recount.
+		ColorHistogram histogram;
+	};
+	// Pixels to write into a layer with their top left at pos.
+	struct Tile
+	{
+		int layer;
+		Vei2 pos;
+		Surface pixels;
+	};
+	// Layer pos of frame gets pixels back when a resize is undone, an
+	//  index into the pixels that go with it.
+	struct Restore
+	{
+		int frame;
+		int pos;
+		int pixels;
+	};
+	// What an undo or redo wants done to the layers.
+	struct Change
+	{
+		// Frame it was made on, see SetFrame, or allFrames.
+		int frame = 0;
+		// Size every layer of every frame goes to, for canvas resizes.
+		//  Layers in restore get pixels back instead of just being resized.
+		Vei2 resize = { 0,0 };
+		std::vector<Surface> pixels;
+		std::vector<Restore> restore;
+		// For pixel edits.
+		std::vector<Tile> tiles;
+		// Layer positions to take out (apply in order), then layers to put
+		//  in (also in order), for layer edits.
+		std::vector<int> remove;
+		std::vector<LayerState> insert;
+		// Layer to move between positions, for reorders.
+		int moveFrom = -1;
+		int moveTo = -1;
+	};
+public:
+	static constexpr int tileSize = 32;
+	// Tag for changes to the whole document.
+	static constexpr int allFrames = -1;
+
+	History( size_t memoryBudget = size_t( 256 ) * 1024 * 1024 );
+
+	// Call before writing to area of layer, target is the surface that's
+	//  about to change.  Starts a new edit if one isn't open.
+	void Touch( const Surface& target,int layer,const RectI& area );
+	void TouchPixel( const Surface& target,int layer,int x,int y );
+	// Closes the open edit, keeping the tiles that actually changed.
+	void EndEdit( const Surface& target );
+	bool IsEditing() const;
+	// Edits closed in between become one undo step, for changes that
+	//  write to several layers.
+	void BeginGroup();
+	void EndGroup();
+	// Records layers at before being replaced by after.  Positions in
+	//  before are where they were, positions in after are where they went.
+	void PushLayers( std::vector<LayerState> before,std::vector<LayerState> after );
+	// Records a layer moving from one position to another, no pixels kept.
+	void PushMove( int from,int to );
+	// Records every frame going from oldSize to newSize.  Only layers
+	//  that lost pixels need to be in restore, the rest undo by resizing
+	//  back.  Tagged allFrames.
+	void PushResize( const Vei2& oldSize,const Vei2& newSize,
+		const std::vector<Surface>& pixels,std::vector<Restore> restore );
+	// Frame entries get tagged with from now on, any id that stays with
+	//  the frame.
+	void SetFrame( int frame );
+	// Drops every entry made on frame and whatever resizes kept of it,
+	//  for when it's gone.
+	void Forget( int frame );
+
+	// Fills change with what to apply, returns false if there's nothing.
+	bool Undo( Change& change );
+	bool Redo( Change& change );
+	void Clear();
+
+	void SetMemoryBudget( size_t bytes );
+	size_t GetMemoryUsed() const;
+private:
+	// Pixels stored raw or as ( count,color ) runs.
+	struct Packed
+	{
+		int width = 0;
+		int height = 0;
+		bool compressed = false;
+		std::vector<unsigned int> data;
+	};
+	struct TileDelta
+	{
+		int layer;
+		Vei2 pos;
+		Packed before;
+		Packed after;
+	};
+	struct SavedLayer
+	{
+		int pos;
+		Packed pixels;
+		unsigned char opacity;
+		BlendMode mode;
+		ColorHistogram histogram;
+	};
+	struct Entry
+	{
+		int frame = 0;
+		std::vector<TileDelta> tiles;
+		std::vector<SavedLayer> before;
+		std::vector<SavedLayer> after;
+		int moveFrom = -1;
+		int moveTo = -1;
+		Vei2 oldSize = { 0,0 };
+		Vei2 newSize = { 0,0 };
+		std::vector<Packed> pixels;
+		std::vector<Restore> restore;
+		bool compressed = false;
+		size_t bytes = 0;
+	};
+private:
+	void Push( Entry&& entry );
+	// Undo and redo are the same thing pointed in opposite directions.
+	static void FillChange( const Entry& entry,bool undo,Change& change );
+	void CompressOld();
+	void Evict();
+
+	// Grabs area of surf, area has to be inside it.
+	static Packed Pack( const Surface& surf,const RectI& area );
+	static Surface Unpack( const Packed& packed );
+	static void Compress( Packed& packed );
+	static size_t GetSize( const Packed& packed );
+	static size_t GetSize( const SavedLayer& layer );
+	static size_t GetSize( const Entry& entry );
+	RectI GetTileRect( const Vei2& tile ) const;
+private:
+	std::deque<Entry> undoStack;
+	std::vector<Entry> redoStack;
+	size_t memoryBudget;
+	size_t memoryUsed = 0;
+	int frame = 0;
+	// How many of the newest undo entries stay uncompressed.
+	static constexpr int nRawEntries = 4;
+
+	// The edit being recorded.
+	Entry edit;
+	bool editing = false;
+	int editLayer = -1;
+	// Closed edits waiting for EndGroup.
+	Entry group;
+	bool grouping = false;
+	int tilesWide = 0;
+	int tilesHigh = 0;
+	// Canvas size when the edit started.
+	Vei2 editSize;
+	// Index into edit.tiles for each tile, -1 if untouched.
+	std::vector<int> tileSlots;
+};
\ No newline at end of file
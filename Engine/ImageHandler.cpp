@@ -3,29 +3,22 @@
 // #include "WriteToBitmap.h"
 #include <string>
 #include "Utils.h"
+#include <cassert>
 
 ImageHandler::ImageHandler( const RectI& clipArea,ToolMode& curTool,
 	Mouse& mouse,Keyboard& kbd )
 	:
-	art( canvSize.x,canvSize.y ),
 	clipArea( clipArea ),
 	artPos( { float( clipArea.left ),float( clipArea.top ) } ),
-	bgPattern( canvSize.x,canvSize.y ),
 	curTool( curTool ),
 	mouse( mouse ),
 	kbd( kbd ),
-	drawSurf( art.GetExpandedBy( Vei2( scale ) ) ),
-	bigPattern( bgPattern.GetExpandedBy( Vei2( scale ) ) ),
+	drawSurf( 0,0 ),
 	layerManager( clipArea,canvSize )
 {
-	art.DrawRect( 0,0,art.GetWidth(),art.GetHeight(),chroma );
+	drawSurf = GetArt();
 
-	ResizeCanvas( canvSize );
-
-	drawSurf = art.GetExpandedBy( Vei2( scale ) );
-	bigPattern = bgPattern.GetExpandedBy( Vei2( scale ) );
-
-	selectEnd = art.GetSize();
+	selectEnd = canvSize;
 }
 
 void ImageHandler::Update( const Keyboard& kbd,ToolMode tool,
@@ -37,11 +30,22 @@ void ImageHandler::Update( const Keyboard& kbd,ToolMode tool,
 	{
 		artPos += ( mouse.GetPos() - oldMousePos );
 		oldMousePos = mouse.GetPos();
+		// Moves made while panning aren't brush strokes, and arrows
+		//  pressed meanwhile aren't nudges to save up for later.
+		mouse.Flush();
+		this->kbd.FlushKey();
 		return;
 	}
 
 	const auto oldScale = scale;
-	const auto oldArt = art;
+	// Tools write straight into the selected layer.  Anything that can
+	//  change the stack goes through GetArt() again afterwards.
+	Surface& art = layerManager.GetActiveSurface();
+	const auto oldArtVersion = art.GetVersion();
+	auto& history = layerManager.GetHistory();
+	const int curLayer = layerManager.GetActualSelectedLayer();
+	// Locked layers never get written to in the first place.
+	const bool locked = layerManager.IsSelectedLayerLocked();
 
 	if( tool == ToolMode::Ruler &&
 		clipArea.ContainsPoint( mouse.GetPos() ) )
@@ -114,18 +118,25 @@ void ImageHandler::Update( const Keyboard& kbd,ToolMode tool,
 		mouseTemp.x /= int( scale.x );
 		mouseTemp.y /= int( scale.y );
 
-		if( kbd.KeyIsPressed( VK_SHIFT ) )
+		if( kbd.KeyIsPressed( VK_SHIFT ) && !locked )
 		{
 			auto col = main;
 			if( tool == ToolMode::Eraser ) col = chroma;
-			art.DrawLine( lastClickPos,mouseTemp,col );
+			lineStroke.Begin( canvSize,col );
+			lineStroke.AddPoint( lastClickPos );
+			lineStroke.AddPoint( mouseTemp );
+			lineStroke.Apply( art,history,curLayer,selection );
+			lineStroke.End();
 		}
 
 		lastClickPos = mouseTemp;
 	}
 
-	if( ( kbd.KeyIsPressed( VK_MENU ) || tool == ToolMode::Sampler )
-		&& mouse.LeftIsPressed() )
+	// Selection tools use alt to subtract instead.
+	const bool selectTool = tool == ToolMode::Selector ||
+		tool == ToolMode::Lasso || tool == ToolMode::Wand;
+	if( ( ( kbd.KeyIsPressed( VK_MENU ) && !selectTool ) ||
+		tool == ToolMode::Sampler ) && mouse.LeftIsPressed() )
 	{
 		mousePos = mouse.GetPos();
 		Vei2 mouseTemp = mouse.GetPos();
@@ -133,6 +144,8 @@ void ImageHandler::Update( const Keyboard& kbd,ToolMode tool,
 		mouseTemp.x /= int( scale.x );
 		mouseTemp.y /= int( scale.y );
 		main = art.GetPixel( mouseTemp.x,mouseTemp.y );
+		mouse.Flush();
+		this->kbd.FlushKey();
 		return;
 	}
 
@@ -145,11 +158,11 @@ void ImageHandler::Update( const Keyboard& kbd,ToolMode tool,
 	mousePos = mouse.GetPos();
 	Vei2 mouseTemp = mouse.GetPos();
 
-	if( ( tool == ToolMode::Brush || tool == ToolMode::Eraser ||
-		tool == ToolMode::Bucket || tool == ToolMode::Sampler ) &&
+	// Brush and eraser go through the stroke in the event loop below.
+	if( ( tool == ToolMode::Bucket || tool == ToolMode::Sampler ) &&
 		clipArea.ContainsPoint( Vei2( mouseTemp ) ) &&
-		drawSurf.GetRect().GetMovedBy( artPos )
-		.ContainsPoint( Vei2( mouseTemp ) ) )
+		drawSurf.GetRect().GetExpandedByScale( Vei2( scale ) )
+		.GetMovedBy( Vei2( artPos ) ).ContainsPoint( Vei2( mouseTemp ) ) )
 	{
 		mouseTemp -= Vei2( artPos );
 		mouseTemp.x /= int( scale.x );
@@ -159,52 +172,117 @@ void ImageHandler::Update( const Keyboard& kbd,ToolMode tool,
 
 		if( mouse.LeftIsPressed() )
 		{
-			if( tool == ToolMode::Eraser ) drawColor = &chroma;
-			else if( tool == ToolMode::Sampler )
+			if( tool == ToolMode::Sampler )
 			{
 				main = art.GetPixel( mouseTemp.x,mouseTemp.y );
 			}
 			else drawColor = &main;
 		}
-		else if( mouse.RightIsPressed() )
-		{
-			if( tool != ToolMode::Eraser ) drawColor = &off;
-		}
+		else if( mouse.RightIsPressed() ) drawColor = &off;
 
 		if( drawColor != nullptr &&
-			!kbd.KeyIsPressed( VK_SPACE ) )
+			!kbd.KeyIsPressed( VK_SPACE ) && !locked )
 		{
+			// Shift fills everywhere instead of just what's touching,
+			//  ctrl too goes through every layer.
 			if( tool == ToolMode::Bucket )
 			{
-				TryFillPlusAt( mouseTemp,*drawColor,
-					art.GetPixel( mouseTemp.x,mouseTemp.y ) );
+				if( kbd.KeyIsPressed( VK_SHIFT ) )
+				{
+					ReplaceAt( mouseTemp,*drawColor,kbd.KeyIsPressed( VK_CONTROL ) );
+				}
+				else FillAt( mouseTemp,*drawColor );
 			}
 
-			art.PutPixel( mouseTemp.x,mouseTemp.y,
-				*drawColor );
+			if( selection.IsSelected( mouseTemp.x,mouseTemp.y ) )
+			{
+				history.TouchPixel( art,curLayer,mouseTemp.x,mouseTemp.y );
+				art.PutPixel( mouseTemp.x,mouseTemp.y,
+					*drawColor );
+			}
 		}
 	}
 	static constexpr float scaleFactor = 1.2f;
 	static constexpr float moveSpeed = 5.5f;
 
+	// Brush and eraser paint along every queued move, not just where the
+	//  mouse ended up this frame.
+	const bool painting = ( tool == ToolMode::Brush ||
+		tool == ToolMode::Eraser ) && !kbd.KeyIsPressed( VK_SPACE ) && !locked;
+
 	// Use ctrl + scroll or ctrl + plus/minus to zoom in/out.
-	while( !mouse.IsEmpty() )
+	mouseEvents.clear();
+	mouse.ReadAll( mouseEvents );
+	for( const auto& e : mouseEvents )
 	{
-		const auto e = mouse.Read();
 		switch( e.GetType() )
 		{
+		case Mouse::Event::Type::Move:
+		case Mouse::Event::Type::LPress:
+		case Mouse::Event::Type::RPress:
+		case Mouse::Event::Type::LRelease:
+		case Mouse::Event::Type::RRelease:
+			if( painting ) UpdateStroke( e,tool,main,off );
+			if( tool == ToolMode::Lasso ) UpdateLasso( e );
+			if( tool == ToolMode::Wand &&
+				e.GetType() == Mouse::Event::Type::LPress &&
+				clipArea.ContainsPoint( e.GetPos() ) )
+			{
+				// Shift picks the color everywhere, not just touching.
+				selection.SelectColor( art,ScreenToCanvas( e.GetPos() ),
+					wandTolerance,!kbd.KeyIsPressed( VK_SHIFT ),GetSelectOp() );
+				OnSelectionChanged();
+			}
+			break;
 		case Mouse::Event::Type::WheelUp:
-			if( kbd.KeyIsPressed( VK_CONTROL ) ) scale *= scaleFactor;
+			// Scrolling over the layer panel scrolls the list, shift +
+			//  scroll over a layer changes its opacity.
+			if( layerManager.ContainsPoint( mouse.GetPos() ) )
+			{
+				if( kbd.KeyIsPressed( VK_SHIFT ) &&
+					layerManager.GetSelectedLayer() != -1 )
+				{
+					layerManager.AdjustOpacity( layerManager.GetSelectedLayer(),1 );
+				}
+				else layerManager.Scroll( -1 );
+			}
+			else if( kbd.KeyIsPressed( VK_CONTROL ) ) scale *= scaleFactor;
 			else if( kbd.KeyIsPressed( VK_SHIFT ) ) artPos.x += moveSpeed;
 			else artPos.y += moveSpeed;
 			break;
 		case Mouse::Event::Type::WheelDown:
-			if( kbd.KeyIsPressed( VK_CONTROL ) ) scale /= scaleFactor;
+			if( layerManager.ContainsPoint( mouse.GetPos() ) )
+			{
+				if( kbd.KeyIsPressed( VK_SHIFT ) &&
+					layerManager.GetSelectedLayer() != -1 )
+				{
+					layerManager.AdjustOpacity( layerManager.GetSelectedLayer(),-1 );
+				}
+				else layerManager.Scroll( 1 );
+			}
+			else if( kbd.KeyIsPressed( VK_CONTROL ) ) scale /= scaleFactor;
 			else if( kbd.KeyIsPressed( VK_SHIFT ) ) artPos.x -= moveSpeed;
 			else artPos.y -= moveSpeed;
 			break;
 		}
 	}
+	// Everything the stroke picked up this frame goes in as one write.
+	if( stroke.IsActive() )
+	{
+		stroke.Apply( art,history,curLayer,selection );
+		if( !painting ) stroke.End();
+	}
+	if( !lassoPoints.empty() && !mouse.LeftIsPressed() )
+	{
+		// Just a click clears the selection, same as the rect.
+		if( lassoPoints.size() < 3 && selectOp == SelectionMask::Op::Replace )
+		{
+			selection.SelectAll();
+		}
+		else selection.SelectLasso( lassoPoints,selectOp );
+		lassoPoints.clear();
+		OnSelectionChanged();
+	}
 	if( kbd.KeyIsPressed( VK_CONTROL ) )
 	{
 		if( kbd.KeyIsPressed( VK_OEM_PLUS ) )
@@ -224,10 +302,14 @@ void ImageHandler::Update( const Keyboard& kbd,ToolMode tool,
 	float speed = 2.0f;
 	if( kbd.KeyIsPressed( VK_SHIFT ) ) speed *= moveSpeed;
 	if( kbd.KeyIsPressed( VK_CONTROL ) ) speed *= slowAmount;
-	if( kbd.KeyIsPressed( VK_UP ) ) artPos.y -= speed;
-	if( kbd.KeyIsPressed( VK_DOWN ) ) artPos.y += speed;
-	if( kbd.KeyIsPressed( VK_LEFT ) ) artPos.x -= speed;
-	if( kbd.KeyIsPressed( VK_RIGHT ) ) artPos.x += speed;
+	// The pointer uses them to nudge the selection instead.
+	if( tool != ToolMode::Pointer )
+	{
+		if( kbd.KeyIsPressed( VK_UP ) ) artPos.y -= speed;
+		if( kbd.KeyIsPressed( VK_DOWN ) ) artPos.y += speed;
+		if( kbd.KeyIsPressed( VK_LEFT ) ) artPos.x -= speed;
+		if( kbd.KeyIsPressed( VK_RIGHT ) ) artPos.x += speed;
+	}
 	if( clipArea.ContainsPoint( mouse.GetPos() ) &&
 		mouse.LeftIsPressed() )
 	{
@@ -313,17 +395,21 @@ void ImageHandler::Update( const Keyboard& kbd,ToolMode tool,
 	{
 		if( mouse.LeftIsPressed() )
 		{
-			selectingStuff = true;
-			if( canSelect )
+			// Presses that start outside the canvas view are for the ui.
+			if( canSelect && clipArea.ContainsPoint( mouse.GetPos() ) )
 			{
+				selectingStuff = true;
+				draggingSelect = true;
+				selectOp = GetSelectOp();
 				selectStart = mouse.GetPos();
 				selectStart -= Vei2( artPos );
 				selectStart.x /= int( scale.x );
 				selectStart.y /= int( scale.y );
-
-				canSelect = false;
 			}
-
+			canSelect = false;
+		}
+		if( mouse.LeftIsPressed() && draggingSelect )
+		{
 			selectEnd = mouse.GetPos();
 			selectEnd -= Vei2( artPos );
 			selectEnd.x /= int( scale.x );
@@ -341,7 +427,7 @@ void ImageHandler::Update( const Keyboard& kbd,ToolMode tool,
 				}
 			}
 		}
-		else
+		else if( !mouse.LeftIsPressed() )
 		{
 			if( selectEnd.x < selectStart.x )
 			{
@@ -352,98 +438,96 @@ void ImageHandler::Update( const Keyboard& kbd,ToolMode tool,
 				std::swap( selectStart.y,selectEnd.y );
 			}
 			canSelect = true;
+
+			if( draggingSelect )
+			{
+				draggingSelect = false;
+				const RectI area = { selectStart,selectEnd };
+				if( ( area.GetWidth() == 0 || area.GetHeight() == 0 ) &&
+					selectOp == SelectionMask::Op::Replace )
+				{
+					selection.SelectAll();
+				}
+				else selection.SelectRect( area,selectOp );
+				OnSelectionChanged();
+			}
 		}
 	}
 
-	if( curTool == ToolMode::Pointer )
+	// Arrow keys nudge the selection with the pointer, taps get read as
+	//  events so quick ones in one frame all count.
+	Vei2 nudge = { 0,0 };
+	while( !this->kbd.KeyIsEmpty() )
+	{
+		const auto e = this->kbd.ReadKey();
+		if( !e.IsPress() || curTool != ToolMode::Pointer ) continue;
+		switch( e.GetCode() )
+		{
+		case VK_LEFT: --nudge.x; break;
+		case VK_RIGHT: ++nudge.x; break;
+		case VK_UP: --nudge.y; break;
+		case VK_DOWN: ++nudge.y; break;
+		}
+	}
+
+	if( curTool == ToolMode::Pointer && !locked && !selection.IsEmpty() )
 	{
-		// oldMousePos
-		// clickingLastFrame
 		if( mouse.LeftIsPressed() )
 		{
-			if( !draggingPointer )
+			if( !floating.IsFloating() &&
+				clipArea.ContainsPoint( mouse.GetPos() ) )
 			{
-				draggingPointer = true;
-				pointerStart = mouse.GetPos();
-				pointerDelta = pointerStart - Vei2(
-					( selectStart.x + int( artPos.x ) ) *
-					int( scale.x ),
-					( selectStart.y + int( artPos.y ) ) *
-					int( scale.y ) );
-				pointerDelta = pointerStart - Vei2(
-					selectStart.x * int( scale.x ) + int( artPos.x ),
-					selectStart.y * int( scale.y ) + int( artPos.y ) );
-				miniPointerMoveClip = art.GetClipped( RectI{
-					selectStart,selectEnd } );
-				pointerMoveClip = miniPointerMoveClip
-					.GetExpandedBy( Vei2( scale ) );
-
-				// remove rect from art
-				art.DrawRect( selectStart.x,selectStart.y,
-					selectEnd.x - selectStart.x,
-					selectEnd.y - selectStart.y,
-					Colors::Magenta );
+				floating.Lift( art,history,curLayer,selection,chroma );
+				pointerStart = ScreenToCanvas( mouse.GetPos() );
 			}
-			else
+			if( floating.IsFloating() )
 			{
-				pointerPos = mouse.GetPos() - pointerDelta;
-				pointerPos -= Vei2( artPos );
-				pointerPos.x /= int( scale.x );
-				pointerPos.y /= int( scale.y );
-				pointerPos.x *= int( scale.x );
-				pointerPos.y *= int( scale.y );
-				pointerPos += Vei2( artPos );
-
-				const auto pointerClipMovePos = Vei2{
-					( pointerPos.x - int( artPos.x ) ) / int( scale.x ),
-					( pointerPos.y - int( artPos.y ) ) / int( scale.y ) };
-				selectStart = pointerClipMovePos;
-				selectEnd = pointerClipMovePos + Vei2(
-					pointerMoveClip.GetWidth() / int( scale.x ),
-					pointerMoveClip.GetHeight() / int( scale.y ) );
+				floating.MoveTo( floating.GetOrigin() +
+					ScreenToCanvas( mouse.GetPos() ) - pointerStart );
 			}
 		}
-		else if( draggingPointer )
+		if( nudge != Vei2{ 0,0 } )
 		{
-			if( selectStart.x >= 0 && selectStart.y >= 0 &&
-				selectStart.x <= art.GetWidth() && selectStart.y <= art.GetHeight() &&
-				selectEnd.x >= 0 && selectEnd.y >= 0 &&
-				selectEnd.x <= art.GetWidth() && selectEnd.y <= art.GetHeight() )
+			if( !floating.IsFloating() )
 			{
-				draggingPointer = false;
-
-				const auto pointerClipMovePos = Vei2{
-					( pointerPos.x - int( artPos.x ) ) / int( scale.x ),
-					( pointerPos.y - int( artPos.y ) ) / int( scale.y ) };
-
-				art.LightCopyIntoPos( miniPointerMoveClip,
-					selectStart );
-
-				pointerMoveClip = Surface{ 0,0 };
+				floating.Lift( art,history,curLayer,selection,chroma );
 			}
+			floating.MoveBy( nudge );
+		}
+		if( floating.IsFloating() )
+		{
+			selectStart = floating.GetPos();
+			selectEnd = selectStart + floating.GetSize();
 		}
 	}
+	// Dropped once the button's up, nudges drop the same frame.
+	if( floating.IsFloating() && !mouse.LeftIsPressed() )
+	{
+		floating.Drop( art,history,curLayer );
+		selection.Move( floating.GetPos() - floating.GetOrigin() );
+		OnSelectionChanged();
+	}
 
 	if( kbd.KeyIsPressed( VK_CONTROL ) &&
 		kbd.KeyIsPressed( 'A' ) )
 	{
 		selectingStuff = true;
-		selectStart = Vei2{ 0,0 };
-		selectEnd = Vei2{ art.GetWidth(),art.GetHeight() };
+		selection.SelectAll();
+		OnSelectionChanged();
 	}
 	if( kbd.KeyIsPressed( VK_ESCAPE ) ||
 		( kbd.KeyIsPressed( VK_CONTROL ) &&
 		kbd.KeyIsPressed( 'D' ) ) )
 	{
 		// selectingStuff = false;
-		selectStart = Vei2{ 0,0 };
-		selectEnd = Vei2{ art.GetWidth(),art.GetHeight() };
+		selection.SelectAll();
+		OnSelectionChanged();
 	}
 	if( // selectingStuff &&
 		kbd.KeyIsPressed( VK_CONTROL ) &&
 		kbd.KeyIsPressed( 'C' ) )
 	{
-		clipboard = art.GetCropped( selectStart,selectEnd );
+		clipboard = GetSelectedPixels();
 		clipboardPos = selectStart;
 	}
 	if( clipboard.GetWidth() > 0 && clipboard.GetHeight() > 0 &&
@@ -452,10 +536,12 @@ void ImageHandler::Update( const Keyboard& kbd,ToolMode tool,
 	{
 		if( canPaste )
 		{
-			layerManager.CreateNewLayer( art );
-			art.DrawRect( 0,0,art.GetWidth(),art.GetHeight(),
+			// Build the layer first so history sees one new layer.
+			Surface pasted = { canvSize.x,canvSize.y };
+			pasted.DrawRect( 0,0,pasted.GetWidth(),pasted.GetHeight(),
 				Colors::Magenta );
-			art.CopyIntoPos( clipboard,clipboardPos );
+			pasted.CopyIntoPos( clipboard,clipboardPos );
+			layerManager.CreateNewLayer( pasted,dither );
 		}
 		canPaste = false;
 	}
@@ -471,14 +557,60 @@ void ImageHandler::Update( const Keyboard& kbd,ToolMode tool,
 	// 	resizeArea.FloatDivide( Vei2( scale ) );
 	// }
 
-	const bool willUpdate = layerManager.Update( kbd,mouse,art );
+	// A stroke ends when the buttons come up.
+	if( !mouse.LeftIsPressed() && !mouse.RightIsPressed() )
+	{
+		stroke.End();
+		history.EndEdit( GetArt() );
+	}
+
+	// Ctrl+Z to undo, Ctrl+Y or Ctrl+Shift+Z to redo.
+	bool steppedHistory = false;
+	const bool redoKeys = kbd.KeyIsPressed( VK_CONTROL ) &&
+		( kbd.KeyIsPressed( 'Y' ) ||
+		( kbd.KeyIsPressed( 'Z' ) && kbd.KeyIsPressed( VK_SHIFT ) ) );
+	if( redoKeys )
+	{
+		if( canRedo ) steppedHistory = layerManager.Redo();
+		canRedo = false;
+	}
+	else canRedo = true;
+	if( !redoKeys && kbd.KeyIsPressed( VK_CONTROL ) &&
+		kbd.KeyIsPressed( 'Z' ) )
+	{
+		if( canUndo ) steppedHistory = layerManager.Undo();
+		canUndo = false;
+	}
+	else canUndo = true;
+	if( steppedHistory && GetArt().GetSize() != canvSize )
+	{
+		canvSize = GetArt().GetSize();
+		UpdateSelectArea();
+	}
+
+	// Ctrl+P previews the image in the palette's colors, Ctrl+Shift+P
+	//  cycles the dithering used for that and for imports.
+	bool previewChanged = false;
+	if( kbd.KeyIsPressed( VK_CONTROL ) && kbd.KeyIsPressed( 'P' ) )
+	{
+		if( canTogglePreview )
+		{
+			if( kbd.KeyIsPressed( VK_SHIFT ) ) dither = ColorLookup::GetNextMode( dither );
+			else previewPalette = !previewPalette;
+			previewChanged = true;
+		}
+		canTogglePreview = false;
+	}
+	else canTogglePreview = true;
+
+	const bool willUpdate = layerManager.Update( kbd,mouse ) ||
+		steppedHistory || previewChanged;
 	const bool isHoveringLayer = layerManager.GetSelectedLayer() != -1;
 
 	if( scale.x != oldScale.x || scale.y != oldScale.y ||
-		art != oldArt || isHoveringLayer || hoveringLastFrame ||
-		willUpdate )
+		GetArt().GetVersion() != oldArtVersion || isHoveringLayer ||
+		hoveringLastFrame || willUpdate )
 	{
-		if( layerManager.IsSelectedLayerLocked() ) art = oldArt;
 		if( isHoveringLayer ) hoveringLastFrame = true;
 		else hoveringLastFrame = false;
 		UpdateArt();
@@ -491,15 +623,11 @@ void ImageHandler::Update( const Keyboard& kbd,ToolMode tool,
 void ImageHandler::Draw( Graphics& gfx ) const
 {
 	const auto drawPos = Vei2( artPos );
-	const auto drawRect = drawSurf.GetRect();
 
-	gfx.DrawSprite( drawPos.x,drawPos.y,
-		bigPattern.GetRect(),clipArea,bigPattern,
-		SpriteEffect::Chroma{ Colors::Magenta } );
-
-	gfx.DrawSprite( drawPos.x,drawPos.y,drawRect,
-		clipArea,drawSurf,
-		SpriteEffect::Chroma{ Colors::Magenta } );
+	// Checkerboard gets filled in behind transparent pixels only.
+	gfx.DrawSpriteOnCheckerboard( drawPos.x,drawPos.y,clipArea,
+		drawSurf,int( scale.x ),checkerSize,
+		checkerCol1,checkerCol2 );
 
 	// if( !selectingStuff )
 	// {
@@ -513,6 +641,10 @@ void ImageHandler::Draw( Graphics& gfx ) const
 	// 	}
 	// }
 	// else
+	// Just the corners while dragging or when everything's selected,
+	//  the actual outline otherwise.
+	if( selectionOutline.empty() || draggingSelect ||
+		floating.IsFloating() )
 	{
 		RectI selectorRect = { selectStart.x,selectEnd.x,
 			selectStart.y,selectEnd.y };
@@ -520,6 +652,57 @@ void ImageHandler::Draw( Graphics& gfx ) const
 		selectorRect.MoveBy( Vei2( artPos ) );
 		gfx.DrawHitboxCorners( selectorRect,Colors::Gray );
 	}
+	else
+	{
+		const Vei2 pixelSize = Vei2( scale );
+		for( const auto& edge : selectionOutline )
+		{
+			// Edges are straight so clipping is just clamping.
+			const Vei2 a = Vei2{ edge.first.x * pixelSize.x,
+				edge.first.y * pixelSize.y } + drawPos;
+			const Vei2 b = Vei2{ edge.second.x * pixelSize.x,
+				edge.second.y * pixelSize.y } + drawPos;
+			if( a.y == b.y )
+			{
+				if( a.y < clipArea.top || a.y >= clipArea.bottom ) continue;
+				const int left = std::max( a.x,clipArea.left );
+				const int right = std::min( b.x,clipArea.right );
+				if( left < right )
+				{
+					gfx.DrawLine( Vec2( Vei2{ left,a.y } ),
+						Vec2( Vei2{ right,a.y } ),Colors::Gray );
+				}
+			}
+			else
+			{
+				if( a.x < clipArea.left || a.x >= clipArea.right ) continue;
+				const int top = std::max( a.y,clipArea.top );
+				const int bottom = std::min( b.y,clipArea.bottom );
+				if( top < bottom )
+				{
+					gfx.DrawLine( Vec2( Vei2{ a.x,top } ),
+						Vec2( Vei2{ a.x,bottom } ),Colors::Gray );
+				}
+			}
+		}
+	}
+	// Lasso so far, through pixel centers.
+	for( size_t i = 1; i < lassoPoints.size(); ++i )
+	{
+		const auto toScreen = [&]( const Vei2& p )
+		{
+			return( Vec2{ ( float( p.x ) + 0.5f ) * float( int( scale.x ) ),
+				( float( p.y ) + 0.5f ) * float( int( scale.y ) ) } +
+				Vec2( drawPos ) );
+		};
+		const auto a = toScreen( lassoPoints[i - 1] );
+		const auto b = toScreen( lassoPoints[i] );
+		if( clipArea.ContainsPoint( Vei2( a ) ) &&
+			clipArea.ContainsPoint( Vei2( b ) ) )
+		{
+			gfx.DrawLine( a,b,Colors::Gray );
+		}
+	}
 
 	// Guidelines stuff.
 	const auto clipTop = float( clipArea.top );
@@ -570,15 +753,7 @@ void ImageHandler::Draw( Graphics& gfx ) const
 		}
 	}
 
-	if( curTool == ToolMode::Pointer && draggingPointer )
-	{
-		gfx.DrawSprite( pointerPos.x,
-			pointerPos.y,
-			pointerMoveClip.GetRect(),clipArea,
-			pointerMoveClip,
-			SpriteEffect::Chroma{ Colors::Magenta } );
-
-	}
+	floating.Draw( gfx,drawPos,int( scale.x ),clipArea );
 
 	layerManager.Draw( gfx );
 
@@ -587,7 +762,8 @@ void ImageHandler::Draw( Graphics& gfx ) const
 
 void ImageHandler::CenterImage()
 {
-	const auto artRect = art.GetExpandedBy( scale ).GetRect();
+	const auto artRect = RectI{ 0,canvSize.x * int( scale.x ),
+		0,canvSize.y * int( scale.y ) };
 
 	artPos = Vec2( clipArea.GetSize() ) / 2.0f -
 		Vec2( artRect.GetSize() ) / 2.0f +
@@ -596,30 +772,20 @@ void ImageHandler::CenterImage()
 
 void ImageHandler::UpdateArt()
 {
-	layerManager.Update( kbd,mouse,art );
-
-	drawSurf = Surface{ art.GetWidth(),art.GetHeight() };
-	drawSurf.DrawRect( 0,0,
-		drawSurf.GetWidth(),drawSurf.GetHeight(),
-		Colors::Magenta );
-
-	const auto& layers = layerManager.GetLayers();
-	const auto& hiddenLayers = layerManager.GetHiddenLayers();
-	const auto curSelectedLayer = layerManager.GetSelectedLayer();
-	for( int i = 0; i < int( layers.size() ); ++i )
-	{
-		if( !hiddenLayers[i] )
-		{
-			drawSurf.LightCopyInto( layers[i] );
-		}
-		if( ( i == layerManager.GetActualSelectedLayer() &&
-			curSelectedLayer == -1 ) || i == curSelectedLayer )
-		{
-			selectedLayerRect = layers[i].GetNonMagentaRect();
-		}
-	}
-	drawSurf = drawSurf.GetExpandedBy( Vei2( scale ) );
-	bigPattern = bgPattern.GetExpandedBy( Vei2( scale ) );
+	composite = ComposeLayers();
+	drawSurf = composite;
+	if( previewPalette ) ApplyPalettePreview();
+	// Neighbouring frames are a guide, so they skip the palette preview.
+	onion.Update( layerManager,canvSize );
+	onion.DrawUnder( drawSurf );
+
+	// Outline the hovered layer, or the selected one if none is.
+	const auto curSelectedLayer = layerManager.GetSelectedLayer() != -1
+		? layerManager.GetSelectedLayer()
+		: layerManager.GetActualSelectedLayer();
+	Surface scratch = { 0,0 };
+	selectedLayerRect = layerManager.GetLayerPixels( curSelectedLayer,scratch )
+		.GetNonMagentaRect();
 	
 	if( selectedLayerRect.left != -1 &&
 		selectedLayerRect.right != -1 &&
@@ -635,88 +801,161 @@ void ImageHandler::UpdateArt()
 
 Surface& ImageHandler::GetArt()
 {
-	return( art );
+	return( layerManager.GetActiveSurface() );
 }
 
-void ImageHandler::TryFillPlusAt( const Vei2& pos,Color c,Color baseFill )
+void ImageHandler::UpdateStroke( const Mouse::Event& e,ToolMode tool,
+	Color main,Color off )
 {
-	if( c == baseFill ) return;
-
-	art.PutPixel( pos.x,pos.y,c );
+	// Left paints main, right paints off, eraser only goes with left.
+	const Color* drawColor = nullptr;
+	if( e.LeftIsPressed() )
+	{
+		drawColor = tool == ToolMode::Eraser ? &chroma : &main;
+	}
+	else if( e.RightIsPressed() && tool != ToolMode::Eraser ) drawColor = &off;
 
-	if( pos.y > 0 )
+	if( stroke.IsActive() &&
+		( drawColor == nullptr || *drawColor != stroke.GetColor() ) )
 	{
-		if( art.GetPixel( pos.x,pos.y - 1 ) == baseFill )
-		{
-			TryFillPlusAt( pos + Vei2::Up(),c,baseFill );
-		}
+		FinishStroke();
 	}
-	if( pos.y < art.GetHeight() - 1 )
+	if( drawColor == nullptr ) return;
+	if( !stroke.IsActive() ) stroke.Begin( canvSize,*drawColor );
+
+	// Going outside the canvas view lifts the pen until it comes back.
+	if( clipArea.ContainsPoint( e.GetPos() ) )
 	{
-		if( art.GetPixel( pos.x,pos.y + 1 ) == baseFill )
-		{
-			TryFillPlusAt( pos + Vei2::Down(),c,baseFill );
-		}
+		stroke.AddPoint( ScreenToCanvas( e.GetPos() ) );
 	}
-	if( pos.x > 0 )
+	else stroke.Lift();
+}
+
+void ImageHandler::UpdateLasso( const Mouse::Event& e )
+{
+	if( !e.LeftIsPressed() ) return;
+	if( lassoPoints.empty() )
 	{
-		if( art.GetPixel( pos.x - 1,pos.y ) == baseFill )
+		if( e.GetType() != Mouse::Event::Type::LPress ||
+			!clipArea.ContainsPoint( e.GetPos() ) )
 		{
-			TryFillPlusAt( pos + Vei2::Left(),c,baseFill );
+			return;
 		}
+		selectOp = GetSelectOp();
 	}
-	if( pos.x < art.GetWidth() - 1 )
+
+	const auto pos = ScreenToCanvas( e.GetPos() );
+	if( lassoPoints.empty() || lassoPoints.back() != pos )
 	{
-		if( art.GetPixel( pos.x + 1,pos.y ) == baseFill )
-		{
-			TryFillPlusAt( pos + Vei2::Right(),c,baseFill );
-		}
+		lassoPoints.emplace_back( pos );
 	}
+}
 
-	return;
+Vei2 ImageHandler::ScreenToCanvas( const Vei2& pos ) const
+{
+	// Round down, not towards 0, so the row and column just outside the
+	//  canvas don't land on it.
+	const auto floorDiv = []( int a,int b )
+	{
+		return( a >= 0 ? a / b : ( a - b + 1 ) / b );
+	};
+	const auto rel = pos - Vei2( artPos );
+	return( Vei2{ floorDiv( rel.x,int( scale.x ) ),
+		floorDiv( rel.y,int( scale.y ) ) } );
 }
 
-void ImageHandler::ResizeCanvas( const Vei2& newSize )
+SelectionMask::Op ImageHandler::GetSelectOp() const
 {
-	canvSize = newSize;
+	const bool ctrl = kbd.KeyIsPressed( VK_CONTROL );
+	const bool alt = kbd.KeyIsPressed( VK_MENU );
+	if( ctrl && alt ) return( SelectionMask::Op::Intersect );
+	if( ctrl ) return( SelectionMask::Op::Add );
+	if( alt ) return( SelectionMask::Op::Subtract );
+	return( SelectionMask::Op::Replace );
+}
 
-	// Surface temp = art;
-	// art = Surface{ canvSize.x,canvSize.y };
-	// art.DrawRect( 0,0,art.GetWidth(),art.GetHeight(),chroma );
-	// art.CopyInto( temp );
-	art.Resize( newSize );
+void ImageHandler::OnSelectionChanged()
+{
+	const auto bounds = selection.GetBounds();
+	selectStart = { bounds.left,bounds.top };
+	selectEnd = { bounds.right,bounds.bottom };
 
-	bgPattern = { canvSize.x,canvSize.y };
+	selectionOutline.clear();
+	if( !selection.IsAll() ) selection.GetOutline( selectionOutline );
+}
 
-	static constexpr Color c1 = Colors::MakeRGB( 255,255,255 );
-	static constexpr Color c2 = Colors::MakeRGB( 204,204,204 );
-	for( int y = 0; y < bgPattern.GetHeight(); ++y )
+Surface ImageHandler::GetSelectedPixels() const
+{
+	const auto& art = layerManager.GetActiveSurface();
+	Surface pixels = { selectEnd.x - selectStart.x,selectEnd.y - selectStart.y };
+	pixels.DrawRect( 0,0,pixels.GetWidth(),pixels.GetHeight(),chroma );
+
+	std::vector<Surface::Span> spans;
+	selection.GetSpans( RectI{ selectStart,selectEnd },spans );
+	for( const auto& span : spans )
 	{
-		for( int x = 0; x < bgPattern.GetWidth(); ++x )
+		for( int x = span.left; x < span.right; ++x )
 		{
-			if( y % 2 == 0 )
-			{
-				bgPattern.PutPixel( x,y,x % 2 == 0 ? c1 : c2 );
-			}
-			else
-			{
-				bgPattern.PutPixel( x,y,x % 2 == 0 ? c2 : c1 );
-			}
+			pixels.PutPixel( x - selectStart.x,span.y - selectStart.y,
+				art.GetPixel( x,span.y ) );
 		}
 	}
+	return( pixels );
+}
+
+void ImageHandler::FillAt( const Vei2& pos,Color c )
+{
+	auto& art = GetArt();
+	if( art.GetPixel( pos.x,pos.y ) == c ) return;
+
+	// Same as a contiguous wand, then whatever isn't selected comes off.
+	SelectionMask fill = { canvSize.x,canvSize.y };
+	fill.SelectColor( art,pos,0,true,SelectionMask::Op::Replace );
+	fill.Combine( selection,SelectionMask::Op::Intersect );
+
+	std::vector<Surface::Span> spans;
+	fill.GetSpans( fill.GetBounds(),spans );
+	auto& history = layerManager.GetHistory();
+	const int curLayer = layerManager.GetActualSelectedLayer();
+	for( const auto& span : spans )
+	{
+		history.Touch( art,curLayer,
+			RectI{ span.left,span.right,span.y,span.y + 1 } );
+	}
+	art.FillSpans( spans,c );
+}
+
+void ImageHandler::ReplaceAt( const Vei2& pos,Color c,bool allLayers )
+{
+	const Color old = GetArt().GetPixel( pos.x,pos.y );
+	if( old == c || !selection.IsSelected( pos.x,pos.y ) ) return;
 
+	layerManager.ReplaceColor( old,c,replaceTolerance,selection,allLayers );
+}
+
+void ImageHandler::ResizeCanvas( const Vei2& newSize )
+{
+	canvSize = newSize;
 	layerManager.ResizeCanvas( newSize );
+	UpdateSelectArea();
 }
 
-void ImageHandler::CreateNewLayer()
+void ImageHandler::CreateNewLayer( const Surface& content )
 {
-	layerManager.CreateNewLayer( art );
+	layerManager.CreateNewLayer( content,dither );
 }
 
 void ImageHandler::UpdateSelectArea()
 {
-	selectStart = { 0,0 };
-	selectEnd = art.GetSize();
+	selection.Resize( canvSize );
+	lassoPoints.clear();
+	OnSelectionChanged();
+}
+
+void ImageHandler::SetCheckerSize( int size )
+{
+	assert( size > 0 );
+	checkerSize = size;
 }
 
 void ImageHandler::DrawCursor( Graphics& gfx ) const
@@ -738,8 +977,8 @@ void ImageHandler::DrawCursor( Graphics& gfx ) const
 
 	const auto mousePos = mouse.GetPos();
 
-	const Color cursorCol = art.GetExpandedBy( scale )
-		.GetRect().GetMovedBy( artPos ).ContainsPoint( mousePos )
+	const Color cursorCol = drawSurf.GetRect()
+		.GetExpandedByScale( Vei2( scale ) ).GetMovedBy( Vei2( artPos ) ).ContainsPoint( mousePos )
 		? Colors::DarkGray : Colors::LightGray;
 	if( clipArea.ContainsPoint( mouse.GetPos() ) )
 	{
@@ -778,6 +1017,7 @@ void ImageHandler::DrawCursor( Graphics& gfx ) const
 				SpriteEffect::Substitution( Colors::Magenta,cursorCol ) );
 			break;
 		case ToolMode::Resizer:
+		{
 			RectI resizeArea = { cropStart.x,cropEnd.x,
 				cropStart.y,cropEnd.y };
 
@@ -800,7 +1040,8 @@ void ImageHandler::DrawCursor( Graphics& gfx ) const
 				gfx.DrawSprite( mousePos.x,mousePos.y,miniResizer,
 					SpriteEffect::Substitution( Colors::Magenta,cursorCol ) );
 			}
-			break;
+		}
+		break;
 		case ToolMode::Ruler:
 			if( mouse.LeftIsPressed() )
 			{
@@ -816,6 +1057,14 @@ void ImageHandler::DrawCursor( Graphics& gfx ) const
 			gfx.DrawSprite( mousePos.x,mousePos.y,miniSelector,
 				SpriteEffect::Substitution( Colors::Magenta,cursorCol ) );
 			break;
+		case ToolMode::Lasso:
+			gfx.DrawSprite( mousePos.x,mousePos.y,miniLasso,
+				SpriteEffect::Substitution( Colors::Magenta,cursorCol ) );
+			break;
+		case ToolMode::Wand:
+			gfx.DrawSprite( mousePos.x,mousePos.y,miniWand,
+				SpriteEffect::Substitution( Colors::Magenta,cursorCol ) );
+			break;
 		case ToolMode::Pointer:
 			gfx.DrawSprite( mousePos.x,mousePos.y,miniPointer,
 				SpriteEffect::Substitution( Colors::Magenta,cursorCol ) );
@@ -830,18 +1079,190 @@ void ImageHandler::DrawCursor( Graphics& gfx ) const
 
 Surface ImageHandler::GetLayeredArt() const
 {
-	auto temp = Surface{ art.GetWidth(),art.GetHeight() };
-	temp.DrawRect( 0,0,
-		temp.GetWidth(),temp.GetHeight(),
-		Colors::Magenta );
-	const auto& layers = layerManager.GetLayers();
-	const auto& hiddenLayers = layerManager.GetHiddenLayers();
-	for( int i = 0; i < int( layers.size() ); ++i )
+	auto temp = ComposeLayers();
+	// Files only have keyed or opaque pixels, half covered or more stays.
+	temp.Unpremultiply( chroma,exportAlpha );
+	return( temp );
+}
+
+Surface ImageHandler::ComposeLayers() const
+{
+	// Starts fully transparent, layer 0 is on top so go backwards.
+	auto temp = Surface{ canvSize.x,canvSize.y };
+	Surface scratch = { 0,0 };
+	for( int i = layerManager.GetLayerCount() - 1; i >= 0; --i )
 	{
-		if( !hiddenLayers[i] )
+		const auto& layer = layerManager.GetLayer( i );
+		if( !layer.hidden )
 		{
-			temp.LightCopyInto( layers[i] );
+			temp.BlendInto( layerManager.GetLayerPixels( i,scratch ),
+				layer.mode,layer.opacity );
 		}
 	}
 	return( temp );
 }
+
+void ImageHandler::ApplyPalettePreview()
+{
+	// Only rebuilt when the table changes, a frame's worth of work.
+	const auto& table = layerManager.GetColorTable();
+	if( !previewLookup || !previewLookup->IsFor( table ) )
+	{
+		previewLookup = std::make_unique<ColorLookup>( table );
+	}
+
+	Surface mapped = { 0,0 };
+	drawSurf.Unpremultiply( chroma );
+	previewLookup->Remap( drawSurf,dither ).Expand( mapped,table );
+	drawSurf = Surface{ canvSize.x,canvSize.y };
+	drawSurf.BlendInto( mapped,BlendMode::Normal,255 );
+}
+
+bool ImageHandler::IsIndexed() const
+{
+	return( layerManager.IsIndexed() );
+}
+
+const ColorTable& ImageHandler::GetColorTable() const
+{
+	return( layerManager.GetColorTable() );
+}
+
+std::vector<std::pair<Color,int>> ImageHandler::GetColorUsage() const
+{
+	return( layerManager.GetColorUsage() );
+}
+
+unsigned int ImageHandler::GetUsageVersion() const
+{
+	return( layerManager.GetUsageVersion() );
+}
+
+void ImageHandler::SetPalette( const std::vector<Color>& colors )
+{
+	layerManager.SetColorTable( ColorTable{ colors } );
+}
+
+bool ImageHandler::IsBusy() const
+{
+	return( layerManager.IsBusy() );
+}
+
+
+int ImageHandler::GetFrameCount() const
+{
+	return( layerManager.GetFrameCount() );
+}
+
+int ImageHandler::GetCurFrame() const
+{
+	return( layerManager.GetCurFrame() );
+}
+
+void ImageHandler::SelectFrame( int frame )
+{
+	// Lifted pixels belong to the frame they came from.
+	if( floating.IsFloating() ) return;
+
+	FinishStroke();
+	layerManager.SelectFrame( frame );
+	UpdateArt();
+}
+
+void ImageHandler::DuplicateFrame()
+{
+	if( floating.IsFloating() ) return;
+
+	FinishStroke();
+	layerManager.DuplicateFrame();
+	UpdateArt();
+}
+
+void ImageHandler::DeleteFrame()
+{
+	if( floating.IsFloating() ) return;
+
+	FinishStroke();
+	layerManager.DeleteFrame();
+	UpdateArt();
+}
+
+float ImageHandler::GetFrameDuration( int frame ) const
+{
+	return( layerManager.GetFrameDuration( frame ) );
+}
+
+void ImageHandler::SetFrameDuration( int frame,float seconds )
+{
+	layerManager.SetFrameDuration( frame,seconds );
+}
+
+const std::vector<LayerManager::FrameLayer>& ImageHandler::GetFrameLayers( int frame ) const
+{
+	return( layerManager.GetFrameLayers( frame ) );
+}
+
+Surface ImageHandler::ComposeFrame( int frame ) const
+{
+	return( layerManager.ComposeFrame( frame ) );
+}
+
+const Surface& ImageHandler::GetComposite() const
+{
+	return( composite );
+}
+
+bool ImageHandler::IsStrip() const
+{
+	return( GetFrameCount() == 1 && canvSize.x > canvSize.y &&
+		canvSize.x % canvSize.y == 0 );
+}
+
+void ImageHandler::GetAnimation( bool asStrip,std::vector<Surface>& frames,
+	std::vector<float>& durations ) const
+{
+	frames.clear();
+	durations.clear();
+	if( asStrip && IsStrip() )
+	{
+		const auto art = GetLayeredArt();
+		for( int x = 0; x < canvSize.x; x += canvSize.y )
+		{
+			frames.emplace_back( art,RectI{ x,x + canvSize.y,0,canvSize.y } );
+			durations.emplace_back( stripHold );
+		}
+		return;
+	}
+
+	for( int i = 0; i < GetFrameCount(); ++i )
+	{
+		// Only the current frame's cels can be behind.
+		if( i == GetCurFrame() ) frames.emplace_back( GetLayeredArt() );
+		else
+		{
+			frames.emplace_back( ComposeFrame( i ) );
+			frames.back().Unpremultiply( chroma,exportAlpha );
+		}
+		durations.emplace_back( GetFrameDuration( i ) );
+	}
+}
+
+void ImageHandler::SetOnionRange( int range )
+{
+	onion.SetRange( range );
+	UpdateArt();
+}
+
+int ImageHandler::GetOnionRange() const
+{
+	return( onion.GetRange() );
+}
+
+void ImageHandler::FinishStroke()
+{
+	if( !stroke.IsActive() ) return;
+
+	stroke.Apply( GetArt(),layerManager.GetHistory(),
+		layerManager.GetActualSelectedLayer(),selection );
+	stroke.End();
+}
\ No newline at end of file
@@ -9,6 +9,12 @@
 #include "ToolMode.h"
 #include "Font.h"
 #include "LayerManager.h"
+#include "Stroke.h"
+#include "SelectionMask.h"
+#include "FloatingSelection.h"
+#include "OnionSkin.h"
+#include "ColorLookup.h"
+#include <memory>
 
 class ImageHandler
 {
@@ -25,19 +31,83 @@ public:
 	void UpdateArt();
 	Surface& GetArt();
 	void ResizeCanvas( const Vei2& newSize );
-	void CreateNewLayer();
+	// New layer above the current one holding content.
+	void CreateNewLayer( const Surface& content );
 	void UpdateSelectArea();
+	// Set size of transparency checkerboard cells in screen pixels.
+	void SetCheckerSize( int size );
 
 	void DrawCursor( Graphics& gfx ) const;
 	Surface GetLayeredArt() const;
+	// Least alpha a pixel needs to end up opaque in GetLayeredArt and
+	//  GetAnimation, anything less is keyed out.
+	static constexpr unsigned char exportAlpha = 128u;
+	// Indexed documents keep layers as indices into a shared color table.
+	bool IsIndexed() const;
+	// Seconds each cell of a strip stays up, see IsStrip.
+	static constexpr float stripHold = 0.1f;
+	const ColorTable& GetColorTable() const;
+	// See LayerManager::GetColorUsage.
+	std::vector<std::pair<Color,int>> GetColorUsage() const;
+	unsigned int GetUsageVersion() const;
+	// Colors the table starts from next time the document goes indexed.
+	void SetPalette( const std::vector<Color>& colors );
+	// True if the next frame could look different even without input.
+	bool IsBusy() const;
+	// Animation frames, see LayerManager.
+	int GetFrameCount() const;
+	int GetCurFrame() const;
+	void SelectFrame( int frame );
+	void DuplicateFrame();
+	void DeleteFrame();
+	float GetFrameDuration( int frame ) const;
+	void SetFrameDuration( int frame,float seconds );
+	const std::vector<LayerManager::FrameLayer>& GetFrameLayers( int frame ) const;
+	Surface ComposeFrame( int frame ) const;
+	// Premultiplied visible layers of the current frame as of the last
+	//  UpdateArt, watch its version to catch edits.
+	const Surface& GetComposite() const;
+	// One frame wider than tall by a whole number of squares, which can
+	//  play as a strip of square cells.
+	bool IsStrip() const;
+	// Every frame chroma keyed with how many seconds it stays up, or the
+	//  cells of a strip if asStrip and IsStrip.
+	void GetAnimation( bool asStrip,std::vector<Surface>& frames,
+		std::vector<float>& durations ) const;
+	// Frames shown under the current one on each side, 0 for none.
+	void SetOnionRange( int range );
+	int GetOnionRange() const;
 private:
-	// Recursive, call to fill until hitting "walls".
-	void TryFillPlusAt( const Vei2& pos,Color c,Color baseFill );
+	// Writes what the stroke has so far into the current layer and ends it.
+	void FinishStroke();
+	// Feeds a mouse event to the brush stroke, starting or ending it when
+	//  the buttons change.
+	void UpdateStroke( const Mouse::Event& e,ToolMode tool,Color main,Color off );
+	// Adds a point to the lasso while the left button is down.
+	void UpdateLasso( const Mouse::Event& e );
+	// Canvas pixel under pos, can be off the canvas.
+	Vei2 ScreenToCanvas( const Vei2& pos ) const;
+	// Remaps drawSurf through the color table, see previewPalette.
+	void ApplyPalettePreview();
+	// Ctrl adds to the selection, alt takes away, both intersect.
+	SelectionMask::Op GetSelectOp() const;
+	// Call after changing selection, updates its bounds and outline.
+	void OnSelectionChanged();
+	// Selected pixels of the active layer inside the selection bounds,
+	//  unselected ones come out as chroma.
+	Surface GetSelectedPixels() const;
+	// Bucket fill of the area of pos's color that touches pos, only
+	//  inside the selection.
+	void FillAt( const Vei2& pos,Color c );
+	// Every pixel of pos's color becomes c, on the active layer or all of
+	//  them, only inside the selection.
+	void ReplaceAt( const Vei2& pos,Color c,bool allLayers );
+	// Blends visible layers bottom up, result is premultiplied.
+	Surface ComposeLayers() const;
 private:
 	Mouse& mouse;
 	Keyboard& kbd;
 	Vei2 canvSize = { 8,8 };
-	Surface art;
 	const RectI& clipArea;
 	Vec2 artPos;
 	Vec2 scale = { 10.0f,10.0f };
@@ -46,12 +116,21 @@ private:
 	Vei2 mousePos = { 0,0 };
 	Vei2 oldMousePos = { 0,0 };
 	bool clickingLastFrame = false;
+	Stroke stroke;
+	// For shift click lines, separate so they don't end the stroke.
+	Stroke lineStroke;
+	// Reused every frame so draining the mouse doesn't allocate.
+	std::vector<Mouse::Event> mouseEvents;
 	ToolMode& curTool;
-	// static constexpr int bgGrainAmount = 10;
-	Surface bgPattern;
+	// Checkerboard cell size in screen pixels, doesn't change with zoom.
+	int checkerSize = 8;
+	static constexpr Color checkerCol1 = Colors::MakeRGB( 255,255,255 );
+	static constexpr Color checkerCol2 = Colors::MakeRGB( 204,204,204 );
 
+	// Visible layers blended at canvas size, zoomed in when drawn.
 	Surface drawSurf;
-	Surface bigPattern;
+	// drawSurf before the palette preview and onion skin.
+	Surface composite = { 0,0 };
 
 	Vei2 cropStart = { 0,0 };
 	bool canCrop = false;
@@ -74,25 +153,46 @@ private:
 	const Surface miniRuler = { Surface{ "Icons/MiniRuler.bmp" },Vei2{ 3,3 } };
 	const Surface miniPointer = { Surface{ "Icons/MiniPointer.bmp" },Vei2{ 3,3 } };
 	const Surface miniSelector = { Surface{ "Icons/MiniSelector.bmp" },Vei2{ 3,3 } };
+	const Surface miniLasso = { Surface{ "Icons/MiniLasso.bmp" },Vei2{ 3,3 } };
+	const Surface miniWand = { Surface{ "Icons/MiniWand.bmp" },Vei2{ 3,3 } };
 
-	const Font luckyPixel = "Fonts/LuckyPixel24x36.bmp";
+	const Font luckyPixel = Font{ "Fonts/LuckyPixel24x36.bmp" };
 
 	LayerManager layerManager; // How creative.
 	bool hoveringLastFrame = false;
 	RectI selectedLayerRect = { -1,-1,-1,-1 };
 
+	// What's selected, selectStart and selectEnd are its bounds except
+	//  while dragging out a rect.
+	SelectionMask selection = { canvSize.x,canvSize.y };
+	SelectionMask::Op selectOp = SelectionMask::Op::Replace;
+	// Edges of the selection in canvas pixels, empty if it's everything.
+	std::vector<std::pair<Vei2,Vei2>> selectionOutline;
+	std::vector<Vei2> lassoPoints;
+	// Exact matches suit pixel art, SelectionMask takes any tolerance.
+	static constexpr int wandTolerance = 0;
+	static constexpr int replaceTolerance = 0;
 	Vei2 selectStart = { 0,0 };
 	bool canSelect = false;
+	bool draggingSelect = false;
 	Vei2 selectEnd = { 0,0 };
 	bool selectingStuff = false;
 	Surface clipboard = { 0,0 };
 	Vei2 clipboardPos = { 0,0 };
 	bool canPaste = false;
+	bool canUndo = false;
+	bool canRedo = false;
 
-	bool draggingPointer = false;
+	// Shows drawSurf in the color table's colors, dither also goes for
+	//  images brought into an indexed document.
+	bool previewPalette = false;
+	bool canTogglePreview = false;
+	DitherMode dither = DitherMode::None;
+	std::unique_ptr<ColorLookup> previewLookup;
+
+	// Selected pixels being dragged or nudged with the pointer.
+	FloatingSelection floating;
+	OnionSkin onion;
+	// Canvas pixel the pointer drag started on.
 	Vei2 pointerStart = { 0,0 };
-	Vei2 pointerDelta = { 0,0 };
-	Vei2 pointerPos = { 0,0 };
-	Surface pointerMoveClip = { 0,0 };
-	Surface miniPointerMoveClip = { 0,0 };
 };
\ No newline at end of file
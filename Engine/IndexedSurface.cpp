@@ -0,0 +1,171 @@
+#include "IndexedSurface.h"
+#include <algorithm>
+#include <cassert>
+#include <climits>
+
+ColorTable::ColorTable()
+{
+	colors.fill( chroma );
+	RebuildLookup();
+}
+
+ColorTable::ColorTable( const std::vector<Color>& colors )
+	:
+	ColorTable()
+{
+	for( const auto c : colors )
+	{
+		if( count == maxColors ) break;
+		if( lookup.count( c.dword ) > 0 ) continue;
+		lookup.emplace( c.dword,static_cast<unsigned char>( count ) );
+		this->colors[count++] = c;
+	}
+}
+
+unsigned char ColorTable::GetIndex( Color c )
+{
+	const auto it = lookup.find( c.dword );
+	if( it != lookup.end() ) return( it->second );
+
+	if( count < maxColors )
+	{
+		const auto index = static_cast<unsigned char>( count++ );
+		colors[index] = c;
+		lookup.emplace( c.dword,index );
+		return( index );
+	}
+	return( GetClosest( c ) );
+}
+
+void ColorTable::SetColor( unsigned char index,Color c )
+{
+	assert( index > 0 );
+	colors[index] = c;
+	if( index >= count ) count = index + 1;
+	RebuildLookup();
+}
+
+Color ColorTable::GetColor( unsigned char index ) const
+{
+	return( colors[index] );
+}
+
+int ColorTable::GetCount() const
+{
+	return( count );
+}
+
+const Color* ColorTable::GetColors() const
+{
+	return( colors.data() );
+}
+
+unsigned char ColorTable::GetClosest( Color c ) const
+{
+	// Never chroma, that would punch holes in the image.
+	int best = 1;
+	int bestDist = INT_MAX;
+	for( int i = 1; i < count; ++i )
+	{
+		const int dr = int( colors[i].GetR() ) - int( c.GetR() );
+		const int dg = int( colors[i].GetG() ) - int( c.GetG() );
+		const int db = int( colors[i].GetB() ) - int( c.GetB() );
+		const int dist = dr * dr + dg * dg + db * db;
+		if( dist < bestDist )
+		{
+			best = i;
+			bestDist = dist;
+		}
+	}
+	return( static_cast<unsigned char>( best ) );
+}
+
+void ColorTable::RebuildLookup()
+{
+	// Earlier indices win when two have the same color.
+	lookup.clear();
+	for( int i = count - 1; i >= 0; --i )
+	{
+		lookup[colors[i].dword] = static_cast<unsigned char>( i );
+	}
+}
+
+IndexedSurface::IndexedSurface( int width,int height )
+	:
+	indices( size_t( width ) * height,0u ),
+	width( width ),
+	height( height )
+{}
+
+IndexedSurface::IndexedSurface( const Surface& surf,ColorTable& table )
+	:
+	IndexedSurface( surf.GetWidth(),surf.GetHeight() )
+{
+	// Neighbours are usually the same color, skip the hash for those.
+	Color last = ColorTable::chroma;
+	unsigned char lastIndex = table.GetIndex( last );
+	const auto& src = surf.GetRawPixelData();
+	for( size_t i = 0; i < src.size(); ++i )
+	{
+		if( src[i] != last )
+		{
+			last = src[i];
+			lastIndex = table.GetIndex( last );
+		}
+		indices[i] = lastIndex;
+	}
+}
+
+void IndexedSurface::Expand( Surface& out,const ColorTable& table ) const
+{
+	if( out.GetSize() != GetSize() ) out = Surface{ width,height };
+	out.CopyFrom( indices.data(),table.GetColors() );
+}
+
+void IndexedSurface::Resize( const Vei2& newSize )
+{
+	std::vector<unsigned char> resized( size_t( newSize.x ) * newSize.y,0u );
+	const int copyWidth = std::min( width,newSize.x );
+	const int copyHeight = std::min( height,newSize.y );
+	for( int y = 0; y < copyHeight; ++y )
+	{
+		std::copy( indices.begin() + y * width,
+			indices.begin() + y * width + copyWidth,
+			resized.begin() + y * newSize.x );
+	}
+	indices = std::move( resized );
+	width = newSize.x;
+	height = newSize.y;
+}
+
+unsigned char IndexedSurface::GetIndex( int x,int y ) const
+{
+	assert( x >= 0 && x < width && y >= 0 && y < height );
+	return( indices[y * width + x] );
+}
+
+void IndexedSurface::SetIndex( int x,int y,unsigned char index )
+{
+	assert( x >= 0 && x < width && y >= 0 && y < height );
+	indices[y * width + x] = index;
+}
+
+int IndexedSurface::GetWidth() const
+{
+	return( width );
+}
+
+int IndexedSurface::GetHeight() const
+{
+	return( height );
+}
+
+Vei2 IndexedSurface::GetSize() const
+{
+	return( Vei2{ width,height } );
+}
+
+const std::vector<unsigned char>& IndexedSurface::GetRawIndices() const
+{
+	return( indices );
+}
\ No newline at end of file
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Surface.h"
+#include "Colors.h"
+#include "Vec2.h"
+#include <array>
+#include <vector>
+#include <unordered_map>
+
+// Up to 256 colors shared by the layers of an indexed document.  Index 0
+//  is always chroma so transparent pixels stay transparent.
+class ColorTable
+{
+public:
+	static constexpr int maxColors = 256;
+	static constexpr Color chroma = Colors::Magenta;
+public:
+	ColorTable();
+	// Chroma followed by colors, anything that doesn't fit is left out.
+	ColorTable( const std::vector<Color>& colors );
+
+	// Index of c.  New colors get added while there's room, after that
+	//  they go to whichever color is closest.
+	unsigned char GetIndex( Color c );
+	// Changes what index shows up as, every pixel using it follows.
+	void SetColor( unsigned char index,Color c );
+	Color GetColor( unsigned char index ) const;
+	int GetCount() const;
+	// All maxColors entries, unused ones are chroma.
+	const Color* GetColors() const;
+private:
+	unsigned char GetClosest( Color c ) const;
+	void RebuildLookup();
+private:
+	std::array<Color,maxColors> colors;
+	int count = 1;
+	std::unordered_map<unsigned int,unsigned char> lookup;
+};
+
+// Pixels stored as 8 bit indices into a ColorTable, a quarter the memory
+//  of a Surface.  Colors only come back when it gets expanded.
+class IndexedSurface
+{
+public:
+	IndexedSurface( int width,int height );
+	// Every pixel of surf mapped through table, see ColorTable::GetIndex.
+	IndexedSurface( const Surface& surf,ColorTable& table );
+
+	// Looks every pixel up in table, out gets resized if it has to be.
+	void Expand( Surface& out,const ColorTable& table ) const;
+	// Area that's new gets index 0, same as Surface::Resize leaving chroma.
+	void Resize( const Vei2& newSize );
+
+	unsigned char GetIndex( int x,int y ) const;
+	void SetIndex( int x,int y,unsigned char index );
+	int GetWidth() const;
+	int GetHeight() const;
+	Vei2 GetSize() const;
+	const std::vector<unsigned char>& GetRawIndices() const;
+private:
+	std::vector<unsigned char> indices;
+	int width;
+	int height;
+};
\ No newline at end of file
@@ -0,0 +1,118 @@
+#include "InputRecording.h"
+#include "Mouse.h"
+#include "Keyboard.h"
+#include <fstream>
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+	// Written instead of enum values so files stay readable and don't break
+	//  if Type gets reordered.
+	const char* const typeNames[] =
+	{
+		"move",
+		"enter",
+		"leave",
+		"lpress",
+		"lrelease",
+		"rpress",
+		"rrelease",
+		"wheelup",
+		"wheeldown",
+		"keypress",
+		"keyrelease",
+		"keyclear",
+		"char"
+	};
+	constexpr int nTypes = int( sizeof( typeNames ) / sizeof( typeNames[0] ) );
+}
+
+void InputRecording::Add( Type type,int x,int y,int code )
+{
+	inputs.emplace_back( Input{ curFrame,type,x,y,code } );
+}
+
+void InputRecording::NextFrame()
+{
+	++curFrame;
+}
+
+void InputRecording::Play( int frame,Mouse& mouse,Keyboard& kbd )
+{
+	for( ; playPos < inputs.size() && inputs[playPos].frame <= frame; ++playPos )
+	{
+		const auto& in = inputs[playPos];
+		switch( in.type )
+		{
+		case Type::MouseMove: mouse.OnMouseMove( in.x,in.y ); break;
+		case Type::MouseEnter: mouse.OnMouseEnter(); break;
+		case Type::MouseLeave: mouse.OnMouseLeave(); break;
+		case Type::LPress: mouse.OnLeftPressed( in.x,in.y ); break;
+		case Type::LRelease: mouse.OnLeftReleased( in.x,in.y ); break;
+		case Type::RPress: mouse.OnRightPressed( in.x,in.y ); break;
+		case Type::RRelease: mouse.OnRightReleased( in.x,in.y ); break;
+		case Type::WheelUp: mouse.OnWheelUp( in.x,in.y ); break;
+		case Type::WheelDown: mouse.OnWheelDown( in.x,in.y ); break;
+		case Type::KeyPress: kbd.OnKeyPressed( static_cast<unsigned char>( in.code ) ); break;
+		case Type::KeyRelease: kbd.OnKeyReleased( static_cast<unsigned char>( in.code ) ); break;
+		case Type::KeyClear: kbd.ClearState(); break;
+		case Type::Char: kbd.OnChar( static_cast<char>( in.code ) ); break;
+		}
+	}
+	curFrame = std::max( curFrame,frame + 1 );
+}
+
+int InputRecording::GetFrameCount() const
+{
+	return( inputs.empty() ? curFrame
+		: std::max( curFrame,inputs.back().frame + 1 ) );
+}
+
+bool InputRecording::Save( const std::string& path ) const
+{
+	std::ofstream out( path );
+	if( !out ) return( false );
+
+	out << "aesc-input " << version << '\n';
+	for( const auto& in : inputs )
+	{
+		out << in.frame << ' ' << typeNames[int( in.type )] << ' ' <<
+			in.x << ' ' << in.y << ' ' << in.code << '\n';
+	}
+	return( bool( out ) );
+}
+
+bool InputRecording::Load( const std::string& path )
+{
+	std::ifstream in( path );
+	std::string magic;
+	int fileVersion = 0;
+	if( !( in >> magic >> fileVersion ) || magic != "aesc-input" ||
+		fileVersion != version )
+	{
+		return( false );
+	}
+
+	std::vector<Input> loaded;
+	Input input;
+	std::string name;
+	while( in >> input.frame >> name >> input.x >> input.y >> input.code )
+	{
+		const auto type = std::find( typeNames,typeNames + nTypes,name );
+		// Out of order frames would get played late, so they count as broken.
+		if( type == typeNames + nTypes || input.frame < 0 ||
+			( !loaded.empty() && input.frame < loaded.back().frame ) )
+		{
+			return( false );
+		}
+		input.type = Type( type - typeNames );
+		loaded.emplace_back( input );
+	}
+	if( !in.eof() ) return( false );
+
+	inputs = std::move( loaded );
+	curFrame = 0;
+	playPos = 0;
+	return( true );
+}
\ No newline at end of file
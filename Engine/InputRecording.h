@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+class Mouse;
+class Keyboard;
+
+// Mouse and keyboard input tagged with the frame it showed up before, so
+//  a session can be played back exactly for profiling.  Files are text,
+//  one input per line: frame type x y code.
+class InputRecording
+{
+public:
+	enum class Type
+	{
+		MouseMove,
+		MouseEnter,
+		MouseLeave,
+		LPress,
+		LRelease,
+		RPress,
+		RRelease,
+		WheelUp,
+		WheelDown,
+		KeyPress,
+		KeyRelease,
+		KeyClear,
+		Char
+	};
+	struct Input
+	{
+		int frame;
+		Type type;
+		int x;
+		int y;
+		int code;
+	};
+public:
+	// Recording side, Mouse and Keyboard call this once attached.
+	void Add( Type type,int x,int y,int code );
+	// Call after each updated frame, later inputs go with the next one.
+	void NextFrame();
+
+	// Feeds everything recorded before frame into mouse and kbd, frames
+	//  have to be played in order starting from 0.
+	void Play( int frame,Mouse& mouse,Keyboard& kbd );
+	// Frames covered, played back or recorded so far.
+	int GetFrameCount() const;
+
+	bool Save( const std::string& path ) const;
+	// Replaces what's in here, false if the file is missing or broken.
+	bool Load( const std::string& path );
+private:
+	std::vector<Input> inputs;
+	int curFrame = 0;
+	size_t playPos = 0;
+	static constexpr int version = 1;
+};
\ No newline at end of file
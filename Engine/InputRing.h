@@ -0,0 +1,81 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+// Fixed size queue for input events with one thread pushing and one
+//  reading.  Pushing never allocates or locks, if the ring is full the new
+//  event gets dropped and counted instead of shoving out older ones.
+template<typename T,size_t capacity>
+class InputRing
+{
+	static_assert( capacity > 0 && ( capacity & ( capacity - 1 ) ) == 0,
+		"capacity has to be a power of 2" );
+public:
+	InputRing() = default;
+	InputRing( const InputRing& ) = delete;
+	InputRing& operator=( const InputRing& ) = delete;
+
+	// Producer side, returns false if the ring was full.
+	bool Push( const T& item )
+	{
+		const size_t t = tail.load( std::memory_order_relaxed );
+		if( t - head.load( std::memory_order_acquire ) == capacity )
+		{
+			dropped.fetch_add( 1u,std::memory_order_relaxed );
+			return( false );
+		}
+		items[t & ( capacity - 1 )] = item;
+		tail.store( t + 1,std::memory_order_release );
+		return( true );
+	}
+	// Consumer side from here down.
+	bool Pop( T& item )
+	{
+		const size_t h = head.load( std::memory_order_relaxed );
+		if( h == tail.load( std::memory_order_acquire ) ) return( false );
+		item = items[h & ( capacity - 1 )];
+		head.store( h + 1,std::memory_order_release );
+		return( true );
+	}
+	// Appends everything queued to out in order, returns how many.
+	size_t PopAll( std::vector<T>& out )
+	{
+		const size_t h = head.load( std::memory_order_relaxed );
+		const size_t t = tail.load( std::memory_order_acquire );
+		for( size_t i = h; i != t; ++i )
+		{
+			out.emplace_back( items[i & ( capacity - 1 )] );
+		}
+		head.store( t,std::memory_order_release );
+		return( t - h );
+	}
+	void Clear()
+	{
+		head.store( tail.load( std::memory_order_acquire ),
+			std::memory_order_release );
+	}
+	bool IsEmpty() const
+	{
+		return( head.load( std::memory_order_relaxed ) ==
+			tail.load( std::memory_order_acquire ) );
+	}
+	size_t GetSize() const
+	{
+		return( tail.load( std::memory_order_acquire ) -
+			head.load( std::memory_order_relaxed ) );
+	}
+	// Events lost to a full ring since startup.
+	unsigned int GetDroppedCount() const
+	{
+		return( dropped.load( std::memory_order_relaxed ) );
+	}
+private:
+	std::array<T,capacity> items;
+	// Kept on separate cache lines so the two threads don't fight over them.
+	alignas( 64 ) std::atomic<size_t> head = { 0 };
+	alignas( 64 ) std::atomic<size_t> tail = { 0 };
+	std::atomic<unsigned int> dropped = { 0u };
+};
\ No newline at end of file
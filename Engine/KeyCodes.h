@@ -0,0 +1,29 @@
+#pragma once
+
+// Virtual key codes the editor checks for.  Windows builds get them from
+//  the sdk, everywhere else gets the same values so recorded input and
+//  shortcuts mean the same thing on every platform.
+#ifdef _WIN32
+#include "ChiliWin.h"
+#else
+enum : unsigned char
+{
+	VK_RETURN = 0x0D,
+	VK_SHIFT = 0x10,
+	VK_CONTROL = 0x11,
+	VK_MENU = 0x12,
+	VK_ESCAPE = 0x1B,
+	VK_SPACE = 0x20,
+	VK_LEFT = 0x25,
+	VK_UP = 0x26,
+	VK_RIGHT = 0x27,
+	VK_DOWN = 0x28,
+	VK_DELETE = 0x2E,
+	VK_OEM_PLUS = 0xBB,
+	VK_OEM_COMMA = 0xBC,
+	VK_OEM_MINUS = 0xBD,
+	VK_OEM_PERIOD = 0xBE,
+	VK_OEM_4 = 0xDB, // [
+	VK_OEM_6 = 0xDD // ]
+};
+#endif
\ No newline at end of file
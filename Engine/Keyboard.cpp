@@ -19,58 +19,50 @@
  *	along with The Chili DirectX Framework.  If not, see <http://www.gnu.org/licenses/>.  *
  ******************************************************************************************/
 #include "Keyboard.h"
+#include "InputRecording.h"
 
 bool Keyboard::KeyIsPressed( unsigned char keycode ) const
 {
 	return keystates[keycode];
 }
 
+bool Keyboard::AnyKeyIsPressed() const
+{
+	return keystates.any();
+}
+
 Keyboard::Event Keyboard::ReadKey()
 {
-	if( keybuffer.size() > 0u )
-	{
-		Keyboard::Event e = keybuffer.front();
-		keybuffer.pop();
-		return e;
-	}
-	else
-	{
-		return Keyboard::Event();
-	}
+	Keyboard::Event e;
+	keybuffer.Pop( e );
+	return e;
 }
 
 bool Keyboard::KeyIsEmpty() const
 {
-	return keybuffer.empty();
+	return keybuffer.IsEmpty();
 }
 
 char Keyboard::ReadChar()
 {
-	if( charbuffer.size() > 0u )
-	{
-		unsigned char charcode = charbuffer.front();
-		charbuffer.pop();
-		return charcode;
-	}
-	else
-	{
-		return 0;
-	}
+	char charcode = 0;
+	charbuffer.Pop( charcode );
+	return charcode;
 }
 
 bool Keyboard::CharIsEmpty() const
 {
-	return charbuffer.empty();
+	return charbuffer.IsEmpty();
 }
 
 void Keyboard::FlushKey()
 {
-	keybuffer = std::queue<Event>();
+	keybuffer.Clear();
 }
 
 void Keyboard::FlushChar()
 {
-	charbuffer = std::queue<char>();
+	charbuffer.Clear();
 }
 
 void Keyboard::Flush()
@@ -79,6 +71,11 @@ void Keyboard::Flush()
 	FlushChar();
 }
 
+unsigned int Keyboard::GetDroppedCount() const
+{
+	return keybuffer.GetDroppedCount() + charbuffer.GetDroppedCount();
+}
+
 void Keyboard::EnableAutorepeat()
 {
 	autorepeatEnabled = true;
@@ -94,37 +91,34 @@ bool Keyboard::AutorepeatIsEnabled() const
 	return autorepeatEnabled;
 }
 
+void Keyboard::SetRecording( InputRecording* recording )
+{
+	this->recording = recording;
+}
+
 void Keyboard::OnKeyPressed( unsigned char keycode )
 {
+	if( recording ) recording->Add( InputRecording::Type::KeyPress,0,0,keycode );
 	keystates[ keycode ] = true;	
-	keybuffer.push( Keyboard::Event( Keyboard::Event::Type::Press,keycode ) );
-	TrimBuffer( keybuffer );
+	keybuffer.Push( Keyboard::Event( Keyboard::Event::Type::Press,keycode ) );
 }
 
 void Keyboard::OnKeyReleased( unsigned char keycode )
 {
+	if( recording ) recording->Add( InputRecording::Type::KeyRelease,0,0,keycode );
 	keystates[ keycode ] = false;
-	keybuffer.push( Keyboard::Event( Keyboard::Event::Type::Release,keycode ) );
-	TrimBuffer( keybuffer );
+	keybuffer.Push( Keyboard::Event( Keyboard::Event::Type::Release,keycode ) );
 }
 
 void Keyboard::OnChar( char character )
 {
-	charbuffer.push( character );
-	TrimBuffer( charbuffer );
+	if( recording ) recording->Add( InputRecording::Type::Char,0,0,character );
+	charbuffer.Push( character );
 }
 
 void Keyboard::ClearState()
 {
+	if( recording ) recording->Add( InputRecording::Type::KeyClear,0,0,0 );
 	keystates.reset();
 }
 
-template<typename T>
-void Keyboard::TrimBuffer( std::queue<T>& buffer )
-{
-	while( buffer.size() > bufferSize )
-	{
-		buffer.pop();
-	}
-}
-
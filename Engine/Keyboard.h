@@ -19,16 +19,22 @@
  *	along with The Chili DirectX Framework.  If not, see <http://www.gnu.org/licenses/>.  *
  ******************************************************************************************/
 #pragma once
-#include <queue>
 #include <bitset>
+#include <chrono>
+#include "KeyCodes.h"
+#include "InputRing.h"
+
+class InputRecording;
 
 class Keyboard
 {
 	friend class MainWindow;
+	friend class InputRecording;
 public:
 	class Event
 	{
 	public:
+		typedef std::chrono::steady_clock::time_point Time;
 		enum class Type
 		{
 			Press,
@@ -38,16 +44,19 @@ public:
 	private:
 		Type type;
 		unsigned char code;
+		Time time;
 	public:
 		Event()
 			:
 			type( Type::Invalid ),
-			code( 0u )
+			code( 0u ),
+			time()
 		{}
 		Event( Type type,unsigned char code )
 			:
 			type( type ),
-			code( code )
+			code( code ),
+			time( std::chrono::steady_clock::now() )
 		{}
 		bool IsPress() const
 		{
@@ -65,12 +74,18 @@ public:
 		{
 			return code;
 		}
+		// When the event came in, not when it got read.
+		Time GetTime() const
+		{
+			return time;
+		}
 	};
 public:
 	Keyboard() = default;
 	Keyboard( const Keyboard& ) = delete;
 	Keyboard& operator=( const Keyboard& ) = delete;
 	bool KeyIsPressed( unsigned char keycode ) const;
+	bool AnyKeyIsPressed() const;
 	Event ReadKey();
 	bool KeyIsEmpty() const;
 	char ReadChar();
@@ -78,21 +93,24 @@ public:
 	void FlushKey();
 	void FlushChar();
 	void Flush();
+	// Events and chars thrown away because their buffer was full.
+	unsigned int GetDroppedCount() const;
 	void EnableAutorepeat();
 	void DisableAutorepeat();
 	bool AutorepeatIsEnabled() const;
+	// Everything coming in also gets added to recording, nullptr stops.
+	void SetRecording( InputRecording* recording );
 private:
 	void OnKeyPressed( unsigned char keycode );
 	void OnKeyReleased( unsigned char keycode );
 	void OnChar( char character );
 	void ClearState();
-	template<typename T>
-	void TrimBuffer( std::queue<T>& buffer );
 private:
 	static constexpr unsigned int nKeys = 256u;
-	static constexpr unsigned int bufferSize = 4u;
+	static constexpr size_t bufferSize = 256u;
 	bool autorepeatEnabled = false;
 	std::bitset<nKeys> keystates;
-	std::queue<Event> keybuffer;
-	std::queue<char> charbuffer;
+	InputRing<Event,bufferSize> keybuffer;
+	InputRing<char,bufferSize> charbuffer;
+	InputRecording* recording = nullptr;
 };
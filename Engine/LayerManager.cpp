@@ -1,5 +1,8 @@
 #include "LayerManager.h"
 #include "SpriteEffect.h"
+#include "Quantize.h"
+#include <algorithm>
+#include <cassert>
 
 LayerManager::LayerManager( const RectI& clipArea,const Vei2& canvSize )
 	:
@@ -8,8 +11,9 @@ LayerManager::LayerManager( const RectI& clipArea,const Vei2& canvSize )
 		Graphics::ScreenWidth - padding.x,
 		clipArea.bottom - 237,clipArea.bottom )
 {
-	layers.emplace_back( Surface{ canvSize.x,canvSize.y } );
-	layers.back().DrawRect( 0,0,canvSize.x,canvSize.y,Colors::Magenta );
+	Layer first = { Surface{ canvSize.x,canvSize.y } };
+	first.surf.DrawRect( 0,0,canvSize.x,canvSize.y,Colors::Magenta );
+	InsertLayer( 0,std::move( first ) );
 
 	const auto layerButtonStart = Vei2{ drawArea.left + padding.x * 3 + buttonSize.x * 2,
 		drawArea.top + padding.y };
@@ -17,7 +21,10 @@ LayerManager::LayerManager( const RectI& clipArea,const Vei2& canvSize )
 		drawArea.top + padding.y };
 	const auto lockStart = Vei2{ drawArea.left + padding.x * 2 + buttonSize.x,
 		drawArea.top + padding.y };
-	for( int i = 0; i < 7; ++i )
+	// Only as many rows as fit above the bottom buttons.
+	const int nRows = ( drawArea.GetHeight() - padding.y * 2 -
+		buttonSize.y ) / rowHeight;
+	for( int i = 0; i < nRows; ++i )
 	{
 		layerButtons.emplace_back( Button{ Surface{ Surface{
 			"Icons/LayerButton.bmp" },Vei2{ 3,3 } },
@@ -30,34 +37,64 @@ LayerManager::LayerManager( const RectI& clipArea,const Vei2& canvSize )
 			"Icons/UnhideLayerButton.bmp" },Vei2{ 3,3 } },
 			hideStart + ( padding.Y() + buttonSize.Y() ) * i } );
 
-		hiddenLayers.emplace_back( false );
-
 		lockLayerButtons.emplace_back( Button{ Surface{ Surface{
 			"Icons/LockLayerButton.bmp" },Vei2{ 3,3 } },
 			lockStart + ( padding.Y() + buttonSize.Y() ) * i } );
 		unlockLayerButtons.emplace_back( Button{ Surface{ Surface{
 			"Icons/UnlockLayerButton.bmp" },Vei2{ 3,3 } },
 			lockStart + ( padding.Y() + buttonSize.Y() ) * i } );
+	}
+}
+
+bool LayerManager::Update( const Keyboard& kbd,const Mouse& mouse )
+{
+	// Tools draw straight into the active layer, its dirty rect says if
+	//  the thumbnail needs redoing.
+	auto& active = LayerAt( selectedLayer ).surf;
+	if( active.IsDirty() )
+	{
+		active.ClearDirty();
+		thumbnails.Invalidate( order[selectedLayer] );
+	}
+	UpdateThumbnails();
+
+	bool changed = UpdateStack( kbd,mouse );
 
-		lockLayers.emplace_back( false );
+	// Ctrl+I switches between indexed and full color layers.
+	if( kbd.KeyIsPressed( VK_CONTROL ) && kbd.KeyIsPressed( 'I' ) )
+	{
+		if( canToggleIndexed )
+		{
+			EndEdit();
+			SetIndexed( !indexed );
+			changed = true;
+		}
+		canToggleIndexed = false;
 	}
+	else canToggleIndexed = true;
+
+	SyncStorage();
+	return( changed );
 }
 
-bool LayerManager::Update( const Keyboard& kbd,const Mouse& mouse,Surface& art )
+bool LayerManager::UpdateStack( const Keyboard& kbd,const Mouse& mouse )
 {
-	layers[selectedLayer].CopyInto( art );
+	bool changed = false;
 
 	if( addLayer.Update( mouse ) ||
 		( kbd.KeyIsPressed( VK_CONTROL ) &&
 		kbd.KeyIsPressed( 'N' ) ) )
 	{
-		if( layers.size() < 7 && canCreateLayer )
+		if( canCreateLayer )
 		{
-			// layers.emplace_back( Surface{ canvSize.x,canvSize.y } );
-			layers.insert( layers.begin(),Surface{ canvSize.x,canvSize.y } );
-			layers.front().DrawRect( 0,0,canvSize.x,canvSize.y,Colors::Magenta );
+			EndEdit();
+			Layer layer = { Surface{ canvSize.x,canvSize.y } };
+			layer.surf.DrawRect( 0,0,canvSize.x,canvSize.y,Colors::Magenta );
+			InsertLayer( 0,std::move( layer ) );
+			history.PushLayers( {},{ SaveLayer( 0 ) } );
 			selectedLayer = 0;
-			art.CopyInto( layers[selectedLayer] );
+			ScrollToSelected();
+			changed = true;
 		}
 		canCreateLayer = false;
 	}
@@ -67,11 +104,13 @@ bool LayerManager::Update( const Keyboard& kbd,const Mouse& mouse,Surface& art )
 		( kbd.KeyIsPressed( VK_CONTROL ) &&
 		kbd.KeyIsPressed( 'J' ) ) )
 	{
-		if( layers.size() < 7 && canDupeLayer )
+		if( canDupeLayer )
 		{
-			layers.insert( layers.begin() + selectedLayer,
-				Surface{ layers[selectedLayer] } );
-			art.CopyInto( layers[selectedLayer] );
+			EndEdit();
+			Layer copy = LayerAt( selectedLayer );
+			InsertLayer( selectedLayer,std::move( copy ) );
+			history.PushLayers( {},{ SaveLayer( selectedLayer ) } );
+			changed = true;
 		}
 		canDupeLayer = false;
 	}
@@ -80,14 +119,14 @@ bool LayerManager::Update( const Keyboard& kbd,const Mouse& mouse,Surface& art )
 	if( removeLayer.Update( mouse ) ||
 		kbd.KeyIsPressed( VK_DELETE ) )
 	{
-		if( layers.size() > 1 && canDeleteLayer )
+		if( GetLayerCount() > 1 && canDeleteLayer )
 		{
-			// layers.pop_back();
-			layers.erase( layers.begin() + selectedLayer );
-			--selectedLayer;
-			if( selectedLayer < 0 ) selectedLayer = 0;
-			if( selectedLayer > int( layers.size() ) ) selectedLayer = int( layers.size() );
-			art.CopyInto( layers[selectedLayer] );
+			EndEdit();
+			history.PushLayers( { SaveLayer( selectedLayer ) },{} );
+			EraseLayer( selectedLayer );
+			selectedLayer = std::max( 0,selectedLayer - 1 );
+			ScrollToSelected();
+			changed = true;
 		}
 		canDeleteLayer = false;
 	}
@@ -97,60 +136,132 @@ bool LayerManager::Update( const Keyboard& kbd,const Mouse& mouse,Surface& art )
 		( kbd.KeyIsPressed( VK_CONTROL ) &&
 			kbd.KeyIsPressed( 'E' ) ) )
 	{
-		if( selectedLayer < int( layers.size() ) - 1 && canMergeLayer )
+		// Bake both layers' opacity into the result, lower layer first.
+		Surface merged = { 0,0 };
+		int coverage = -1;
+		if( selectedLayer < GetLayerCount() - 1 && canMergeLayer &&
+			LayerAt( selectedLayer ).mode == BlendMode::Normal &&
+			LayerAt( selectedLayer + 1 ).mode == BlendMode::Normal &&
+			LayerAt( selectedLayer ).hidden == LayerAt( selectedLayer + 1 ).hidden )
+		{
+			merged = Surface{ canvSize.x,canvSize.y };
+			Surface scratch = { 0,0 };
+			for( int i = selectedLayer + 1; i >= selectedLayer; --i )
+			{
+				merged.BlendInto( GetLayerPixels( i,scratch ),
+					BlendMode::Normal,LayerAt( i ).opacity );
+			}
+			coverage = merged.GetUniformAlpha();
+		}
+		// A layer is keyed or opaque pixels under one opacity, which can
+		//  only hold the result if every pixel ended up equally covered.
+		//  Anything else, blend modes that depend on what's below or
+		//  merging a hidden layer into a shown one would change the
+		//  picture, so those don't merge.
+		if( coverage >= 0 )
 		{
-			layers[selectedLayer].LightCopyInto( layers[selectedLayer + 1] );
+			EndEdit();
+			auto before = std::vector<History::LayerState>{
+				SaveLayer( selectedLayer ),SaveLayer( selectedLayer + 1 ) };
+
+			merged.Unpremultiply( Colors::Magenta );
+			auto& top = LayerAt( selectedLayer );
+			// Blending makes new colors, they go through the table.
+			if( indexed ) IndexedSurface{ merged,colorTable }.Expand( merged,colorTable );
+			top.surf = std::move( merged );
+			top.opacity = coverage == 0 ? 255u : static_cast< unsigned char >( coverage );
+			top.mode = BlendMode::Normal;
+			thumbnails.Invalidate( order[selectedLayer] );
 
-			layers.erase( layers.begin() + selectedLayer + 1 );
-			art.CopyInto( layers[selectedLayer] );
+			EraseLayer( selectedLayer + 1 );
+			history.PushLayers( std::move( before ),{ SaveLayer( selectedLayer ) } );
+			changed = true;
 		}
 		canMergeLayer = false;
 	}
 	else canMergeLayer = true;
 
-	for( int i = 0; i < int( layers.size() ); ++i )
+	// Ctrl+] moves the selected layer up the stack, Ctrl+[ moves it down.
+	if( kbd.KeyIsPressed( VK_CONTROL ) &&
+		( kbd.KeyIsPressed( VK_OEM_4 ) || kbd.KeyIsPressed( VK_OEM_6 ) ) )
 	{
-		if( layerButtons[i].Update( mouse ) )
+		const int target = selectedLayer +
+			( kbd.KeyIsPressed( VK_OEM_6 ) ? -1 : 1 );
+		if( target >= 0 && target < GetLayerCount() && canMoveLayer )
 		{
-			selectedLayer = i;
-			art.CopyInto( layers[selectedLayer] );
+			EndEdit();
+			MoveLayer( selectedLayer,target );
+			history.PushMove( selectedLayer,target );
+			selectedLayer = target;
+			ScrollToSelected();
+			canMoveLayer = false;
+			return( true );
 		}
+		canMoveLayer = false;
+	}
+	else canMoveLayer = true;
+
+	for( int row = 0; row < GetVisibleRows(); ++row )
+	{
+		const int pos = scroll + row;
+		if( pos >= GetLayerCount() ) break;
+		auto& layer = LayerAt( pos );
 
-		if( !hiddenLayers[i] )
+		if( layerButtons[row].Update( mouse ) )
 		{
-			if( hideLayerButtons[i].Update( mouse ) )
+			// Edits belong to the layer they started on.
+			EndEdit();
+			selectedLayer = pos;
+			changed = true;
+		}
+
+		// Right click a layer to cycle through blend modes.
+		if( layerButtons[row].IsHovering() && mouse.RightIsPressed() )
+		{
+			if( canCycleBlendMode )
+			{
+				layer.mode = Blend::GetNextMode( layer.mode );
+				canCycleBlendMode = false;
+				return( true );
+			}
+		}
+		else if( !mouse.RightIsPressed() ) canCycleBlendMode = true;
+
+		if( !layer.hidden )
+		{
+			if( hideLayerButtons[row].Update( mouse ) )
 			{
-				hiddenLayers[i] = true;
+				layer.hidden = true;
 				return( true );
 			}
 		}
 		else
 		{
-			if( unhideLayerButtons[i].Update( mouse ) )
+			if( unhideLayerButtons[row].Update( mouse ) )
 			{
-				hiddenLayers[i] = false;
+				layer.hidden = false;
 				return( true );
 			}
 		}
 
-		if( !lockLayers[i] )
+		if( !layer.locked )
 		{
-			if( lockLayerButtons[i].Update( mouse ) )
+			if( lockLayerButtons[row].Update( mouse ) )
 			{
-				lockLayers[i] = true;
+				layer.locked = true;
 				return( true );
 			}
 		}
 		else
 		{
-			if( unlockLayerButtons[i].Update( mouse ) )
+			if( unlockLayerButtons[row].Update( mouse ) )
 			{
-				lockLayers[i] = false;
+				layer.locked = false;
 				return( true );
 			}
 		}
 	}
-	return( false );
+	return( changed );
 }
 
 void LayerManager::Draw( Graphics& gfx ) const
@@ -158,45 +269,76 @@ void LayerManager::Draw( Graphics& gfx ) const
 	gfx.DrawRect( drawArea.left,drawArea.top,
 		drawArea.GetWidth(),drawArea.GetHeight(),
 		Colors::DarkGray );
-	
-	for( int i = 0; i < int( layers.size() ); ++i )
+
+	for( int row = 0; row < GetVisibleRows(); ++row )
 	{
-		const int layerHeight = buttonSize.y + padding.y;
-		if( lockLayers[i] )
+		const int pos = scroll + row;
+		if( pos >= GetLayerCount() ) break;
+		const auto& layer = LayerAt( pos );
+
+		if( layer.locked )
 		{
 			gfx.DrawRect( drawArea.left,drawArea.top +
-				( layerHeight * i ) + 3,drawArea.GetWidth(),
-				layerHeight + padding.y - 6,Colors::Gray );
+				( rowHeight * row ) + 3,drawArea.GetWidth(),
+				rowHeight + padding.y - 6,Colors::Gray );
 		}
-		else if( i == selectedLayer )
+		else if( pos == selectedLayer )
 		{
 			gfx.DrawRect( drawArea.left,drawArea.top +
-				( layerHeight * i ) + 3,drawArea.GetWidth(),
-				layerHeight + padding.y - 6,Colors::White );
+				( rowHeight * row ) + 3,drawArea.GetWidth(),
+				rowHeight + padding.y - 6,Colors::White );
 		}
 
-		layerButtons[i].Draw( gfx );
+		layerButtons[row].Draw( gfx );
 
-		if( !hiddenLayers[i] ) hideLayerButtons[i].Draw( gfx );
-		else unhideLayerButtons[i].Draw( gfx );
+		// Opacity bar under the layer button.
+		const auto barPos = layerButtons[row].GetPos() +
+			Vei2{ 3,buttonSize.y + 1 };
+		const int barWidth = layerButtonWidth - 6;
+		gfx.DrawRect( barPos.x,barPos.y,barWidth,2,Colors::Black );
+		gfx.DrawRect( barPos.x,barPos.y,
+			barWidth * layer.opacity / 255,2,Colors::LightGray );
 
-		if( !lockLayers[i] ) lockLayerButtons[i].Draw( gfx );
-		else unlockLayerButtons[i].Draw( gfx );
+		// Colored tag for anything that isn't a plain normal blend.
+		if( layer.mode != BlendMode::Normal )
+		{
+			Color tagCol = Colors::Cyan;
+			switch( layer.mode )
+			{
+			case BlendMode::Multiply: tagCol = Colors::Red; break;
+			case BlendMode::Screen: tagCol = Colors::Yellow; break;
+			case BlendMode::Add: tagCol = Colors::Green; break;
+			default: break;
+			}
+			gfx.DrawRect( layerButtons[row].GetPos().x + layerButtonWidth + 1,
+				layerButtons[row].GetPos().y + 3,3,buttonSize.y - 6,tagCol );
+		}
 
-		const float ratio = float( layers[i].GetWidth() ) /
-			float( layers[i].GetHeight() );
-		float width = ratio * float( 18 );
-		float height = 18;
-		if( width > 25 * 3 )
+		if( !layer.hidden ) hideLayerButtons[row].Draw( gfx );
+		else unhideLayerButtons[row].Draw( gfx );
+
+		if( !layer.locked ) lockLayerButtons[row].Draw( gfx );
+		else unlockLayerButtons[row].Draw( gfx );
+
+		const auto& thumb = thumbnails.Get( order[pos] );
+		if( thumb.GetWidth() > 0 && thumb.GetHeight() > 0 )
 		{
-			width = 25 * 3;
-			height = width / ratio;
+			gfx.DrawSprite( layerButtons[row].GetPos().x + 3,
+				layerButtons[row].GetPos().y + 3,thumb,
+				SpriteEffect::Copy{} );
 		}
+	}
 
-		gfx.DrawSprite( layerButtons[i].GetPos().x + 3,
-			layerButtons[i].GetPos().y + 3,layers[i]
-			.GetInterpolatedTo( int( width ),int( height ) ),
-			SpriteEffect::Copy{} );
+	// Scroll bar along the right edge once the rows don't all fit.
+	if( GetLayerCount() > GetVisibleRows() )
+	{
+		const int trackTop = drawArea.top + padding.y;
+		const int trackHeight = rowHeight * GetVisibleRows() - padding.y;
+		const int trackX = drawArea.right - padding.x - 2;
+		gfx.DrawRect( trackX,trackTop,2,trackHeight,Colors::Gray );
+		gfx.DrawRect( trackX,trackTop + trackHeight * scroll / GetLayerCount(),
+			2,std::max( 2,trackHeight * GetVisibleRows() / GetLayerCount() ),
+			Colors::LightGray );
 	}
 
 	addLayer.Draw( gfx );
@@ -210,65 +352,526 @@ void LayerManager::Draw( Graphics& gfx ) const
 }
 
 void LayerManager::ResizeCanvas( const Vei2& newSize )
+{
+	if( newSize == canvSize ) return;
+	EndEdit();
+
+	// Only layers with something past the new edges need their pixels
+	//  kept for undo, the rest just get resized back.  Other frames keep
+	//  one copy per cel.
+	const auto losesPixels = [&newSize]( const Surface& surf )
+	{
+		const auto rect = surf.GetNonMagentaRect();
+		return( rect.right != -1 &&
+			( rect.right >= newSize.x || rect.bottom >= newSize.y ) );
+	};
+	std::vector<Surface> pixels;
+	std::vector<History::Restore> restore;
+	std::unordered_map<int,int> kept;
+	for( int i = 0; i < GetLayerCount(); ++i )
+	{
+		Surface scratch = { 0,0 };
+		const auto& surf = GetLayerPixels( i,scratch );
+		if( !losesPixels( surf ) ) continue;
+		restore.emplace_back( History::Restore{ frames[curFrame].id,i,
+			int( pixels.size() ) } );
+		pixels.emplace_back( surf );
+	}
+	for( int i = 0; i < GetFrameCount(); ++i )
+	{
+		if( i == curFrame ) continue;
+		for( int j = 0; j < int( frames[i].layers.size() ); ++j )
+		{
+			const int cel = frames[i].layers[j].cel;
+			if( !losesPixels( cels.Get( cel ) ) ) continue;
+			auto it = kept.find( cel );
+			if( it == kept.end() )
+			{
+				it = kept.emplace( cel,int( pixels.size() ) ).first;
+				pixels.emplace_back( cels.Get( cel ) );
+			}
+			restore.emplace_back( History::Restore{ frames[i].id,j,it->second } );
+		}
+	}
+
+	const Vei2 oldSize = canvSize;
+	ResizeFrames( newSize,{},{} );
+	history.PushResize( oldSize,newSize,pixels,std::move( restore ) );
+}
+
+void LayerManager::ResizeFrames( const Vei2& newSize,
+	const std::vector<Surface>& pixels,
+	const std::vector<History::Restore>& restore )
 {
 	canvSize = newSize;
+	const auto restored = [&]( int frame,int pos ) -> const Surface*
+	{
+		for( const auto& r : restore )
+		{
+			if( r.frame == frames[frame].id && r.pos == pos )
+			{
+				return( &pixels[r.pixels] );
+			}
+		}
+		return( nullptr );
+	};
 
-	for( auto& layer : layers )
+	for( int i = 0; i < GetLayerCount(); ++i )
 	{
-		// Surface temp = layer;
-		// layer = Surface{ newSize.x,newSize.y };
-		// layer.CopyInto( temp );
-		layer.Resize( newSize );
+		auto& layer = LayerAt( i );
+		// Packed ones get resized without a write.
+		layer.cel = -1;
+		if( const Surface* surf = restored( curFrame,i ) )
+		{
+			Unpack( i );
+			layer.surf = *surf;
+		}
+		else if( layer.surf.GetWidth() > 0 ) layer.surf.Resize( newSize );
+		else
+		{
+			layer.packed.Resize( newSize );
+			Surface scratch = { 0,0 };
+			layer.histogram.Rebuild( GetLayerPixels( i,scratch ) );
+		}
 	}
+	// So the current frame's cels are the new size too.
+	StoreFrame();
+
+	// Cels shared between frames only get resized once.
+	std::unordered_map<int,int> resized;
+	for( int i = 0; i < GetFrameCount(); ++i )
+	{
+		if( i == curFrame ) continue;
+		for( int j = 0; j < int( frames[i].layers.size() ); ++j )
+		{
+			auto& layer = frames[i].layers[j];
+			int id = -1;
+			if( const Surface* surf = restored( i,j ) ) id = cels.Add( *surf );
+			else
+			{
+				const auto it = resized.find( layer.cel );
+				if( it != resized.end() )
+				{
+					id = it->second;
+					cels.AddRef( id );
+				}
+				else
+				{
+					Surface surf = cels.Get( layer.cel );
+					surf.Resize( newSize );
+					id = cels.Add( surf );
+					resized.emplace( layer.cel,id );
+				}
+			}
+			cels.Release( layer.cel );
+			layer.cel = id;
+		}
+	}
+	thumbnails.InvalidateAll();
 }
 
-void LayerManager::CreateNewLayer( Surface& art )
+void LayerManager::CreateNewLayer( const Surface& content,DitherMode dither )
 {
-	if( layers.size() < 7 )
+	assert( content.GetSize() == canvSize );
+	EndEdit();
+
+	Layer layer = { content };
+	// Imports and pastes get mapped onto the table right away.
+	if( indexed )
 	{
-		// const auto oldSelectedLayer = selectedLayer;
-		// layers.emplace_back( Surface{ canvSize.x,canvSize.y } );
-		// layers.back().DrawRect( 0,0,canvSize.x,canvSize.y,Colors::Magenta );
-		// art.CopyInto( layers.back() );
+		// Quantize only if it has more colors than the table has room for,
+		//  pixel art usually fits as is.
+		ColorTable trial = colorTable;
+		IndexedSurface{ content,trial };
+		if( trial.GetCount() == ColorTable::maxColors )
+		{
+			for( const auto c : Quantize::MakePalette( content,
+				ColorTable::maxColors - colorTable.GetCount() ) )
+			{
+				colorTable.GetIndex( c );
+			}
+			ColorLookup{ colorTable }.Remap( content,dither )
+				.Expand( layer.surf,colorTable );
+		}
+		else IndexedSurface{ content,colorTable }.Expand( layer.surf,colorTable );
+	}
+	InsertLayer( selectedLayer,std::move( layer ) );
+	history.PushLayers( {},{ SaveLayer( selectedLayer ) } );
+	ScrollToSelected();
+	SyncStorage();
+}
 
-		// selectedLayer = 0;
+bool LayerManager::Undo()
+{
+	EndEdit();
+
+	History::Change change;
+	if( !history.Undo( change ) ) return( false );
+	ApplyChange( change );
+	SyncStorage();
+	return( true );
+}
+
+bool LayerManager::Redo()
+{
+	EndEdit();
+
+	History::Change change;
+	if( !history.Redo( change ) ) return( false );
+	ApplyChange( change );
+	SyncStorage();
+	return( true );
+}
+
+History& LayerManager::GetHistory()
+{
+	return( history );
+}
 
-		// std::swap( layers[selectedLayer],layers[oldSelectedLayer] );
-		// selectedLayer = oldSelectedLayer;
+Surface& LayerManager::GetActiveSurface()
+{
+	return( LayerAt( selectedLayer ).surf );
+}
+
+const Surface& LayerManager::GetActiveSurface() const
+{
+	return( LayerAt( selectedLayer ).surf );
+}
 
-		layers.insert( layers.begin() + selectedLayer,
-			Surface{ canvSize.x,canvSize.y, } );
-		art.CopyInto( layers[selectedLayer] );
+int LayerManager::GetLayerCount() const
+{
+	return( int( order.size() ) );
+}
+
+const LayerManager::Layer& LayerManager::GetLayer( int pos ) const
+{
+	return( LayerAt( pos ) );
+}
+
+const Surface& LayerManager::GetLayerPixels( int pos,Surface& scratch ) const
+{
+	const auto& layer = LayerAt( pos );
+	if( layer.surf.GetWidth() > 0 ) return( layer.surf );
+
+	layer.packed.Expand( scratch,colorTable );
+	return( scratch );
+}
+
+bool LayerManager::IsIndexed() const
+{
+	return( indexed );
+}
+
+void LayerManager::SetIndexed( bool indexed )
+{
+	if( indexed == this->indexed ) return;
+	this->indexed = indexed;
+	if( indexed )
+	{
+		// Run the selected layer through the table too, so what's on
+		//  screen is what gets packed later.
+		auto& active = LayerAt( selectedLayer ).surf;
+		IndexedSurface{ active,colorTable }.Expand( active,colorTable );
 	}
+	SyncStorage();
+	thumbnails.InvalidateAll();
 }
 
-const std::vector<Surface>& LayerManager::GetLayers() const
+const ColorTable& LayerManager::GetColorTable() const
 {
-	return( layers );
+	return( colorTable );
 }
 
-const std::vector<bool>& LayerManager::GetHiddenLayers() const
+void LayerManager::SetColorTable( const ColorTable& table )
 {
-	return( hiddenLayers );
+	assert( !indexed );
+	colorTable = table;
 }
 
-const std::vector<bool>& LayerManager::GetLockedLayers() const
+void LayerManager::SetTableColor( unsigned char index,Color c )
 {
-	return( lockLayers );
+	if( !indexed )
+	{
+		colorTable.SetColor( index,c );
+		return;
+	}
+
+	// Packed layers pick it up when they're expanded, only the selected
+	//  one holds actual colors so it has to go through the table.
+	auto& active = LayerAt( selectedLayer );
+	EndEdit();
+	Pack( selectedLayer );
+	const Color old = colorTable.GetColor( index );
+	bool shared = false;
+	for( int i = 1; i < colorTable.GetCount(); ++i )
+	{
+		if( i != index && colorTable.GetColor( i ) == old ) shared = true;
+	}
+	colorTable.SetColor( index,c );
+	// Counts can just be moved over unless another index shows the old
+	//  color too, then only a recount can tell them apart.
+	for( int i = 0; i < GetLayerCount(); ++i )
+	{
+		auto& layer = LayerAt( i );
+		// Packed ones change without a write, their cels don't match.
+		if( layer.histogram.GetCount( old ) > 0 ) layer.cel = -1;
+		if( !shared ) layer.histogram.Recolor( old,c );
+		else
+		{
+			Surface scratch = { 0,0 };
+			layer.histogram.Rebuild( GetLayerPixels( i,scratch ) );
+		}
+	}
+	Unpack( selectedLayer );
+	// Other frames only have cels, they get recolored copies.
+	for( int i = 0; i < GetFrameCount(); ++i )
+	{
+		for( auto& layer : frames[i].layers )
+		{
+			if( i == curFrame ||
+				cels.GetHistogram( layer.cel ).GetCount( old ) == 0 )
+			{
+				continue;
+			}
+
+			Surface recolored = cels.Get( layer.cel );
+			std::vector<Surface::Span> rows;
+			for( int y = 0; y < recolored.GetHeight(); ++y )
+			{
+				rows.emplace_back( Surface::Span{ y,0,recolored.GetWidth() } );
+			}
+			recolored.ReplaceColor( rows,old,c,0 );
+			ColorHistogram counts = cels.GetHistogram( layer.cel );
+			counts.Recolor( old,c );
+			const int id = cels.Add( recolored,&counts );
+			cels.Release( layer.cel );
+			layer.cel = id;
+		}
+	}
+	thumbnails.InvalidateAll();
+	// Not worth an undo step, setting the color back undoes it.
+	active.surf.ClearDirty();
+}
+
+bool LayerManager::ReplaceColor( Color from,Color to,int tolerance,
+	const SelectionMask& mask,bool allLayers )
+{
+	assert( mask.GetSize() == canvSize );
+	EndEdit();
+	// Write what packing would turn it into anyway, so the tiles saved
+	//  before packing are what the layers end up holding.
+	if( indexed ) to = colorTable.GetColor( colorTable.GetIndex( to ) );
+	std::vector<Surface::Span> spans;
+	mask.GetSpans( mask.GetBounds(),spans );
+
+	// Counts say which layers have anything to replace without looking
+	//  at their pixels, packed ones included.
+	const auto hasMatch = [&]( const ColorHistogram& histogram )
+	{
+		for( const auto& count : histogram.GetCounts() )
+		{
+			const Color c = Color{ count.first };
+			if( c != to && Blend::IsNear( c,from,tolerance ) ) return( true );
+		}
+		return( false );
+	};
+
+	// Only the tiles under the spans get kept, and only the ones that
+	//  actually changed.
+	bool changed = false;
+	history.BeginGroup();
+	for( int i = 0; i < GetLayerCount() && !spans.empty(); ++i )
+	{
+		auto& layer = LayerAt( i );
+		if( ( !allLayers && i != selectedLayer ) || layer.locked ||
+			!hasMatch( layer.histogram ) )
+		{
+			continue;
+		}
+
+		Unpack( i );
+		for( const auto& span : spans )
+		{
+			history.Touch( layer.surf,i,
+				RectI{ span.left,span.right,span.y,span.y + 1 } );
+		}
+		if( layer.surf.ReplaceColor( spans,from,to,tolerance ) > 0 )
+		{
+			changed = true;
+			thumbnails.Invalidate( order[i] );
+		}
+		history.EndEdit( layer.surf );
+	}
+	history.EndGroup();
+	SyncStorage();
+	return( changed );
+}
+
+std::vector<std::pair<Color,int>> LayerManager::GetColorUsage() const
+{
+	std::unordered_map<unsigned int,int> total;
+	const auto addCounts = [&total]( const ColorHistogram& histogram )
+	{
+		for( const auto& count : histogram.GetCounts() )
+		{
+			total[count.first] += count.second;
+		}
+	};
+	for( const auto& layer : layers ) addCounts( layer.second.histogram );
+	// Other frames count their cels once per layer using them.
+	for( int i = 0; i < GetFrameCount(); ++i )
+	{
+		if( i == curFrame ) continue;
+		for( const auto& layer : frames[i].layers )
+		{
+			addCounts( cels.GetHistogram( layer.cel ) );
+		}
+	}
+	total.erase( Colors::Magenta.dword );
+
+	std::vector<std::pair<Color,int>> usage;
+	usage.reserve( total.size() );
+	for( const auto& count : total )
+	{
+		usage.emplace_back( Color{ count.first },count.second );
+	}
+	std::sort( usage.begin(),usage.end(),[]( const auto& a,const auto& b )
+	{
+		return( a.second != b.second ? a.second > b.second
+			: a.first.dword < b.first.dword );
+	} );
+	return( usage );
+}
+
+unsigned int LayerManager::GetUsageVersion() const
+{
+	// Ids never get reused so adding or removing a layer changes this too.
+	unsigned int version = 0u;
+	for( const int id : order )
+	{
+		version = version * 31u + unsigned( id );
+		version = version * 31u + layers.at( id ).histogram.GetVersion();
+	}
+	// Same for cel ids, other frames only change by getting new ones.
+	for( int i = 0; i < GetFrameCount(); ++i )
+	{
+		if( i == curFrame ) continue;
+		version = version * 31u + unsigned( i );
+		for( const auto& layer : frames[i].layers )
+		{
+			version = version * 31u + unsigned( layer.cel );
+		}
+	}
+	return( version );
+}
+
+int LayerManager::GetFrameCount() const
+{
+	return( int( frames.size() ) );
+}
+
+int LayerManager::GetCurFrame() const
+{
+	return( curFrame );
+}
+
+void LayerManager::SelectFrame( int frame )
+{
+	assert( frame >= 0 && frame < GetFrameCount() );
+	if( frame == curFrame ) return;
+
+	StoreFrame();
+	curFrame = frame;
+	LoadFrame();
+}
+
+void LayerManager::DuplicateFrame()
+{
+	StoreFrame();
+	Frame copy;
+	copy.id = nextFrameId++;
+	copy.layers = frames[curFrame].layers;
+	for( const auto& layer : copy.layers ) cels.AddRef( layer.cel );
+	copy.duration = frames[curFrame].duration;
+	frames.insert( frames.begin() + curFrame + 1,std::move( copy ) );
+	++curFrame;
+	LoadFrame();
+}
+
+void LayerManager::DeleteFrame()
+{
+	if( GetFrameCount() == 1 ) return;
+
+	EndEdit();
+	history.Forget( frames[curFrame].id );
+	for( const auto& layer : frames[curFrame].layers ) cels.Release( layer.cel );
+	frames.erase( frames.begin() + curFrame );
+	curFrame = std::min( curFrame,GetFrameCount() - 1 );
+	LoadFrame();
+}
+
+float LayerManager::GetFrameDuration( int frame ) const
+{
+	return( frames[frame].duration );
+}
+
+void LayerManager::SetFrameDuration( int frame,float seconds )
+{
+	assert( seconds > 0.0f );
+	frames[frame].duration = seconds;
+}
+
+const CelStore& LayerManager::GetCels() const
+{
+	return( cels );
+}
+
+const std::vector<LayerManager::FrameLayer>& LayerManager::GetFrameLayers( int frame ) const
+{
+	return( frames[frame].layers );
+}
+
+Surface LayerManager::ComposeFrame( int frame ) const
+{
+	const auto& layers = frames[frame].layers;
+	Surface composite = { canvSize.x,canvSize.y };
+	// Top to bottom, so go backwards like the canvas does.
+	for( int i = int( layers.size() ) - 1; i >= 0; --i )
+	{
+		const auto& layer = layers[i];
+		if( layer.hidden ) continue;
+
+		const auto& cel = cels.Get( layer.cel );
+		assert( cel.GetSize() == canvSize );
+		composite.BlendInto( cel,layer.mode,layer.opacity );
+	}
+	return( composite );
+}
+
+bool LayerManager::LooksSame( const std::vector<FrameLayer>& a,
+	const std::vector<FrameLayer>& b )
+{
+	return( std::equal( a.begin(),a.end(),b.begin(),b.end(),
+		[]( const FrameLayer& l,const FrameLayer& r )
+		{
+			return( l.cel == r.cel && l.opacity == r.opacity &&
+				l.mode == r.mode && l.hidden == r.hidden );
+		} ) );
 }
 
 bool LayerManager::IsSelectedLayerLocked() const
 {
-	return( lockLayers[selectedLayer] );
+	return( LayerAt( selectedLayer ).locked );
 }
 
 int LayerManager::GetSelectedLayer() const
 {
-	for( int i = 0; i < int( layers.size() ); ++i )
+	for( int row = 0; row < GetVisibleRows(); ++row )
 	{
-		if( layerButtons[i].IsHovering() )
+		if( scroll + row < GetLayerCount() &&
+			layerButtons[row].IsHovering() )
 		{
-			return( i );
+			return( scroll + row );
 		}
 	}
 	return( -1 );
@@ -279,3 +882,274 @@ int LayerManager::GetActualSelectedLayer() const
 	return( selectedLayer );
 }
 
+void LayerManager::AdjustOpacity( int layer,int steps )
+{
+	auto& opacity = LayerAt( layer ).opacity;
+	const int newOpacity = int( opacity ) + steps * opacityStep;
+	typedef unsigned char uchar;
+	opacity = uchar( std::max( 0,std::min( 255,newOpacity ) ) );
+}
+
+void LayerManager::Scroll( int rows )
+{
+	const int maxScroll = std::max( 0,GetLayerCount() - GetVisibleRows() );
+	scroll = std::max( 0,std::min( maxScroll,scroll + rows ) );
+}
+
+bool LayerManager::ContainsPoint( const Vei2& pos ) const
+{
+	return( drawArea.ContainsPoint( pos ) );
+}
+
+LayerManager::Layer& LayerManager::LayerAt( int pos )
+{
+	assert( pos >= 0 && pos < GetLayerCount() );
+	return( layers.at( order[pos] ) );
+}
+
+const LayerManager::Layer& LayerManager::LayerAt( int pos ) const
+{
+	assert( pos >= 0 && pos < GetLayerCount() );
+	return( layers.at( order[pos] ) );
+}
+
+void LayerManager::InsertLayer( int pos,Layer&& layer,bool counted )
+{
+	assert( pos >= 0 && pos <= GetLayerCount() );
+	const int id = nextLayerId++;
+	auto& inserted = layers.emplace( id,std::move( layer ) ).first->second;
+	// Layers never move once they're in the map, safe to point at.
+	inserted.surf.SetHistogram( &inserted.histogram,counted );
+	// Moving it in restarted surf's version, LoadFrame says which cel it
+	//  matches after this.
+	inserted.cel = -1;
+	order.insert( order.begin() + pos,id );
+	thumbnails.Add( id );
+}
+
+void LayerManager::EraseLayer( int pos )
+{
+	const int id = order[pos];
+	order.erase( order.begin() + pos );
+	layers.erase( id );
+	thumbnails.Remove( id );
+}
+
+void LayerManager::MoveLayer( int from,int to )
+{
+	const int id = order[from];
+	order.erase( order.begin() + from );
+	order.insert( order.begin() + to,id );
+}
+
+void LayerManager::EndEdit()
+{
+	history.EndEdit( LayerAt( selectedLayer ).surf );
+}
+
+History::LayerState LayerManager::SaveLayer( int pos ) const
+{
+	const auto& layer = LayerAt( pos );
+	Surface scratch = { 0,0 };
+	return( History::LayerState{ pos,GetLayerPixels( pos,scratch ),
+		layer.opacity,layer.mode,layer.histogram } );
+}
+
+void LayerManager::ApplyChange( const History::Change& change )
+{
+	// Resizes are for every frame, other steps go back to the frame they
+	//  were made on first.
+	if( change.frame != History::allFrames )
+	{
+		const int frame = FindFrame( change.frame );
+		if( frame != curFrame ) SelectFrame( frame );
+	}
+	if( change.resize != Vei2{ 0,0 } )
+	{
+		ResizeFrames( change.resize,change.pixels,change.restore );
+	}
+
+	for( const auto& tile : change.tiles )
+	{
+		// SyncStorage packs it again if it has to be.
+		Unpack( tile.layer );
+		LayerAt( tile.layer ).surf.CopyIntoPos( tile.pixels,tile.pos );
+		thumbnails.Invalidate( order[tile.layer] );
+	}
+
+	// Follow the moved layer so undoing a reorder keeps it selected.
+	if( change.moveFrom != -1 )
+	{
+		MoveLayer( change.moveFrom,change.moveTo );
+		selectedLayer = change.moveTo;
+	}
+
+	for( const int pos : change.remove ) EraseLayer( pos );
+	for( const auto& state : change.insert )
+	{
+		Layer layer = { state.surf };
+		layer.opacity = state.opacity;
+		layer.mode = state.mode;
+		layer.histogram = state.histogram;
+		InsertLayer( state.pos,std::move( layer ),true );
+	}
+
+	if( change.moveFrom != -1 ||
+		!change.remove.empty() || !change.insert.empty() )
+	{
+		canvSize = GetLayerSize( 0 );
+		selectedLayer = std::max( 0,std::min( GetLayerCount() - 1,
+			selectedLayer ) );
+		ScrollToSelected();
+	}
+}
+
+void LayerManager::ScrollToSelected()
+{
+	if( selectedLayer < scroll ) scroll = selectedLayer;
+	else if( selectedLayer >= scroll + GetVisibleRows() )
+	{
+		scroll = selectedLayer - GetVisibleRows() + 1;
+	}
+	Scroll( 0 );
+}
+
+int LayerManager::GetVisibleRows() const
+{
+	return( int( layerButtons.size() ) );
+}
+
+bool LayerManager::IsBusy() const
+{
+	return( thumbnails.IsBusy() );
+}
+
+void LayerManager::UpdateThumbnails()
+{
+	// Thumbnails only get made for rows you can see, packed layers only
+	//  get expanded for the ones that are about to be rebuilt.
+	std::vector<std::pair<int,const Surface*>> visible;
+	const int lastRow = std::min( GetLayerCount(),scroll + GetVisibleRows() );
+	thumbSources.resize( std::max( 0,lastRow - scroll ),Surface{ 0,0 } );
+	for( int i = scroll; i < lastRow; ++i )
+	{
+		const auto& layer = LayerAt( i );
+		const Surface* src = &layer.surf;
+		if( layer.surf.GetWidth() == 0 && thumbnails.NeedsSource( order[i] ) )
+		{
+			src = &GetLayerPixels( i,thumbSources[i - scroll] );
+		}
+		visible.emplace_back( order[i],src );
+	}
+	thumbnails.Update( visible );
+}
+
+void LayerManager::Pack( int pos )
+{
+	auto& layer = LayerAt( pos );
+	if( layer.surf.GetWidth() == 0 ) return;
+
+	layer.packed = IndexedSurface{ layer.surf,colorTable };
+	// The cel only still matches if nothing got written and the table had
+	//  room for every color.
+	if( layer.surf.GetVersion() != layer.celVersion ) layer.cel = -1;
+	for( const auto& count : layer.histogram.GetCounts() )
+	{
+		if( layer.cel == -1 ) break;
+		const Color c = Color{ count.first };
+		if( colorTable.GetColor( colorTable.GetIndex( c ) ) != c ) layer.cel = -1;
+	}
+	// Counts stay put while packed.
+	layer.surf.SetHistogram( nullptr );
+	layer.surf = Surface{ 0,0 };
+}
+
+void LayerManager::Unpack( int pos )
+{
+	auto& layer = LayerAt( pos );
+	if( layer.surf.GetWidth() > 0 ) return;
+
+	layer.packed.Expand( layer.surf,colorTable );
+	layer.packed = IndexedSurface{ 0,0 };
+	layer.surf.SetHistogram( &layer.histogram,true );
+	// Expanding is a write, but it's still the cel's pixels.
+	layer.celVersion = layer.surf.GetVersion();
+}
+
+void LayerManager::SyncStorage()
+{
+	for( int i = 0; i < GetLayerCount(); ++i )
+	{
+		if( indexed && i != selectedLayer ) Pack( i );
+		else Unpack( i );
+	}
+}
+
+Vei2 LayerManager::GetLayerSize( int pos ) const
+{
+	const auto& layer = LayerAt( pos );
+	return( layer.surf.GetWidth() > 0
+		? layer.surf.GetSize() : layer.packed.GetSize() );
+}
+
+void LayerManager::StoreFrame()
+{
+	EndEdit();
+	auto& frame = frames[curFrame];
+	std::vector<FrameLayer> stored;
+	Surface scratch = { 0,0 };
+	for( int i = 0; i < GetLayerCount(); ++i )
+	{
+		auto& layer = LayerAt( i );
+		// Nothing written since it was loaded, its cel still matches and
+		//  the pixels don't need hashing again.
+		if( layer.cel != -1 && ( layer.surf.GetWidth() == 0 ||
+			layer.surf.GetVersion() == layer.celVersion ) )
+		{
+			cels.AddRef( layer.cel );
+		}
+		else
+		{
+			layer.cel = cels.Add( GetLayerPixels( i,scratch ),&layer.histogram );
+			layer.celVersion = layer.surf.GetVersion();
+		}
+		stored.emplace_back( FrameLayer{ layer.cel,
+			layer.opacity,layer.mode,layer.hidden,layer.locked } );
+	}
+	// Released after adding so cels that didn't change never hit 0 refs.
+	for( const auto& layer : frame.layers ) cels.Release( layer.cel );
+	frame.layers = std::move( stored );
+}
+
+int LayerManager::FindFrame( int id ) const
+{
+	const auto it = std::find_if( frames.begin(),frames.end(),
+		[id]( const Frame& frame ) { return( frame.id == id ); } );
+	assert( it != frames.end() );
+	return( int( it - frames.begin() ) );
+}
+
+void LayerManager::LoadFrame()
+{
+	while( GetLayerCount() > 0 ) EraseLayer( GetLayerCount() - 1 );
+
+	auto& frame = frames[curFrame];
+	for( int i = 0; i < int( frame.layers.size() ); ++i )
+	{
+		const auto& stored = frame.layers[i];
+		Layer layer = { cels.Get( stored.cel ) };
+		layer.histogram = cels.GetHistogram( stored.cel );
+		layer.opacity = stored.opacity;
+		layer.mode = stored.mode;
+		layer.hidden = stored.hidden;
+		layer.locked = stored.locked;
+		InsertLayer( i,std::move( layer ),true );
+		auto& loaded = LayerAt( i );
+		loaded.cel = stored.cel;
+		loaded.celVersion = loaded.surf.GetVersion();
+	}
+	history.SetFrame( frame.id );
+	selectedLayer = std::min( selectedLayer,GetLayerCount() - 1 );
+	ScrollToSelected();
+	SyncStorage();
+}
\ No newline at end of file
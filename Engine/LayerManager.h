@@ -5,42 +5,210 @@
 #include "Mouse.h"
 #include "Graphics.h"
 #include "Button.h"
+#include "ThumbnailCache.h"
+#include "History.h"
+#include "IndexedSurface.h"
+#include "ColorLookup.h"
+#include "ColorHistogram.h"
+#include "SelectionMask.h"
+#include "CelStore.h"
+#include <unordered_map>
+#include <utility>
 
 class LayerManager
 {
+public:
+	struct Layer
+	{
+		Layer( Surface surf )
+			:
+			surf( std::move( surf ) )
+		{}
+
+		Surface surf;
+		// In indexed documents every layer but the selected one keeps its
+		//  pixels here instead and surf is left empty.
+		IndexedSurface packed = { 0,0 };
+		unsigned char opacity = 255; // 255 = opaque.
+		BlendMode mode = BlendMode::Normal;
+		bool hidden = false;
+		bool locked = false;
+		// Pixels of each color, surf keeps it current while it's attached.
+		//  Packed layers keep the counts from when they got packed.
+		ColorHistogram histogram;
+		// Cel in the current frame holding these pixels and surf's version
+		//  when they matched, -1 once they might not.
+		int cel = -1;
+		unsigned int celVersion = 0u;
+	};
+	// What a frame keeps of a layer while another frame is being edited.
+	struct FrameLayer
+	{
+		int cel;
+		unsigned char opacity;
+		BlendMode mode;
+		bool hidden;
+		bool locked;
+	};
+	struct Frame
+	{
+		// Top to bottom.  The current frame's are from the last time it
+		//  was stored, its layers hold what it looks like now.
+		std::vector<FrameLayer> layers;
+		// Seconds it stays up for.
+		float duration = 0.1f;
+		// Stays the same when frames around it come and go, history tags
+		//  its steps with it.
+		int id = 0;
+	};
 public:
 	LayerManager( const RectI& clipArea,const Vei2& canvSize );
 
-	bool Update( const Keyboard& kbd,const Mouse& mouse,Surface& art );
+	// Returns true if the stack or the selected layer changed.
+	bool Update( const Keyboard& kbd,const Mouse& mouse );
 	void Draw( Graphics& gfx ) const;
 
+	// Every frame changes size with it, one undo step puts them all back.
 	void ResizeCanvas( const Vei2& newSize );
-	// Creates a new layer above the current one and copies art into it.
-	void CreateNewLayer( Surface& art );
+	// Creates a new layer above the current one holding content.  Indexed
+	//  documents map it onto the table, dithered if it needs quantizing.
+	void CreateNewLayer( const Surface& content,
+		DitherMode dither = DitherMode::None );
+	// Step back or forward through history, returns false if there was
+	//  nothing to do.
+	bool Undo();
+	bool Redo();
+	History& GetHistory();
+	// The selected layer's own pixels, tools draw into this directly.
+	//  Only good until the stack changes.
+	Surface& GetActiveSurface();
+	const Surface& GetActiveSurface() const;
+
+	// Layers are by position in the stack, 0 is the top one.
+	int GetLayerCount() const;
+	// Settings only, pixels might be packed so go through GetLayerPixels.
+	const Layer& GetLayer( int pos ) const;
+	// Layer's colors, expanded into scratch if the layer is packed.
+	const Surface& GetLayerPixels( int pos,Surface& scratch ) const;
+
+	// Indexed documents keep 8 bits per pixel and share one color table,
+	//  only the selected layer stays expanded for tools to draw into.
+	bool IsIndexed() const;
+	void SetIndexed( bool indexed );
+	const ColorTable& GetColorTable() const;
+	// Replaces the table, only while the document isn't indexed.
+	void SetColorTable( const ColorTable& table );
+	// Recolors every pixel using index, without touching the pixels.
+	void SetTableColor( unsigned char index,Color c );
 
-	const std::vector<Surface>& GetLayers() const;
-	const std::vector<bool>& GetHiddenLayers() const;
-	const std::vector<bool>& GetLockedLayers() const;
+	// Sets pixels near from to to inside mask, see Blend::IsNear, on the
+	//  selected layer or on every unlocked one.  One undo step covers all
+	//  the layers that changed, returns false if none did.
+	bool ReplaceColor( Color from,Color to,int tolerance,
+		const SelectionMask& mask,bool allLayers );
+
+	// Animation frames, each with its own layer stack.  Only the current
+	//  one has layers, the rest keep cels.  Undo and redo go back to the
+	//  frame a step was made on.
+	int GetFrameCount() const;
+	int GetCurFrame() const;
+	void SelectFrame( int frame );
+	// Adds a copy of the current frame after it and selects it, the two
+	//  share every cel until one of them gets edited.
+	void DuplicateFrame();
+	// Deletes the current frame unless it's the only one.
+	void DeleteFrame();
+	float GetFrameDuration( int frame ) const;
+	void SetFrameDuration( int frame,float seconds );
+	// Every other frame's cels, the current one's as of when it was last
+	//  stored.
+	const CelStore& GetCels() const;
+	// Ids into GetCels, stale for the current frame.
+	const std::vector<FrameLayer>& GetFrameLayers( int frame ) const;
+	// Premultiplied composite of a frame's stored cels at canvas size.
+	Surface ComposeFrame( int frame ) const;
+	// Stored cels never change, so the same ids with the same settings
+	//  look the same.
+	static bool LooksSame( const std::vector<FrameLayer>& a,
+		const std::vector<FrameLayer>& b );
+
+	// Pixels of each color over every layer of every frame, most used
+	//  first and chroma left out.  Costs the number of colors, not pixels.
+	std::vector<std::pair<Color,int>> GetColorUsage() const;
+	// Changes whenever GetColorUsage might have.
+	unsigned int GetUsageVersion() const;
 	bool IsSelectedLayerLocked() const;
 	// Returns layer you're hovering.
 	int GetSelectedLayer() const;
 	int GetActualSelectedLayer() const;
+	// Nudge layer's opacity up or down by steps of opacityStep.
+	void AdjustOpacity( int layer,int steps );
+	// Scroll the layer list by rows, positive goes down the stack.
+	void Scroll( int rows );
+	bool ContainsPoint( const Vei2& pos ) const;
+	// True while thumbnails are still catching up.
+	bool IsBusy() const;
+private:
+	// Buttons and shortcuts that change the stack.
+	bool UpdateStack( const Keyboard& kbd,const Mouse& mouse );
+	void UpdateThumbnails();
+	Layer& LayerAt( int pos );
+	const Layer& LayerAt( int pos ) const;
+	// Only the id goes into the order list, pixels never move.  counted
+	//  says layer's histogram already matches its pixels.
+	void InsertLayer( int pos,Layer&& layer,bool counted = false );
+	void EraseLayer( int pos );
+	void MoveLayer( int from,int to );
+	// Closes the edit history has open on the selected layer.
+	void EndEdit();
+	History::LayerState SaveLayer( int pos ) const;
+	void ApplyChange( const History::Change& change );
+	// Scrolls just far enough to show the selected layer's row.
+	void ScrollToSelected();
+	int GetVisibleRows() const;
+	// Moves pixels between surf and packed.
+	void Pack( int pos );
+	void Unpack( int pos );
+	// Packs or unpacks whatever doesn't match the mode and selection,
+	//  call after anything that can change either.
+	void SyncStorage();
+	Vei2 GetLayerSize( int pos ) const;
+	// Resizes every layer of every frame, giving the ones in restore
+	//  their pixels back instead, see History::Change.
+	void ResizeFrames( const Vei2& newSize,const std::vector<Surface>& pixels,
+		const std::vector<History::Restore>& restore );
+	// Turns the layers into cels for the current frame and back.
+	void StoreFrame();
+	void LoadFrame();
+	// Position of the frame with id.
+	int FindFrame( int id ) const;
 private:
 	Vei2 canvSize;
 	static constexpr Vei2 padding = { 5,5 };
 	static constexpr Vei2 buttonSize = { 8 * 3,8 * 3 };
+	static constexpr int layerButtonWidth = 27 * 3;
+	static constexpr int rowHeight = buttonSize.y + padding.y;
+
+	// Layers by id, order holds the ids from top to bottom.
+	std::unordered_map<int,Layer> layers;
+	std::vector<int> order;
+	int nextLayerId = 0;
+	static constexpr int opacityStep = 25;
+	ThumbnailCache thumbnails;
+	History history;
+	int selectedLayer = 0;
+	// Position of the layer shown in the top row.
+	int scroll = 0;
+
+	const RectI drawArea;
 
-	std::vector<Surface> layers;
+	// One of each per visible row, they show whichever layer is scrolled
+	//  into their row.
 	std::vector<Button> layerButtons;
 	std::vector<Button> hideLayerButtons;
 	std::vector<Button> unhideLayerButtons;
-	std::vector<bool> hiddenLayers; // true = hidden.
 	std::vector<Button> lockLayerButtons;
 	std::vector<Button> unlockLayerButtons;
-	std::vector<bool> lockLayers; // true = locked.
-	int selectedLayer = 0;
-
-	const RectI drawArea;
 
 	Button addLayer = Button{ Surface{ Surface{ "Icons/AddLayerButton.bmp" },Vei2{ 3,3 } },
 		Vei2{ drawArea.left + padding.x,
@@ -61,4 +229,17 @@ private:
 	bool canDupeLayer = false;
 	bool canDeleteLayer = false;
 	bool canMergeLayer = false;
+	bool canMoveLayer = false;
+	bool canCycleBlendMode = false;
+	bool canToggleIndexed = false;
+
+	bool indexed = false;
+	ColorTable colorTable;
+	// Expanded copies of packed layers their thumbnails get made from.
+	std::vector<Surface> thumbSources;
+
+	CelStore cels;
+	std::vector<Frame> frames = std::vector<Frame>( 1 );
+	int curFrame = 0;
+	int nextFrameId = 1;
 };
\ No newline at end of file
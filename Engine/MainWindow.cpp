@@ -99,6 +99,28 @@ bool MainWindow::ProcessMessage()
 	return true;
 }
 
+void MainWindow::WaitForMessage( unsigned int timeout ) const
+{
+	MsgWaitForMultipleObjects( 0,nullptr,FALSE,timeout,QS_ALLINPUT );
+}
+
+void MainWindow::Wake()
+{
+	PostMessage( hWnd,WM_NULL,0,0 );
+}
+
+bool MainWindow::ConsumeInput()
+{
+	const bool hadInput = gotInput;
+	gotInput = false;
+	return hadInput;
+}
+
+void MainWindow::SetTitle( const std::wstring& title )
+{
+	SetWindowText( hWnd,title.c_str() );
+}
+
 void MainWindow::HideCursor( bool hidden )
 {
 	hidingCursor = hidden;
@@ -139,6 +161,14 @@ LRESULT WINAPI MainWindow::_HandleMsgThunk( HWND hWnd,UINT msg,WPARAM wParam,LPA
 
 LRESULT MainWindow::HandleMsg( HWND hWnd,UINT msg,WPARAM wParam,LPARAM lParam )
 {
+	// anything that could change what's on screen wakes the game up
+	if( ( msg >= WM_KEYFIRST && msg <= WM_KEYLAST ) ||
+		( msg >= WM_MOUSEFIRST && msg <= WM_MOUSELAST ) ||
+		msg == WM_PAINT || msg == WM_ACTIVATE || msg == WM_KILLFOCUS )
+	{
+		gotInput = true;
+	}
+
 	switch( msg )
 	{
 	case WM_DESTROY:
@@ -24,12 +24,14 @@
 #include "Keyboard.h"
 #include "Mouse.h"
 #include "ChiliException.h"
+#include "CursorControl.h"
+#include "Wakeup.h"
 #include <string>
 
-// for granting special access to hWnd only for Graphics constructor
+// for granting special access to hWnd only for D3DBackend constructor
 class HWNDKey
 {
-	friend Graphics::Graphics( HWNDKey& );
+	friend class D3DBackend;
 public:
 	HWNDKey( const HWNDKey& ) = delete;
 	HWNDKey& operator=( HWNDKey& ) = delete;
@@ -39,7 +41,7 @@ protected:
 	HWND hWnd = nullptr;
 };
 
-class MainWindow : public HWNDKey
+class MainWindow : public HWNDKey,public CursorControl,public Wakeup
 {
 public:
 	class Exception : public ChiliException
@@ -63,11 +65,18 @@ public:
 	}
 	// returns false if quitting
 	bool ProcessMessage();
+	// sleeps until a message arrives or timeout (ms) runs out
+	void WaitForMessage( unsigned int timeout ) const;
+	// true if input or a repaint came in since the last call
+	bool ConsumeInput();
+	void SetTitle( const std::wstring& title );
 	const std::wstring& GetArgs() const
 	{
 		return args;
 	}
-	void HideCursor( bool hidden );
+	void HideCursor( bool hidden ) override;
+	// Posts a message so WaitForMessage returns.
+	void Wake() override;
 private:
 	static LRESULT WINAPI _HandleMsgSetup( HWND hWnd,UINT msg,WPARAM wParam,LPARAM lParam );
 	static LRESULT WINAPI _HandleMsgThunk( HWND hWnd,UINT msg,WPARAM wParam,LPARAM lParam );
@@ -76,8 +85,9 @@ public:
 	Keyboard kbd;
 	Mouse mouse;
 private:
-	static constexpr wchar_t* wndClassName = L"Chili DirectX Framework Window";
+	static constexpr const wchar_t* wndClassName = L"Chili DirectX Framework Window";
 	HINSTANCE hInst = nullptr;
 	std::wstring args;
 	bool hidingCursor = true;
+	bool gotInput = true;
 };
\ No newline at end of file
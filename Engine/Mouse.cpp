@@ -19,6 +19,7 @@
  *	along with The Chili DirectX Framework.  If not, see <http://www.gnu.org/licenses/>.  *
  ******************************************************************************************/
 #include "Mouse.h"
+#include "InputRecording.h"
 
 
 Vei2 Mouse::GetPos() const
@@ -53,90 +54,92 @@ bool Mouse::IsInWindow() const
 
 Mouse::Event Mouse::Read()
 {
-	if( buffer.size() > 0u )
-	{
-		Mouse::Event e = buffer.front();
-		buffer.pop();
-		return e;
-	}
-	else
-	{
-		return Mouse::Event();
-	}
+	Mouse::Event e;
+	buffer.Pop( e );
+	return e;
+}
+
+size_t Mouse::ReadAll( std::vector<Event>& events )
+{
+	return buffer.PopAll( events );
 }
 
 void Mouse::Flush()
 {
-	buffer = std::queue<Event>();
+	buffer.Clear();
+}
+
+unsigned int Mouse::GetDroppedCount() const
+{
+	return buffer.GetDroppedCount();
+}
+
+void Mouse::SetRecording( InputRecording* recording )
+{
+	this->recording = recording;
 }
 
 void Mouse::OnMouseLeave()
 {
+	if( recording ) recording->Add( InputRecording::Type::MouseLeave,0,0,0 );
 	isInWindow = false;
 }
 
 void Mouse::OnMouseEnter()
 {
+	if( recording ) recording->Add( InputRecording::Type::MouseEnter,0,0,0 );
 	isInWindow = true;
 }
 
 void Mouse::OnMouseMove( int newx,int newy )
 {
+	if( recording ) recording->Add( InputRecording::Type::MouseMove,newx,newy,0 );
 	x = newx;
 	y = newy;
 
-	buffer.push( Mouse::Event( Mouse::Event::Type::Move,*this ) );
-	TrimBuffer();
+	buffer.Push( Mouse::Event( Mouse::Event::Type::Move,*this ) );
 }
 
 void Mouse::OnLeftPressed( int x,int y )
 {
+	if( recording ) recording->Add( InputRecording::Type::LPress,x,y,0 );
 	leftIsPressed = true;
 
-	buffer.push( Mouse::Event( Mouse::Event::Type::LPress,*this ) );
-	TrimBuffer();
+	buffer.Push( Mouse::Event( Mouse::Event::Type::LPress,*this ) );
 }
 
 void Mouse::OnLeftReleased( int x,int y )
 {
+	if( recording ) recording->Add( InputRecording::Type::LRelease,x,y,0 );
 	leftIsPressed = false;
 
-	buffer.push( Mouse::Event( Mouse::Event::Type::LRelease,*this ) );
-	TrimBuffer();
+	buffer.Push( Mouse::Event( Mouse::Event::Type::LRelease,*this ) );
 }
 
 void Mouse::OnRightPressed( int x,int y )
 {
+	if( recording ) recording->Add( InputRecording::Type::RPress,x,y,0 );
 	rightIsPressed = true;
 
-	buffer.push( Mouse::Event( Mouse::Event::Type::RPress,*this ) );
-	TrimBuffer();
+	buffer.Push( Mouse::Event( Mouse::Event::Type::RPress,*this ) );
 }
 
 void Mouse::OnRightReleased( int x,int y )
 {
+	if( recording ) recording->Add( InputRecording::Type::RRelease,x,y,0 );
 	rightIsPressed = false;
 
-	buffer.push( Mouse::Event( Mouse::Event::Type::RRelease,*this ) );
-	TrimBuffer();
+	buffer.Push( Mouse::Event( Mouse::Event::Type::RRelease,*this ) );
 }
 
 void Mouse::OnWheelUp( int x,int y )
 {
-	buffer.push( Mouse::Event( Mouse::Event::Type::WheelUp,*this ) );
-	TrimBuffer();
+	if( recording ) recording->Add( InputRecording::Type::WheelUp,x,y,0 );
+	buffer.Push( Mouse::Event( Mouse::Event::Type::WheelUp,*this ) );
 }
 
 void Mouse::OnWheelDown( int x,int y )
 {
-	buffer.push( Mouse::Event( Mouse::Event::Type::WheelDown,*this ) );
-	TrimBuffer();
-}
-
-void Mouse::TrimBuffer()
-{
-	while( buffer.size() > bufferSize )
-	{
-		buffer.pop();
-	}
+	if( recording ) recording->Add( InputRecording::Type::WheelDown,x,y,0 );
+	buffer.Push( Mouse::Event( Mouse::Event::Type::WheelDown,*this ) );
 }
\ No newline at end of file
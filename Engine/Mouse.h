@@ -19,16 +19,22 @@
  *	along with The Chili DirectX Framework.  If not, see <http://www.gnu.org/licenses/>.  *
  ******************************************************************************************/
 #pragma once
-#include <queue>
+#include <vector>
+#include <chrono>
 #include "Vec2.h"
+#include "InputRing.h"
+
+class InputRecording;
 
 class Mouse
 {
 	friend class MainWindow;
+	friend class InputRecording;
 public:
 	class Event
 	{
 	public:
+		typedef std::chrono::steady_clock::time_point Time;
 		enum class Type
 		{
 			LPress,
@@ -46,6 +52,7 @@ public:
 		bool rightIsPressed;
 		int x;
 		int y;
+		Time time;
 	public:
 		Event()
 			:
@@ -53,7 +60,8 @@ public:
 			leftIsPressed( false ),
 			rightIsPressed( false ),
 			x( 0 ),
-			y( 0 )
+			y( 0 ),
+			time()
 		{}
 		Event( Type type,const Mouse& parent )
 			:
@@ -61,7 +69,8 @@ public:
 			leftIsPressed( parent.leftIsPressed ),
 			rightIsPressed( parent.rightIsPressed ),
 			x( parent.x ),
-			y( parent.y )
+			y( parent.y ),
+			time( std::chrono::steady_clock::now() )
 		{}
 		bool IsValid() const
 		{
@@ -91,6 +100,11 @@ public:
 		{
 			return rightIsPressed;
 		}
+		// When the event came in, not when it got read.
+		Time GetTime() const
+		{
+			return time;
+		}
 	};
 public:
 	Mouse() = default;
@@ -103,11 +117,17 @@ public:
 	bool RightIsPressed() const;
 	bool IsInWindow() const;
 	Mouse::Event Read();
+	// Appends every queued event to events, returns how many.
+	size_t ReadAll( std::vector<Event>& events );
 	bool IsEmpty() const
 	{
-		return buffer.empty();
+		return buffer.IsEmpty();
 	}
 	void Flush();
+	// Events thrown away because the buffer was full.
+	unsigned int GetDroppedCount() const;
+	// Everything coming in also gets added to recording, nullptr stops.
+	void SetRecording( InputRecording* recording );
 private:
 	void OnMouseMove( int x,int y );
 	void OnMouseLeave();
@@ -118,13 +138,15 @@ private:
 	void OnRightReleased( int x,int y );
 	void OnWheelUp( int x,int y );
 	void OnWheelDown( int x,int y );
-	void TrimBuffer();
 private:
-	static constexpr unsigned int bufferSize = 4u;
+	// Over a second of moves from a 1000hz mouse, so even a slow frame
+	//  doesn't lose stroke points.
+	static constexpr size_t bufferSize = 2048u;
 	int x;
 	int y;
 	bool leftIsPressed = false;
 	bool rightIsPressed = false;
 	bool isInWindow = false;
-	std::queue<Event> buffer;
+	InputRing<Event,bufferSize> buffer;
+	InputRecording* recording = nullptr;
 };
\ No newline at end of file
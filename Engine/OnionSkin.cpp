@@ -0,0 +1,110 @@
+#include "OnionSkin.h"
+#include <algorithm>
+#include <utility>
+
+void OnionSkin::SetRange( int range )
+{
+	if( range == this->range ) return;
+	this->range = std::max( 0,range );
+	// Positions mean different distances now.
+	neighbours.clear();
+	size = { 0,0 };
+}
+
+int OnionSkin::GetRange() const
+{
+	return( range );
+}
+
+void OnionSkin::Update( const LayerManager& layers,const Vei2& size )
+{
+	if( range == 0 ) return;
+
+	const bool resized = size != this->size;
+	this->size = size;
+
+	auto old = std::move( neighbours );
+	neighbours.clear();
+	neighbours.resize( range * 2 );
+	bool changed = resized || old.size() != neighbours.size();
+	for( int i = 0; i < range * 2; ++i )
+	{
+		const bool prev = i < range;
+		const int dist = prev ? i + 1 : i - range + 1;
+		const int frame = layers.GetCurFrame() + ( prev ? -dist : dist );
+		auto& n = neighbours[i];
+		if( frame < 0 || frame >= layers.GetFrameCount() )
+		{
+			changed = changed || i >= int( old.size() ) || !old[i].layers.empty();
+			continue;
+		}
+
+		const auto& frameLayers = layers.GetFrameLayers( frame );
+		if( !resized && i < int( old.size() ) && old[i].tinted.GetWidth() > 0 &&
+			LayerManager::LooksSame( old[i].layers,frameLayers ) )
+		{
+			n = std::move( old[i] );
+			continue;
+		}
+
+		// Usually the frame was just somewhere else in the range.
+		n.layers = frameLayers;
+		const auto reuse = std::find_if( old.begin(),old.end(),
+			[&]( const Neighbour& o )
+			{
+				return( o.plain.GetWidth() > 0 && LayerManager::LooksSame( o.layers,frameLayers ) );
+			} );
+		if( !resized && reuse != old.end() ) n.plain = reuse->plain;
+		else n.plain = layers.ComposeFrame( frame );
+		n.tinted = Tint( n.plain,prev ? prevTint : nextTint,
+			static_cast< unsigned char >( nearFade / dist ) );
+		changed = true;
+	}
+	if( !changed ) return;
+
+	// Closest first so further frames end up under them.
+	combined = Surface{ size.x,size.y };
+	empty = true;
+	for( int dist = 1; dist <= range; ++dist )
+	{
+		for( const int i : { dist - 1,range + dist - 1 } )
+		{
+			if( neighbours[i].tinted.GetWidth() == 0 ) continue;
+			combined.BlendUnder( neighbours[i].tinted );
+			empty = false;
+		}
+	}
+}
+
+void OnionSkin::DrawUnder( Surface& art ) const
+{
+	if( range == 0 || empty ) return;
+	art.BlendUnder( combined );
+}
+
+Surface OnionSkin::Tint( const Surface& plain,Color tint,unsigned char fade )
+{
+	const auto scale = [fade]( int x )
+	{
+		x = x * fade + 128;
+		return( static_cast< unsigned char >( ( x + ( x >> 8 ) ) >> 8 ) );
+	};
+	const auto& pixels = plain.GetRawPixelData();
+	std::vector<Color> tinted( pixels.size() );
+	for( int i = 0; i < int( pixels.size() ); ++i )
+	{
+		const Color c = pixels[i];
+		const int a = c.GetA();
+		// tint * a keeps it premultiplied.
+		const auto mix = [a]( int own,int towards )
+		{
+			return( ( own + ( towards * a + 127 ) / 255 ) / 2 );
+		};
+		tinted[i] = Color{ scale( a ),scale( mix( c.GetR(),tint.GetR() ) ),
+			scale( mix( c.GetG(),tint.GetG() ) ),
+			scale( mix( c.GetB(),tint.GetB() ) ) };
+	}
+	Surface surf = { plain.GetWidth(),plain.GetHeight() };
+	surf.CopyFrom( tinted.data() );
+	return( surf );
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "LayerManager.h"
+#include "Surface.h"
+#include <vector>
+
+// Frames around the current one, tinted and faded, to draw under it
+//  while animating.  Each neighbour is only recomposed when its cels
+//  change, the rest of the time drawing is one blend per pixel no
+//  matter how many frames are showing.
+class OnionSkin
+{
+public:
+	// Frames shown on each side, 0 turns it off.
+	void SetRange( int range );
+	int GetRange() const;
+	// Catches the cache up with the frames around the current one, size
+	//  is the canvas.
+	void Update( const LayerManager& layers,const Vei2& size );
+	// Puts the neighbours under art, which is premultiplied.
+	void DrawUnder( Surface& art ) const;
+private:
+	struct Neighbour
+	{
+		// What the surfaces were made from, empty if there's no frame there.
+		std::vector<LayerManager::FrameLayer> layers;
+		// Kept so stepping through frames only tints the ones that move
+		//  over instead of composing them again.
+		Surface plain = { 0,0 };
+		Surface tinted = { 0,0 };
+	};
+	// Premultiplied pixels pulled halfway to tint then faded.
+	static Surface Tint( const Surface& plain,Color tint,unsigned char fade );
+private:
+	static constexpr Color prevTint = Colors::MakeRGB( 255u,64u,64u );
+	static constexpr Color nextTint = Colors::MakeRGB( 64u,160u,255u );
+	// Alpha of the closest frames, further ones divide it by how far away
+	//  they are.
+	static constexpr int nearFade = 160;
+	int range = 0;
+	// Previous frames then next ones, closest first on each side.
+	std::vector<Neighbour> neighbours;
+	Vei2 size = { 0,0 };
+	// Every neighbour, nearest on top.
+	Surface combined = { 0,0 };
+	bool empty = true;
+};
\ No newline at end of file
@@ -1,4 +1,74 @@
 #include "Palette.h"
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+#include <unordered_set>
+
+namespace
+{
+	// GIMP palette, a header then "r g b name" a line.
+	std::vector<Color> ReadGpl( std::istream& file )
+	{
+		std::vector<Color> colors;
+		std::string line;
+		std::getline( file,line );
+		if( line.compare( 0,12,"GIMP Palette" ) != 0 ) return( colors );
+
+		while( std::getline( file,line ) )
+		{
+			std::istringstream fields( line );
+			int r,g,b;
+			// Name:, Columns: and # comments all fail to read as numbers.
+			if( fields >> r >> g >> b )
+			{
+				colors.emplace_back( Color{ static_cast<unsigned char>( r ),
+					static_cast<unsigned char>( g ),static_cast<unsigned char>( b ) } );
+			}
+		}
+		return( colors );
+	}
+
+	// JASC-PAL, version and count lines then "r g b" a line.
+	std::vector<Color> ReadJascPal( std::istream& file )
+	{
+		std::vector<Color> colors;
+		std::string magic;
+		std::string version;
+		int count = 0;
+		if( !( file >> magic >> version >> count ) || magic != "JASC-PAL" )
+		{
+			return( colors );
+		}
+
+		int r,g,b;
+		while( int( colors.size() ) < count && file >> r >> g >> b )
+		{
+			colors.emplace_back( Color{ static_cast<unsigned char>( r ),
+				static_cast<unsigned char>( g ),static_cast<unsigned char>( b ) } );
+		}
+		return( colors );
+	}
+
+	// One rrggbb a line, # in front is fine.
+	std::vector<Color> ReadHex( std::istream& file )
+	{
+		std::vector<Color> colors;
+		std::string line;
+		while( file >> line )
+		{
+			if( line[0] == '#' ) line.erase( 0,1 );
+			if( line.size() != 6 ||
+				line.find_first_not_of( "0123456789abcdefABCDEF" ) != std::string::npos )
+			{
+				continue;
+			}
+			colors.emplace_back( Color{ static_cast<unsigned int>(
+				std::stoul( line,nullptr,16 ) ) } );
+		}
+		return( colors );
+	}
+}
 
 Palette::Palette( int nColors )
 	:
@@ -9,18 +79,13 @@ Palette::Palette( const std::vector<Color>& colors )
 {
 	swatches.reserve( colors.size() + 1 );
 
-	Vei2 sPos = Vei2( area.left,area.top );
-	for( const auto& col : colors )
+	// Rows of nColumns, GetSwatchAt depends on this layout.
+	for( int i = 0; i < int( colors.size() ); ++i )
 	{
-		swatches.emplace_back( Swatch{ col,RectI{ sPos,
+		const auto sPos = Vei2{ area.left + ( i % nColumns ) * swatchStep,
+			area.top + ( i / nColumns ) * swatchStep };
+		swatches.emplace_back( Swatch{ colors[i],RectI{ sPos,
 			swatchSize,swatchSize } } );
-
-		sPos.x += swatchSize + swatchPadding;
-		if( sPos.x > area.right )
-		{
-			sPos.x = area.left;
-			sPos.y += swatchSize + swatchPadding;
-		}
 	}
 }
 
@@ -31,27 +96,25 @@ Palette::Palette( const std::string& path )
 
 void Palette::Update( const Mouse& mouse )
 {
-	for( Swatch& sw : swatches )
+	hovered = GetSwatchAt( mouse.GetPos() );
+	if( hovered != -1 )
 	{
-		sw.selected = false;
-		if( sw.area.ContainsPoint( mouse.GetPos() ) )
-		{
-			sw.selected = true;
-
-			if( mouse.LeftIsPressed() ) mainColor = sw.col;
-			if( mouse.RightIsPressed() ) offColor = sw.col;
-		}
+		if( mouse.LeftIsPressed() ) mainColor = swatches[hovered].col;
+		if( mouse.RightIsPressed() ) offColor = swatches[hovered].col;
 	}
 }
 
 void Palette::Draw( Graphics& gfx ) const
 {
-	Vei2 drawPos = Vei2( area.left,area.top );
-	for( const Swatch& sw : swatches )
+	// Rows past the bottom of the area wouldn't be seen anyway.
+	const int nVisible = std::min( int( swatches.size() ),
+		( ( area.bottom - area.top - swatchSize ) / swatchStep + 1 ) * nColumns );
+	for( int i = 0; i < nVisible; ++i )
 	{
+		const auto& sw = swatches[i];
 		const auto swRect = sw.area;
 
-		if( sw.selected )
+		if( i == hovered )
 		{
 			const auto bigger = swRect.GetExpanded( swatchPadding / 2 );
 			gfx.DrawRect( bigger.left,bigger.top,
@@ -94,15 +157,51 @@ std::vector<Color> Palette::GetRandColors( int nColors ) const
 
 std::vector<Color> Palette::GetPalColors( const std::string& path ) const
 {
-	Surface temp = path;
-	const auto& data = temp.GetRawPixelData();
+	auto ext = path.substr( path.find_last_of( '.' ) + 1 );
+	std::transform( ext.begin(),ext.end(),ext.begin(),
+		[]( unsigned char c ) { return( char( std::tolower( c ) ) ); } );
+	std::vector<Color> found;
+	if( ext == "gpl" || ext == "pal" || ext == "hex" )
+	{
+		std::ifstream file( path );
+		// Picked by hand, so it might not be there.
+		if( !file ) return( std::vector<Color>{} );
+		found = ext == "gpl" ? ReadGpl( file )
+			: ext == "pal" ? ReadJascPal( file ) : ReadHex( file );
+	}
+	else found = Surface{ path }.GetRawPixelData();
+
+	// Keep the first of each color, in the order they came in.
 	std::vector<Color> colors;
-	colors.reserve( data.size() + 1 );
+	std::unordered_set<unsigned int> seen;
+	for( const Color c : found )
+	{
+		if( seen.insert( c.dword ).second ) colors.emplace_back( c );
+	}
+	return( colors );
+}
 
-	for( const Color c : data )
+int Palette::GetSwatchAt( const Vei2& pos ) const
+{
+	const auto rel = pos - Vei2{ area.left,area.top };
+	if( rel.x < 0 || rel.y < 0 ) return( -1 );
+
+	const int col = rel.x / swatchStep;
+	const int row = rel.y / swatchStep;
+	// Padding between swatches doesn't count.
+	if( col >= nColumns || rel.x % swatchStep >= swatchSize ||
+		rel.y % swatchStep >= swatchSize )
 	{
-		colors.emplace_back( c );
+		return( -1 );
 	}
 
-	return( colors );
+	const int index = row * nColumns + col;
+	return( index < int( swatches.size() ) ? index : -1 );
 }
+
+std::vector<Color> Palette::GetColors() const
+{
+	std::vector<Color> colors;
+	for( const Swatch& sw : swatches ) colors.emplace_back( sw.col );
+	return( colors );
+}
\ No newline at end of file
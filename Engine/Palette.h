@@ -21,14 +21,14 @@ private:
 	public:
 		Color col;
 		RectI area;
-		bool selected = false;
 	};
 public:
 	// Initializes with random colors.
 	Palette( int nColors );
 	// Initialize with specific list of colors.
 	Palette( const std::vector<Color>& colors );
-	// Initialize with palette image.
+	// Initialize with palette image or a .gpl, JASC .pal or .hex file,
+	//  repeated colors only show up once.
 	Palette( const std::string& path );
 
 	void Update( const Mouse& mouse );
@@ -36,14 +36,23 @@ public:
 
 	Color& GetMainCol();
 	Color& GetOffCol();
+	// Swatch colors in order.
+	std::vector<Color> GetColors() const;
 private:
 	std::vector<Color> GetRandColors( int nColors ) const;
+	// Empty if a text palette can't be opened.
 	std::vector<Color> GetPalColors( const std::string& path ) const;
+	// Swatch under pos or -1, straight from the grid so it doesn't matter
+	//  how many there are.
+	int GetSwatchAt( const Vei2& pos ) const;
 private:
 	RectI area = { 4,66,50,Graphics::ScreenHeight - 4 };
 	static constexpr int swatchSize = 18;
 	static constexpr int swatchPadding = 4;
+	static constexpr int swatchStep = swatchSize + swatchPadding;
+	const int nColumns = ( area.right - area.left ) / swatchStep + 1;
 	std::vector<Swatch> swatches;
+	int hovered = -1;
 	Color mainColor = Colors::Black;
 	Color offColor = Colors::White;
 };
\ No newline at end of file
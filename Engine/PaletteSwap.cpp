@@ -0,0 +1,203 @@
+#include "PaletteSwap.h"
+#include "WriteToBitmap.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+namespace
+{
+	// rrggbb or #rrggbb, false for anything else.
+	bool ReadColor( std::string word,Color& c )
+	{
+		if( !word.empty() && word[0] == '#' ) word.erase( 0,1 );
+		if( word.size() != 6 ||
+			word.find_first_not_of( "0123456789abcdefABCDEF" ) != std::string::npos )
+		{
+			return( false );
+		}
+		c = Color{ static_cast<unsigned int>( std::stoul( word,nullptr,16 ) ) };
+		return( true );
+	}
+}
+
+PaletteSwap::PaletteSwap( const std::vector<Color>& source,
+	const std::vector<std::vector<Color>>& variants )
+{
+	Build( source,variants );
+}
+
+PaletteSwap::PaletteSwap( const std::string& path )
+{
+	std::ifstream file( path );
+	assert( file );
+
+	std::vector<std::vector<Color>> lines;
+	std::string line;
+	while( std::getline( file,line ) )
+	{
+		std::istringstream words( line );
+		std::vector<Color> colors;
+		std::string word;
+		Color c;
+		while( words >> word && ReadColor( word,c ) ) colors.emplace_back( c );
+		if( !colors.empty() ) lines.emplace_back( std::move( colors ) );
+	}
+
+	// Lines missing a variant keep their color in it.
+	size_t nVariants = 0u;
+	for( const auto& colors : lines ) nVariants = std::max( nVariants,colors.size() - 1 );
+	std::vector<Color> source;
+	std::vector<std::vector<Color>> variants( nVariants );
+	for( const auto& colors : lines )
+	{
+		source.emplace_back( colors[0] );
+		for( size_t i = 0; i < nVariants; ++i )
+		{
+			variants[i].emplace_back( i + 1 < colors.size() ? colors[i + 1] : colors[0] );
+		}
+	}
+	Build( source,variants );
+}
+
+int PaletteSwap::GetVariantCount() const
+{
+	return( nVariants );
+}
+
+std::vector<Surface> PaletteSwap::Apply( const Surface& src ) const
+{
+	const auto& pixels = src.GetRawPixelData();
+	std::vector<std::vector<Color>> out( nVariants,
+		std::vector<Color>( pixels.size() ) );
+
+	// Sprites are mostly runs, only look up when the color changes.
+	Color last = pixels.empty() ? Color{} : pixels[0];
+	int row = pixels.empty() ? -1 : Find( last );
+	for( size_t i = 0; i < pixels.size(); ++i )
+	{
+		const Color c = pixels[i];
+		if( c != last )
+		{
+			last = c;
+			row = Find( c );
+		}
+
+		if( row == -1 )
+		{
+			for( auto& variant : out ) variant[i] = c;
+		}
+		else
+		{
+			const Color* with = replacements.data() + size_t( row ) * nVariants;
+			for( int v = 0; v < nVariants; ++v ) out[v][i] = with[v];
+		}
+	}
+
+	std::vector<Surface> variants;
+	variants.reserve( nVariants );
+	for( const auto& variant : out )
+	{
+		variants.emplace_back( src.GetWidth(),src.GetHeight() );
+		variants.back().CopyFrom( variant.data() );
+	}
+	return( variants );
+}
+
+int PaletteSwap::ApplyToFolder( const std::string& inDir,
+	const std::string& outDir ) const
+{
+	namespace fs = std::filesystem;
+	std::vector<fs::path> files;
+	for( const auto& entry : fs::directory_iterator( inDir ) )
+	{
+		auto ext = entry.path().extension().string();
+		std::transform( ext.begin(),ext.end(),ext.begin(),
+			[]( unsigned char c ) { return( char( std::tolower( c ) ) ); } );
+		if( entry.is_regular_file() && ext == ".bmp" ) files.emplace_back( entry.path() );
+	}
+	fs::create_directories( outDir );
+
+	// Files are independent, workers just take the next one.
+	std::atomic<size_t> next{ 0u };
+	const auto work = [&]()
+	{
+		for( size_t i = next++; i < files.size(); i = next++ )
+		{
+			const auto variants = Apply( Surface{ files[i].string() } );
+			const auto outPath = ( fs::path( outDir ) / files[i].filename() ).string();
+			for( int v = 0; v < nVariants; ++v )
+			{
+				WriteToBitmap::Write( variants[v],GetVariantPath( outPath,v ) );
+			}
+		}
+	};
+	const int nWorkers = std::max( 1,std::min( int( std::thread::hardware_concurrency() ),
+		int( files.size() ) ) );
+	std::vector<std::thread> workers;
+	for( int i = 1; i < nWorkers; ++i ) workers.emplace_back( work );
+	work();
+	for( auto& worker : workers ) worker.join();
+
+	return( int( files.size() ) );
+}
+
+std::string PaletteSwap::GetVariantPath( const std::string& path,int variant )
+{
+	const auto slash = path.find_last_of( "/\\" );
+	auto dot = path.find_last_of( '.' );
+	if( dot == std::string::npos || ( slash != std::string::npos && dot < slash ) )
+	{
+		dot = path.length();
+	}
+	return( path.substr( 0,dot ) + "_" + std::to_string( variant + 1 ) +
+		path.substr( dot ) );
+}
+
+void PaletteSwap::Build( const std::vector<Color>& source,
+	const std::vector<std::vector<Color>>& variants )
+{
+	nVariants = int( variants.size() );
+	unsigned int nSlots = 1u;
+	while( nSlots < source.size() * 2u ) nSlots *= 2u;
+	slotMask = nSlots - 1u;
+	keys.assign( nSlots,Color{} );
+	rows.assign( nSlots,-1 );
+
+	int nRows = 0;
+	for( size_t i = 0; i < source.size(); ++i )
+	{
+		// First mapping of a color wins.
+		if( Find( source[i] ) != -1 ) continue;
+
+		unsigned int slot = Hash( source[i] ) & slotMask;
+		while( rows[slot] != -1 ) slot = ( slot + 1u ) & slotMask;
+		keys[slot] = source[i];
+		rows[slot] = nRows++;
+		for( const auto& variant : variants )
+		{
+			replacements.emplace_back( i < variant.size() ? variant[i] : source[i] );
+		}
+	}
+}
+
+int PaletteSwap::Find( Color c ) const
+{
+	for( unsigned int slot = Hash( c ) & slotMask; rows[slot] != -1;
+		slot = ( slot + 1u ) & slotMask )
+	{
+		if( keys[slot] == c ) return( rows[slot] );
+	}
+	return( -1 );
+}
+
+unsigned int PaletteSwap::Hash( Color c )
+{
+	// Fibonacci hashing, the top bits are the well mixed ones.
+	const unsigned int h = c.dword * 2654435769u;
+	return( h ^ ( h >> 16 ) );
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "Surface.h"
+#include "Colors.h"
+#include <string>
+#include <vector>
+
+// Recolors images into several variants in one pass.  Every mapped source
+//  color has a replacement per variant, colors that aren't mapped come
+//  through the same in all of them.
+class PaletteSwap
+{
+public:
+	// variants[i][j] replaces source[j] in variant i, short variants leave
+	//  the colors they're missing alone.
+	PaletteSwap( const std::vector<Color>& source,
+		const std::vector<std::vector<Color>>& variants );
+	// Text file with a line per source color, the color followed by its
+	//  replacement in each variant, all as rrggbb with an optional #.
+	//  Lines that don't start with a color are skipped.
+	PaletteSwap( const std::string& path );
+
+	int GetVariantCount() const;
+	// Variant i of src at i, src's pixels only get read once.
+	std::vector<Surface> Apply( const Surface& src ) const;
+	// Writes every variant of every .bmp in inDir to outDir as
+	//  name_1.bmp, name_2.bmp and so on, files are split across threads.
+	//  Returns how many files were done.
+	int ApplyToFolder( const std::string& inDir,const std::string& outDir ) const;
+	// Where Apply's variant goes when the original is saved at path.
+	static std::string GetVariantPath( const std::string& path,int variant );
+private:
+	void Build( const std::vector<Color>& source,
+		const std::vector<std::vector<Color>>& variants );
+	// Row of replacements for c, -1 if it isn't mapped.
+	int Find( Color c ) const;
+	static unsigned int Hash( Color c );
+private:
+	int nVariants = 0;
+	// Open addressing with linear probing, a power of two slots kept at
+	//  most half full so misses end quickly.
+	unsigned int slotMask = 0u;
+	std::vector<Color> keys;
+	// -1 for empty slots.
+	std::vector<int> rows;
+	// nVariants colors per mapped source color.
+	std::vector<Color> replacements;
+};
\ No newline at end of file
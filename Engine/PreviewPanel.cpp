@@ -0,0 +1,248 @@
+#include "PreviewPanel.h"
+#include "FrameTimer.h"
+#include <algorithm>
+#include <chrono>
+
+PreviewPanel::PreviewPanel( const RectI& area,Wakeup& wakeup )
+	:
+	area( area ),
+	wakeup( wakeup )
+{
+	player = std::thread{ &PreviewPanel::Play,this };
+}
+
+PreviewPanel::~PreviewPanel()
+{
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+		quitting = true;
+	}
+	wake.notify_one();
+	player.join();
+}
+
+void PreviewPanel::Update( const Mouse& mouse,const Keyboard& kbd,
+	const ImageHandler& imgHand )
+{
+	{
+		// This frame draws whatever the player is on.
+		std::lock_guard<std::mutex> lock( mutex );
+		newFrame = false;
+	}
+
+	const bool over = area.ContainsPoint( mouse.GetPos() );
+	if( over && mouse.LeftIsPressed() )
+	{
+		if( canToggle )
+		{
+			if( kbd.KeyIsPressed( VK_SHIFT ) ) stripMode = !stripMode;
+			else
+			{
+				std::lock_guard<std::mutex> lock( mutex );
+				playing = !playing;
+				// Once starts over when it's played out.
+				if( playing && anim != nullptr && anim->IsDone() ) anim->SetFrame( 0 );
+			}
+			wake.notify_one();
+		}
+		canToggle = false;
+	}
+	else canToggle = true;
+
+	if( over && mouse.RightIsPressed() )
+	{
+		if( canCycle )
+		{
+			std::lock_guard<std::mutex> lock( mutex );
+			playback = Anim::Playback( ( int( playback ) + 1 ) % 3 );
+			if( anim != nullptr ) anim->SetPlayback( playback );
+			wake.notify_one();
+		}
+		canCycle = false;
+	}
+	else canCycle = true;
+
+	const auto& composite = imgHand.GetComposite();
+	if( composite.GetWidth() == 0 ) return;
+
+	const Vei2 size = composite.GetSize();
+	const int nFrames = imgHand.GetFrameCount();
+	const bool useStrip = stripMode && imgHand.IsStrip();
+	const int nCells = useStrip ? size.x / size.y : nFrames;
+	const Vei2 source = useStrip ? Vei2{ size.y,size.y } : size;
+
+	// Whole multiples when growing so pixels stay square.
+	const auto view = GetViewArea();
+	Vei2 fitted = source;
+	if( source.x <= view.GetWidth() && source.y <= view.GetHeight() )
+	{
+		fitted = source * std::min( view.GetWidth() / source.x,
+			view.GetHeight() / source.y );
+	}
+	else
+	{
+		const float scale = std::min( float( view.GetWidth() ) / float( source.x ),
+			float( view.GetHeight() ) / float( source.y ) );
+		fitted = Vei2{ std::max( 1,int( float( source.x ) * scale ) ),
+			std::max( 1,int( float( source.y ) * scale ) ) };
+	}
+
+	std::vector<float> holds;
+	for( int i = 0; i < nCells; ++i )
+	{
+		holds.emplace_back( useStrip ? ImageHandler::stripHold : imgHand.GetFrameDuration( i ) );
+	}
+
+	const bool relayout = fitted != cellSize ||
+		nCells != int( cellValid.size() ) || useStrip != usingStrip;
+	if( relayout )
+	{
+		// Only drawn from this thread, the player just moves the frame.
+		strip = Surface{ fitted.x * nCells,fitted.y };
+		cellSize = fitted;
+		cellLayers.assign( nCells,{} );
+		cellValid.assign( nCells,false );
+		usingStrip = useStrip;
+	}
+	if( relayout || holds != holdTimes )
+	{
+		holdTimes = std::move( holds );
+		std::vector<RectI> frames;
+		for( int i = 0; i < nCells; ++i )
+		{
+			frames.emplace_back( i * fitted.x,( i + 1 ) * fitted.x,0,fitted.y );
+		}
+
+		std::lock_guard<std::mutex> lock( mutex );
+		const int frame = anim != nullptr
+			? std::min( anim->GetFrame(),nCells - 1 ) : 0;
+		anim = std::make_unique<Anim>( frames,holdTimes,strip,chroma );
+		anim->SetPlayback( playback );
+		anim->SetFrame( frame );
+		wake.notify_one();
+	}
+
+	const bool edited = composite.GetVersion() != compositeVersion;
+	compositeVersion = composite.GetVersion();
+	const int curFrame = imgHand.GetCurFrame();
+	if( useStrip )
+	{
+		if( edited || relayout )
+		{
+			for( int i = 0; i < nCells; ++i )
+			{
+				FitInto( composite,RectI{ i * size.y,( i + 1 ) * size.y,0,size.y },i );
+			}
+		}
+	}
+	else
+	{
+		for( int i = 0; i < nCells; ++i )
+		{
+			// The current frame's stored cels are behind, the canvas isn't.
+			if( i == curFrame )
+			{
+				if( edited || relayout || lastFrame != curFrame )
+				{
+					FitInto( composite,composite.GetRect(),i );
+				}
+				cellValid[i] = false;
+				continue;
+			}
+
+			const auto& layers = imgHand.GetFrameLayers( i );
+			if( cellValid[i] && LayerManager::LooksSame( cellLayers[i],layers ) )
+			{
+				continue;
+			}
+			cellLayers[i] = layers;
+			cellValid[i] = true;
+			const auto frame = imgHand.ComposeFrame( i );
+			FitInto( frame,frame.GetRect(),i );
+		}
+	}
+	lastFrame = curFrame;
+}
+
+void PreviewPanel::Draw( Graphics& gfx ) const
+{
+	gfx.DrawRect( area.left,area.top,area.GetWidth(),area.GetHeight(),
+		Colors::DarkGray );
+
+	static constexpr const char* names[] = { "LOOP","PONG","ONCE" };
+	std::lock_guard<std::mutex> lock( mutex );
+	luckyPixel.DrawText( names[int( playback )],
+		Vei2{ area.left + padding,area.top + padding },
+		playing ? Colors::White : Colors::Gray,gfx );
+	if( anim == nullptr ) return;
+
+	const auto view = GetViewArea();
+	anim->Draw( Vec2{ float( view.left + ( view.GetWidth() - cellSize.x ) / 2 ),
+		float( view.top + ( view.GetHeight() - cellSize.y ) / 2 ) },gfx );
+}
+
+bool PreviewPanel::HasNewFrame() const
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	return( newFrame );
+}
+
+bool PreviewPanel::IsShowingStrip() const
+{
+	return( usingStrip );
+}
+
+void PreviewPanel::Play()
+{
+	FrameTimer timer;
+	std::unique_lock<std::mutex> lock( mutex );
+	while( !quitting )
+	{
+		if( !playing || anim == nullptr || anim->GetFrameCount() < 2 ||
+			anim->IsDone() )
+		{
+			wake.wait( lock );
+			// Time spent stopped doesn't count.
+			timer.Mark();
+			continue;
+		}
+
+		const int shown = anim->GetFrame();
+		anim->Update( timer.Mark() );
+		if( anim->GetFrame() != shown )
+		{
+			newFrame = true;
+			wakeup.Wake();
+		}
+		// Wakes up right when the next frame is due, or early if the
+		//  panel changes something.
+		wake.wait_for( lock,std::chrono::duration<float>( anim->GetTimeLeft() ) );
+	}
+}
+
+void PreviewPanel::FitInto( const Surface& art,const RectI& clip,int cell )
+{
+	for( int y = 0; y < cellSize.y; ++y )
+	{
+		const int sy = clip.top + y * clip.GetHeight() / cellSize.y;
+		for( int x = 0; x < cellSize.x; ++x )
+		{
+			const int sx = clip.left + x * clip.GetWidth() / cellSize.x;
+			Color c = art.GetPixel( sx,sy );
+			if( c.GetA() == 0 ) c = chroma;
+			else
+			{
+				c = Blend::Unpremultiply( c );
+				c.SetA( 0 );
+			}
+			strip.PutPixel( cell * cellSize.x + x,y,c );
+		}
+	}
+}
+
+RectI PreviewPanel::GetViewArea() const
+{
+	return( RectI{ area.left + padding,area.right - padding,
+		area.top + padding * 2 + luckyPixel.GetCharSize().y,
+		area.bottom - padding } );
+}
\ No newline at end of file
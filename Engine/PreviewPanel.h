@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Graphics.h"
+#include "Mouse.h"
+#include "Keyboard.h"
+#include "Rect.h"
+#include "Font.h"
+#include "Anim.h"
+#include "ImageHandler.h"
+#include "Wakeup.h"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Plays the document's frames at their durations, or with shift click
+//  a one frame document as a strip of square cells.  Click to pause or
+//  play, right click to switch between loop, ping pong and once.
+//  Frames change on a thread of its own that sleeps until the next one
+//  is due, so slow canvas frames don't slow the animation down, and
+//  wakes the main loop only when there's a new frame to show.
+class PreviewPanel
+{
+public:
+	PreviewPanel( const RectI& area,Wakeup& wakeup );
+	~PreviewPanel();
+	PreviewPanel( const PreviewPanel& ) = delete;
+	PreviewPanel& operator=( const PreviewPanel& ) = delete;
+
+	void Update( const Mouse& mouse,const Keyboard& kbd,const ImageHandler& imgHand );
+	void Draw( Graphics& gfx ) const;
+	// True once the player moved to a frame that hasn't been drawn, until
+	//  the next Update.
+	bool HasNewFrame() const;
+	// Playing cells of a strip instead of frames.
+	bool IsShowingStrip() const;
+private:
+	// Body of the player thread.
+	void Play();
+	// Nearest neighbour copy of the clip of premultiplied art into cell,
+	//  keyed with chroma so Anim can draw it.
+	void FitInto( const Surface& art,const RectI& clip,int cell );
+	// Picture area below the label.
+	RectI GetViewArea() const;
+private:
+	const RectI area;
+	Wakeup& wakeup;
+	static constexpr int padding = 5;
+	static constexpr Color chroma = Colors::Magenta;
+	const Font luckyPixel = Font{ "Fonts/LuckyPixel24x36.bmp" };
+
+	// One fitted cell per frame side by side, what Anim plays.
+	Surface strip = { 0,0 };
+	Vei2 cellSize = { 0,0 };
+	// What each cell was made from, the current frame's comes from the
+	//  live composite instead.
+	std::vector<std::vector<LayerManager::FrameLayer>> cellLayers;
+	std::vector<bool> cellValid;
+	std::vector<float> holdTimes;
+	unsigned int compositeVersion = 0u;
+	int lastFrame = -1;
+	bool stripMode = false;
+	bool usingStrip = false;
+
+	bool canToggle = false;
+	bool canCycle = false;
+
+	// Everything below is shared with the player.
+	mutable std::mutex mutex;
+	std::condition_variable wake;
+	std::unique_ptr<Anim> anim;
+	Anim::Playback playback = Anim::Playback::Loop;
+	bool playing = true;
+	bool newFrame = false;
+	bool quitting = false;
+	std::thread player;
+};
\ No newline at end of file
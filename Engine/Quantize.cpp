@@ -0,0 +1,365 @@
+#include "Quantize.h"
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <thread>
+
+namespace
+{
+	constexpr int bucketBits = 5;
+	constexpr int nBuckets = 1 << ( bucketBits * 3 );
+	// Fewer rows than this aren't worth starting a thread for.
+	constexpr int minBandRows = 64;
+
+	struct Bucket
+	{
+		unsigned long long r = 0u;
+		unsigned long long g = 0u;
+		unsigned long long b = 0u;
+		unsigned int count = 0u;
+	};
+
+	int GetBucket( Color c )
+	{
+		constexpr int shift = 8 - bucketBits;
+		return( ( ( c.GetR() >> shift ) << ( bucketBits * 2 ) ) |
+			( ( c.GetG() >> shift ) << bucketBits ) |
+			( c.GetB() >> shift ) );
+	}
+
+	void CountRows( const Surface& img,int top,int bottom,Color chroma,
+		std::vector<Bucket>& buckets )
+	{
+		const auto& pixels = img.GetRawPixelData();
+		const size_t end = size_t( bottom ) * img.GetWidth();
+		for( size_t i = size_t( top ) * img.GetWidth(); i < end; ++i )
+		{
+			const Color c = pixels[i];
+			if( c == chroma ) continue;
+			auto& bucket = buckets[GetBucket( c )];
+			bucket.r += c.GetR();
+			bucket.g += c.GetG();
+			bucket.b += c.GetB();
+			++bucket.count;
+		}
+	}
+
+	Color Average( unsigned long long r,unsigned long long g,
+		unsigned long long b,unsigned long long count )
+	{
+		return( Color{ static_cast<unsigned char>( ( r + count / 2 ) / count ),
+			static_cast<unsigned char>( ( g + count / 2 ) / count ),
+			static_cast<unsigned char>( ( b + count / 2 ) / count ) } );
+	}
+
+	int Distance( Color a,Color b )
+	{
+		const int dr = int( a.GetR() ) - int( b.GetR() );
+		const int dg = int( a.GetG() ) - int( b.GetG() );
+		const int db = int( a.GetB() ) - int( b.GetB() );
+		return( dr * dr + dg * dg + db * db );
+	}
+
+	int GetChannel( Color c,int axis )
+	{
+		return( axis == 0 ? c.GetR() : axis == 1 ? c.GetG() : c.GetB() );
+	}
+
+	// An average can land right on chroma, one step of blue is invisible
+	//  but keeps the pixels from turning transparent.
+	Color AvoidChroma( Color c,Color chroma )
+	{
+		if( ( c.dword & 0xFFFFFFu ) == ( chroma.dword & 0xFFFFFFu ) )
+		{
+			c.dword ^= 1u;
+		}
+		return( c );
+	}
+
+	struct OctreeNode
+	{
+		std::array<int,8> children = { -1,-1,-1,-1,-1,-1,-1,-1 };
+		unsigned long long r = 0u;
+		unsigned long long g = 0u;
+		unsigned long long b = 0u;
+		unsigned long long count = 0u;
+		bool leaf = false;
+	};
+}
+
+std::vector<Quantize::Entry> Quantize::BuildHistogram( const Surface& img,
+	Color chroma )
+{
+	const int height = img.GetHeight();
+	const int nBands = std::max( 1,std::min( int( std::thread::hardware_concurrency() ),
+		height / minBandRows ) );
+
+	// Every band gets its own buckets so the threads never share a write.
+	std::vector<std::vector<Bucket>> bands( nBands,std::vector<Bucket>( nBuckets ) );
+	std::vector<std::thread> workers;
+	for( int i = 1; i < nBands; ++i )
+	{
+		workers.emplace_back( CountRows,std::cref( img ),height * i / nBands,
+			height * ( i + 1 ) / nBands,chroma,std::ref( bands[i] ) );
+	}
+	CountRows( img,0,height / nBands,chroma,bands[0] );
+	for( auto& worker : workers ) worker.join();
+
+	auto& total = bands[0];
+	for( int i = 1; i < nBands; ++i )
+	{
+		for( int j = 0; j < nBuckets; ++j )
+		{
+			total[j].r += bands[i][j].r;
+			total[j].g += bands[i][j].g;
+			total[j].b += bands[i][j].b;
+			total[j].count += bands[i][j].count;
+		}
+	}
+
+	std::vector<Entry> hist;
+	for( const auto& bucket : total )
+	{
+		if( bucket.count == 0u ) continue;
+		hist.emplace_back( Entry{ Average( bucket.r,bucket.g,bucket.b,
+			bucket.count ),bucket.count } );
+	}
+	return( hist );
+}
+
+std::vector<Color> Quantize::Octree( const std::vector<Entry>& hist,int nColors )
+{
+	if( hist.empty() || nColors <= 0 ) return( std::vector<Color>{} );
+
+	// One level per bucket bit, so every entry ends up in its own leaf.
+	std::vector<OctreeNode> nodes( 1 );
+	std::array<std::vector<int>,bucketBits> levels;
+	levels[0].emplace_back( 0 );
+	for( const auto& entry : hist )
+	{
+		const Color c = entry.color;
+		int node = 0;
+		for( int depth = 0; ; ++depth )
+		{
+			auto& cur = nodes[node];
+			cur.r += c.GetR() * static_cast<unsigned long long>( entry.count );
+			cur.g += c.GetG() * static_cast<unsigned long long>( entry.count );
+			cur.b += c.GetB() * static_cast<unsigned long long>( entry.count );
+			cur.count += entry.count;
+			if( depth == bucketBits )
+			{
+				cur.leaf = true;
+				break;
+			}
+
+			const int bit = 7 - depth;
+			const int child = ( ( ( c.GetR() >> bit ) & 1 ) << 2 ) |
+				( ( ( c.GetG() >> bit ) & 1 ) << 1 ) |
+				( ( c.GetB() >> bit ) & 1 );
+			if( cur.children[child] == -1 )
+			{
+				nodes[node].children[child] = int( nodes.size() );
+				if( depth + 1 < bucketBits ) levels[depth + 1].emplace_back( int( nodes.size() ) );
+				nodes.emplace_back();
+			}
+			node = nodes[node].children[child];
+		}
+	}
+
+	// Fold the smallest branches into their parent, deepest first.
+	int nLeaves = int( hist.size() );
+	for( int depth = bucketBits - 1; depth >= 0 && nLeaves > nColors; --depth )
+	{
+		auto& level = levels[depth];
+		std::sort( level.begin(),level.end(),[&nodes]( int a,int b )
+			{ return( nodes[a].count < nodes[b].count ); } );
+		for( const int node : level )
+		{
+			if( nLeaves <= nColors ) break;
+			int nChildren = 0;
+			for( auto& child : nodes[node].children )
+			{
+				if( child != -1 ) ++nChildren;
+				child = -1;
+			}
+			nodes[node].leaf = true;
+			nLeaves -= nChildren - 1;
+		}
+	}
+
+	std::vector<Color> colors;
+	std::vector<int> stack = { 0 };
+	while( !stack.empty() )
+	{
+		const auto& node = nodes[stack.back()];
+		stack.pop_back();
+		if( node.leaf )
+		{
+			colors.emplace_back( Average( node.r,node.g,node.b,node.count ) );
+			continue;
+		}
+		for( const int child : node.children )
+		{
+			if( child != -1 ) stack.emplace_back( child );
+		}
+	}
+	return( colors );
+}
+
+std::vector<Color> Quantize::MedianCut( std::vector<Entry> hist,int nColors )
+{
+	if( hist.empty() || nColors <= 0 ) return( std::vector<Color>{} );
+
+	struct Box
+	{
+		int begin;
+		int end;
+	};
+	std::vector<Box> boxes = { Box{ 0,int( hist.size() ) } };
+	while( int( boxes.size() ) < nColors )
+	{
+		// Widest box wins, weighted by how many pixels it covers.
+		int best = -1;
+		int bestAxis = 0;
+		unsigned long long bestScore = 0u;
+		for( int i = 0; i < int( boxes.size() ); ++i )
+		{
+			const auto& box = boxes[i];
+			if( box.end - box.begin < 2 ) continue;
+
+			std::array<int,3> lo = { 255,255,255 };
+			std::array<int,3> hi = { 0,0,0 };
+			unsigned long long count = 0u;
+			for( int j = box.begin; j < box.end; ++j )
+			{
+				for( int axis = 0; axis < 3; ++axis )
+				{
+					const int channel = GetChannel( hist[j].color,axis );
+					lo[axis] = std::min( lo[axis],channel );
+					hi[axis] = std::max( hi[axis],channel );
+				}
+				count += hist[j].count;
+			}
+			int axis = 0;
+			for( int a = 1; a < 3; ++a )
+			{
+				if( hi[a] - lo[a] > hi[axis] - lo[axis] ) axis = a;
+			}
+			const auto score = static_cast<unsigned long long>(
+				hi[axis] - lo[axis] + 1 ) * count;
+			if( score > bestScore )
+			{
+				best = i;
+				bestAxis = axis;
+				bestScore = score;
+			}
+		}
+		if( best == -1 ) break;
+
+		const Box box = boxes[best];
+		std::sort( hist.begin() + box.begin,hist.begin() + box.end,
+			[bestAxis]( const Entry& a,const Entry& b )
+			{ return( GetChannel( a.color,bestAxis ) < GetChannel( b.color,bestAxis ) ); } );
+
+		unsigned long long total = 0u;
+		for( int j = box.begin; j < box.end; ++j ) total += hist[j].count;
+		unsigned long long sum = 0u;
+		int split = box.begin + 1;
+		for( int j = box.begin; j < box.end - 1; ++j )
+		{
+			sum += hist[j].count;
+			split = j + 1;
+			if( sum * 2u >= total ) break;
+		}
+		boxes[best] = Box{ box.begin,split };
+		boxes.emplace_back( Box{ split,box.end } );
+	}
+
+	std::vector<Color> colors;
+	for( const auto& box : boxes )
+	{
+		unsigned long long r = 0u;
+		unsigned long long g = 0u;
+		unsigned long long b = 0u;
+		unsigned long long count = 0u;
+		for( int j = box.begin; j < box.end; ++j )
+		{
+			const auto& entry = hist[j];
+			r += entry.color.GetR() * static_cast<unsigned long long>( entry.count );
+			g += entry.color.GetG() * static_cast<unsigned long long>( entry.count );
+			b += entry.color.GetB() * static_cast<unsigned long long>( entry.count );
+			count += entry.count;
+		}
+		colors.emplace_back( Average( r,g,b,count ) );
+	}
+	return( colors );
+}
+
+void Quantize::Refine( const std::vector<Entry>& hist,std::vector<Color>& colors,
+	int passes )
+{
+	if( colors.empty() ) return;
+
+	std::vector<Bucket> sums( colors.size() );
+	for( int pass = 0; pass < passes; ++pass )
+	{
+		std::fill( sums.begin(),sums.end(),Bucket{} );
+		for( const auto& entry : hist )
+		{
+			int best = 0;
+			int bestDist = INT_MAX;
+			for( int i = 0; i < int( colors.size() ); ++i )
+			{
+				const int dist = Distance( entry.color,colors[i] );
+				if( dist < bestDist )
+				{
+					best = i;
+					bestDist = dist;
+				}
+			}
+			auto& sum = sums[best];
+			sum.r += entry.color.GetR() * static_cast<unsigned long long>( entry.count );
+			sum.g += entry.color.GetG() * static_cast<unsigned long long>( entry.count );
+			sum.b += entry.color.GetB() * static_cast<unsigned long long>( entry.count );
+			sum.count += entry.count;
+		}
+
+		// Colors nothing is closest to stay where they are.
+		bool moved = false;
+		for( int i = 0; i < int( colors.size() ); ++i )
+		{
+			const auto& sum = sums[i];
+			if( sum.count == 0u ) continue;
+			const Color c = Average( sum.r,sum.g,sum.b,sum.count );
+			if( c != colors[i] )
+			{
+				colors[i] = c;
+				moved = true;
+			}
+		}
+		if( !moved ) break;
+	}
+}
+
+std::vector<Color> Quantize::MakePalette( const Surface& img,int nColors,
+	Method method,int refinePasses,Color chroma )
+{
+	if( nColors <= 0 ) return( std::vector<Color>{} );
+
+	const auto hist = BuildHistogram( img,chroma );
+
+	std::vector<Color> colors;
+	if( int( hist.size() ) <= nColors )
+	{
+		for( const auto& entry : hist ) colors.emplace_back( entry.color );
+	}
+	else
+	{
+		colors = method == Method::Octree
+			? Octree( hist,nColors ) : MedianCut( hist,nColors );
+		Refine( hist,colors,refinePasses );
+	}
+
+	for( auto& c : colors ) c = AvoidChroma( c,chroma );
+	return( colors );
+}
\ No newline at end of file
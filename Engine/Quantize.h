@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Colors.h"
+#include "Surface.h"
+#include <vector>
+
+// Picks a small set of colors that stand in well for a full color image,
+//  for bringing photos and painted art into an indexed document.
+namespace Quantize
+{
+	enum class Method
+	{
+		Octree,
+		MedianCut
+	};
+	// Average color of a histogram bucket and how many pixels landed in it.
+	struct Entry
+	{
+		Color color;
+		unsigned int count;
+	};
+
+	// Pixels of img bucketed by the top 5 bits of each channel, chroma left
+	//  out.  Rows are split into bands that get counted on their own
+	//  threads and added up after.
+	std::vector<Entry> BuildHistogram( const Surface& img,
+		Color chroma = Colors::Magenta );
+
+	// Merges the least used branches of a color octree until nColors are left.
+	std::vector<Color> Octree( const std::vector<Entry>& hist,int nColors );
+	// Keeps splitting the widest box of colors at its weighted median.
+	std::vector<Color> MedianCut( std::vector<Entry> hist,int nColors );
+	// K-means, moves each color to the average of the entries closest to
+	//  it until nothing changes or passes run out.
+	void Refine( const std::vector<Entry>& hist,std::vector<Color>& colors,
+		int passes );
+
+	// At most nColors colors for img, never chroma.  Fewer if img doesn't
+	//  have that many.
+	std::vector<Color> MakePalette( const Surface& img,int nColors,
+		Method method = Method::MedianCut,int refinePasses = 4,
+		Color chroma = Colors::Magenta );
+}
\ No newline at end of file
@@ -108,7 +108,7 @@ public:
 	}
 	constexpr Rect_ GetExpandedByScale( const Vec2_<T>& scale ) const
 	{
-		RectI temp = *this;
+		Rect_ temp = *this;
 		// temp.MoveTo( Vei2{ 0,0 } );
 		temp.left *= scale.x;
 		temp.top *= scale.y;
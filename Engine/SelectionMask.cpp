@@ -0,0 +1,511 @@
+#include "SelectionMask.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+
+// Word ops and color matching get an sse2 path on x86, which every x86
+//  target this builds for has.
+#if defined( _M_X64 ) || defined( _M_IX86 ) || defined( __x86_64__ ) || defined( __i386__ )
+#define AESC_MASK_SSE2
+#include <emmintrin.h>
+#endif
+#if defined( _MSC_VER )
+#include <intrin.h>
+#endif
+
+namespace
+{
+	// x can't be 0 for either of these.
+	int LowestBit( uint64_t x )
+	{
+#if defined( _MSC_VER )
+		unsigned long i;
+		if( _BitScanForward( &i,static_cast<unsigned long>( x ) ) ) return( int( i ) );
+		_BitScanForward( &i,static_cast<unsigned long>( x >> 32 ) );
+		return( int( i ) + 32 );
+#else
+		return( __builtin_ctzll( x ) );
+#endif
+	}
+	int HighestBit( uint64_t x )
+	{
+#if defined( _MSC_VER )
+		unsigned long i;
+		if( _BitScanReverse( &i,static_cast<unsigned long>( x >> 32 ) ) ) return( int( i ) + 32 );
+		_BitScanReverse( &i,static_cast<unsigned long>( x ) );
+		return( int( i ) );
+#else
+		return( 63 - __builtin_clzll( x ) );
+#endif
+	}
+
+	bool TestBit( const uint64_t* row,int x )
+	{
+		return( ( row[x >> 6] >> ( x & 63 ) ) & 1u );
+	}
+
+	// Each op has a scalar and an sse2 version so CombineWords can do two
+	//  words per instruction and mop up the odd one after.
+	struct OrOp
+	{
+		static uint64_t Do( uint64_t a,uint64_t b ) { return( a | b ); }
+#ifdef AESC_MASK_SSE2
+		static __m128i Do( __m128i a,__m128i b ) { return( _mm_or_si128( a,b ) ); }
+#endif
+	};
+	struct AndOp
+	{
+		static uint64_t Do( uint64_t a,uint64_t b ) { return( a & b ); }
+#ifdef AESC_MASK_SSE2
+		static __m128i Do( __m128i a,__m128i b ) { return( _mm_and_si128( a,b ) ); }
+#endif
+	};
+	struct AndNotOp
+	{
+		static uint64_t Do( uint64_t a,uint64_t b ) { return( a & ~b ); }
+#ifdef AESC_MASK_SSE2
+		static __m128i Do( __m128i a,__m128i b ) { return( _mm_andnot_si128( b,a ) ); }
+#endif
+	};
+
+	template<typename Op>
+	void CombineWords( uint64_t* dst,const uint64_t* src,size_t count )
+	{
+		size_t i = 0;
+#ifdef AESC_MASK_SSE2
+		for( ; i + 2 <= count; i += 2 )
+		{
+			const __m128i a = _mm_loadu_si128( reinterpret_cast< const __m128i* >( dst + i ) );
+			const __m128i b = _mm_loadu_si128( reinterpret_cast< const __m128i* >( src + i ) );
+			_mm_storeu_si128( reinterpret_cast< __m128i* >( dst + i ),Op::Do( a,b ) );
+		}
+#endif
+		for( ; i < count; ++i ) dst[i] = Op::Do( dst[i],src[i] );
+	}
+
+	bool ColorMatches( Color a,Color b,int tolerance )
+	{
+		return( std::abs( int( a.GetR() ) - int( b.GetR() ) ) <= tolerance &&
+			std::abs( int( a.GetG() ) - int( b.GetG() ) ) <= tolerance &&
+			std::abs( int( a.GetB() ) - int( b.GetB() ) ) <= tolerance );
+	}
+}
+
+SelectionMask::SelectionMask( int width,int height )
+	:
+	width( width ),
+	height( height ),
+	wordsPerRow( ( width + 63 ) / 64 ),
+	words( size_t( wordsPerRow ) * height )
+{
+	SelectAll();
+}
+
+void SelectionMask::Resize( const Vei2& newSize )
+{
+	width = newSize.x;
+	height = newSize.y;
+	wordsPerRow = ( width + 63 ) / 64;
+	words.assign( size_t( wordsPerRow ) * height,0u );
+	SelectAll();
+}
+
+void SelectionMask::SelectAll()
+{
+	std::fill( words.begin(),words.end(),~uint64_t( 0 ) );
+	TrimRows();
+}
+
+void SelectionMask::SelectNone()
+{
+	std::fill( words.begin(),words.end(),uint64_t( 0 ) );
+}
+
+void SelectionMask::SelectRect( const RectI& area,Op op )
+{
+	SelectionMask shape = { width,height };
+	shape.SelectNone();
+	const int left = std::max( 0,std::min( area.left,area.right ) );
+	const int right = std::min( width,std::max( area.left,area.right ) );
+	const int top = std::max( 0,std::min( area.top,area.bottom ) );
+	const int bottom = std::min( height,std::max( area.top,area.bottom ) );
+	for( int y = top; y < bottom; ++y ) shape.SetSpan( y,left,right );
+	Combine( shape,op );
+}
+
+void SelectionMask::SelectLasso( const std::vector<Vei2>& points,Op op )
+{
+	SelectionMask shape = { width,height };
+	shape.SelectNone();
+
+	if( points.size() >= 3 )
+	{
+		int top = height;
+		int bottom = -1;
+		for( const auto& p : points )
+		{
+			top = std::min( top,p.y );
+			bottom = std::max( bottom,p.y );
+		}
+		top = std::max( top,0 );
+		bottom = std::min( bottom,height - 1 );
+
+		// Points are pixel centers, so a row's center line is just y.
+		std::vector<float> crossings;
+		for( int y = top; y <= bottom; ++y )
+		{
+			crossings.clear();
+			for( size_t i = 0; i < points.size(); ++i )
+			{
+				const Vei2& a = points[i];
+				const Vei2& b = points[( i + 1 ) % points.size()];
+				// Half open so a vertex shared by two edges counts once.
+				if( ( a.y <= y && b.y > y ) || ( b.y <= y && a.y > y ) )
+				{
+					crossings.emplace_back( float( a.x ) + float( y - a.y ) *
+						float( b.x - a.x ) / float( b.y - a.y ) );
+				}
+			}
+			std::sort( crossings.begin(),crossings.end() );
+			for( size_t i = 0; i + 1 < crossings.size(); i += 2 )
+			{
+				const int left = std::max( 0,int( std::ceil( crossings[i] ) ) );
+				const int right = std::min( width,
+					int( std::floor( crossings[i + 1] ) ) + 1 );
+				shape.SetSpan( y,left,right );
+			}
+		}
+
+		// The traced path itself is in too, even where it's only a line.
+		for( size_t i = 0; i < points.size(); ++i )
+		{
+			Vei2 cur = points[i];
+			const Vei2 end = points[( i + 1 ) % points.size()];
+			const int dx = std::abs( end.x - cur.x );
+			const int dy = -std::abs( end.y - cur.y );
+			const int sx = cur.x < end.x ? 1 : -1;
+			const int sy = cur.y < end.y ? 1 : -1;
+			int err = dx + dy;
+			while( true )
+			{
+				if( cur.x >= 0 && cur.x < width && cur.y >= 0 && cur.y < height )
+				{
+					shape.SetSpan( cur.y,cur.x,cur.x + 1 );
+				}
+				if( cur == end ) break;
+				const int err2 = err * 2;
+				if( err2 >= dy )
+				{
+					err += dy;
+					cur.x += sx;
+				}
+				if( err2 <= dx )
+				{
+					err += dx;
+					cur.y += sy;
+				}
+			}
+		}
+	}
+	Combine( shape,op );
+}
+
+void SelectionMask::SelectColor( const Surface& surf,const Vei2& seed,
+	int tolerance,bool contiguous,Op op )
+{
+	assert( surf.GetSize() == GetSize() );
+	SelectionMask shape = { width,height };
+	shape.SelectNone();
+	if( seed.x < 0 || seed.x >= width || seed.y < 0 || seed.y >= height )
+	{
+		Combine( shape,op );
+		return;
+	}
+
+	// Mark every matching pixel first, the flood below only has to look
+	//  at bits after that.
+	const Color target = surf.GetPixel( seed.x,seed.y );
+	const auto& pixels = surf.GetRawPixelData();
+	SelectionMask match = { width,height };
+	match.SelectNone();
+	for( int y = 0; y < height; ++y )
+	{
+		const Color* src = pixels.data() + size_t( y ) * width;
+		uint64_t* row = match.GetRow( y );
+		int x = 0;
+#ifdef AESC_MASK_SSE2
+		// Per byte distance both ways, whatever's left after taking the
+		//  tolerance off has to be 0 on r, g and b.
+		const __m128i key = _mm_set1_epi32( int( target.dword ) );
+		const __m128i tol = _mm_set1_epi8( char( std::min( tolerance,255 ) ) );
+		const __m128i rgb = _mm_set1_epi32( 0x00FFFFFF );
+		for( ; x + 4 <= width; x += 4 )
+		{
+			const __m128i p = _mm_loadu_si128( reinterpret_cast< const __m128i* >( src + x ) );
+			const __m128i dist = _mm_or_si128( _mm_subs_epu8( p,key ),
+				_mm_subs_epu8( key,p ) );
+			const __m128i over = _mm_and_si128( _mm_subs_epu8( dist,tol ),rgb );
+			const __m128i same = _mm_cmpeq_epi32( over,_mm_setzero_si128() );
+			const uint64_t bits = uint64_t( _mm_movemask_ps( _mm_castsi128_ps( same ) ) );
+			row[x >> 6] |= bits << ( x & 63 );
+		}
+#endif
+		for( ; x < width; ++x )
+		{
+			if( ColorMatches( src[x],target,tolerance ) )
+			{
+				row[x >> 6] |= uint64_t( 1 ) << ( x & 63 );
+			}
+		}
+	}
+
+	if( !contiguous )
+	{
+		Combine( match,op );
+		return;
+	}
+
+	// Scanline flood over the match bits.  Whole runs get filled at once so
+	//  checking one bit of a run says if all of it is done.
+	std::vector<Vei2> seeds = { seed };
+	while( !seeds.empty() )
+	{
+		const Vei2 p = seeds.back();
+		seeds.pop_back();
+		if( TestBit( shape.GetRow( p.y ),p.x ) ) continue;
+
+		const uint64_t* matchRow = match.GetRow( p.y );
+		const int left = FindClearBefore( matchRow,p.x,0 ) + 1;
+		const int right = FindClear( matchRow,p.x,width );
+		shape.SetSpan( p.y,left,right );
+
+		for( int ny = p.y - 1; ny <= p.y + 1; ny += 2 )
+		{
+			if( ny < 0 || ny >= height ) continue;
+			const uint64_t* nextMatch = match.GetRow( ny );
+			const uint64_t* nextFilled = shape.GetRow( ny );
+			for( int x = FindSet( nextMatch,left,right ); x < right;
+				x = FindSet( nextMatch,FindClear( nextMatch,x,right ),right ) )
+			{
+				if( !TestBit( nextFilled,x ) ) seeds.emplace_back( Vei2{ x,ny } );
+			}
+		}
+	}
+	Combine( shape,op );
+}
+
+void SelectionMask::Combine( const SelectionMask& other,Op op )
+{
+	assert( other.GetSize() == GetSize() );
+	switch( op )
+	{
+	case Op::Replace:
+		words = other.words;
+		break;
+	case Op::Add:
+		CombineWords<OrOp>( words.data(),other.words.data(),words.size() );
+		break;
+	case Op::Subtract:
+		CombineWords<AndNotOp>( words.data(),other.words.data(),words.size() );
+		break;
+	case Op::Intersect:
+		CombineWords<AndOp>( words.data(),other.words.data(),words.size() );
+		break;
+	}
+}
+
+void SelectionMask::Move( const Vei2& amount )
+{
+	SelectionMask moved = { width,height };
+	moved.SelectNone();
+	std::vector<Surface::Span> spans;
+	GetSpans( RectI{ 0,width,0,height },spans );
+	for( const auto& span : spans )
+	{
+		const int y = span.y + amount.y;
+		if( y < 0 || y >= height ) continue;
+		moved.SetSpan( y,std::max( 0,span.left + amount.x ),
+			std::min( width,span.right + amount.x ) );
+	}
+	words = std::move( moved.words );
+}
+
+bool SelectionMask::IsSelected( int x,int y ) const
+{
+	if( x < 0 || x >= width || y < 0 || y >= height ) return( false );
+	return( TestBit( GetRow( y ),x ) );
+}
+
+bool SelectionMask::IsEmpty() const
+{
+	return( std::all_of( words.begin(),words.end(),
+		[]( uint64_t word ) { return( word == 0u ); } ) );
+}
+
+bool SelectionMask::IsAll() const
+{
+	for( int y = 0; y < height; ++y )
+	{
+		if( FindClear( GetRow( y ),0,width ) != width ) return( false );
+	}
+	return( true );
+}
+
+RectI SelectionMask::GetBounds() const
+{
+	RectI bounds = { width,0,height,0 };
+	for( int y = 0; y < height; ++y )
+	{
+		const uint64_t* row = GetRow( y );
+		const int first = FindSet( row,0,width );
+		if( first == width ) continue;
+
+		int last = wordsPerRow - 1;
+		while( row[last] == 0u ) --last;
+		bounds.left = std::min( bounds.left,first );
+		bounds.right = std::max( bounds.right,last * 64 + HighestBit( row[last] ) + 1 );
+		bounds.top = std::min( bounds.top,y );
+		bounds.bottom = y + 1;
+	}
+	if( bounds.right == 0 ) return( RectI{ 0,0,0,0 } );
+	return( bounds );
+}
+
+Vei2 SelectionMask::GetSize() const
+{
+	return( Vei2{ width,height } );
+}
+
+void SelectionMask::GetSpans( const RectI& area,
+	std::vector<Surface::Span>& spans ) const
+{
+	const int left = std::max( 0,area.left );
+	const int right = std::min( width,area.right );
+	const int top = std::max( 0,area.top );
+	const int bottom = std::min( height,area.bottom );
+	for( int y = top; y < bottom; ++y )
+	{
+		const uint64_t* row = GetRow( y );
+		for( int x = FindSet( row,left,right ); x < right; )
+		{
+			const int end = FindClear( row,x,right );
+			spans.emplace_back( Surface::Span{ y,x,end } );
+			x = FindSet( row,end,right );
+		}
+	}
+}
+
+void SelectionMask::ClipSpans( const std::vector<Surface::Span>& spans,
+	std::vector<Surface::Span>& clipped ) const
+{
+	for( const auto& span : spans )
+	{
+		GetSpans( RectI{ span.left,span.right,span.y,span.y + 1 },clipped );
+	}
+}
+
+void SelectionMask::GetOutline( std::vector<std::pair<Vei2,Vei2>>& edges ) const
+{
+	// Horizontal edges sit wherever a row differs from the one above it,
+	//  rows off the canvas count as unselected.
+	std::vector<uint64_t> diff( wordsPerRow );
+	for( int y = 0; y <= height; ++y )
+	{
+		for( int i = 0; i < wordsPerRow; ++i )
+		{
+			const uint64_t above = y > 0 ? GetRow( y - 1 )[i] : 0u;
+			const uint64_t below = y < height ? GetRow( y )[i] : 0u;
+			diff[i] = above ^ below;
+		}
+		for( int x = FindSet( diff.data(),0,width ); x < width; )
+		{
+			const int end = FindClear( diff.data(),x,width );
+			edges.emplace_back( Vei2{ x,y },Vei2{ end,y } );
+			x = FindSet( diff.data(),end,width );
+		}
+	}
+
+	// Vertical ones are the ends of each run.
+	std::vector<Surface::Span> spans;
+	GetSpans( RectI{ 0,width,0,height },spans );
+	for( const auto& span : spans )
+	{
+		edges.emplace_back( Vei2{ span.left,span.y },Vei2{ span.left,span.y + 1 } );
+		edges.emplace_back( Vei2{ span.right,span.y },Vei2{ span.right,span.y + 1 } );
+	}
+}
+
+const uint64_t* SelectionMask::GetRow( int y ) const
+{
+	return( words.data() + size_t( y ) * wordsPerRow );
+}
+
+uint64_t* SelectionMask::GetRow( int y )
+{
+	return( words.data() + size_t( y ) * wordsPerRow );
+}
+
+void SelectionMask::SetSpan( int y,int left,int right )
+{
+	if( left >= right ) return;
+	uint64_t* row = GetRow( y );
+	const int first = left >> 6;
+	const int last = ( right - 1 ) >> 6;
+	const uint64_t firstBits = ~uint64_t( 0 ) << ( left & 63 );
+	const uint64_t lastBits = ~uint64_t( 0 ) >> ( 63 - ( ( right - 1 ) & 63 ) );
+	if( first == last )
+	{
+		row[first] |= firstBits & lastBits;
+		return;
+	}
+	row[first] |= firstBits;
+	std::fill( row + first + 1,row + last,~uint64_t( 0 ) );
+	row[last] |= lastBits;
+}
+
+int SelectionMask::FindSet( const uint64_t* row,int x,int right )
+{
+	if( x >= right ) return( right );
+	int w = x >> 6;
+	uint64_t bits = row[w] & ( ~uint64_t( 0 ) << ( x & 63 ) );
+	while( bits == 0u )
+	{
+		if( ++w * 64 >= right ) return( right );
+		bits = row[w];
+	}
+	return( std::min( right,w * 64 + LowestBit( bits ) ) );
+}
+
+int SelectionMask::FindClear( const uint64_t* row,int x,int right )
+{
+	if( x >= right ) return( right );
+	int w = x >> 6;
+	uint64_t bits = ~row[w] & ( ~uint64_t( 0 ) << ( x & 63 ) );
+	while( bits == 0u )
+	{
+		if( ++w * 64 >= right ) return( right );
+		bits = ~row[w];
+	}
+	return( std::min( right,w * 64 + LowestBit( bits ) ) );
+}
+
+int SelectionMask::FindClearBefore( const uint64_t* row,int x,int left )
+{
+	if( x <= left ) return( left - 1 );
+	int w = ( x - 1 ) >> 6;
+	uint64_t bits = ~row[w] & ( ~uint64_t( 0 ) >> ( 63 - ( ( x - 1 ) & 63 ) ) );
+	while( bits == 0u )
+	{
+		if( w * 64 <= left ) return( left - 1 );
+		bits = ~row[--w];
+	}
+	return( std::max( left - 1,w * 64 + HighestBit( bits ) ) );
+}
+
+void SelectionMask::TrimRows()
+{
+	if( width % 64 == 0 ) return;
+	const uint64_t keep = ( uint64_t( 1 ) << ( width % 64 ) ) - 1u;
+	for( int y = 0; y < height; ++y ) GetRow( y )[wordsPerRow - 1] &= keep;
+}
\ No newline at end of file
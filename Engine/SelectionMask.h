@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Surface.h"
+#include "Rect.h"
+#include "Vec2.h"
+#include <vector>
+#include <cstdint>
+
+// Which pixels of the canvas are selected, one bit each.  Rows are packed
+//  into 64 bit words so combining masks and finding runs of selected
+//  pixels goes a word at a time instead of a pixel at a time.
+class SelectionMask
+{
+public:
+	// How a new shape combines with what's already selected.
+	enum class Op
+	{
+		Replace,
+		Add,
+		Subtract,
+		Intersect
+	};
+public:
+	// Starts with everything selected.
+	SelectionMask( int width,int height );
+
+	// Throws away the selection, everything ends up selected.
+	void Resize( const Vei2& newSize );
+	void SelectAll();
+	void SelectNone();
+
+	void SelectRect( const RectI& area,Op op );
+	// Polygon through points, filled even-odd at pixel centers.
+	void SelectLasso( const std::vector<Vei2>& points,Op op );
+	// Pixels within tolerance of the color at seed on every channel,
+	//  either only ones connected to seed or all of them.
+	void SelectColor( const Surface& surf,const Vei2& seed,int tolerance,
+		bool contiguous,Op op );
+	// Both masks have to be the same size.
+	void Combine( const SelectionMask& other,Op op );
+	// Shifts the selection by amount, whatever moves off the canvas is
+	//  gone.
+	void Move( const Vei2& amount );
+
+	bool IsSelected( int x,int y ) const;
+	bool IsEmpty() const;
+	bool IsAll() const;
+	// Smallest rect holding every selected pixel, empty if none are.
+	RectI GetBounds() const;
+	Vei2 GetSize() const;
+
+	// Appends runs of selected pixels inside area, top to bottom and left
+	//  to right.
+	void GetSpans( const RectI& area,std::vector<Surface::Span>& spans ) const;
+	// Appends the parts of spans that are selected, keeps their order.
+	void ClipSpans( const std::vector<Surface::Span>& spans,
+		std::vector<Surface::Span>& clipped ) const;
+	// Unit length edges between selected and unselected pixels, as pairs of
+	//  canvas points.  Horizontal runs are merged into one edge.
+	void GetOutline( std::vector<std::pair<Vei2,Vei2>>& edges ) const;
+private:
+	const uint64_t* GetRow( int y ) const;
+	uint64_t* GetRow( int y );
+	void SetSpan( int y,int left,int right );
+	// First set (or clear) bit in row at or after x, right if there's none
+	//  before it.
+	static int FindSet( const uint64_t* row,int x,int right );
+	static int FindClear( const uint64_t* row,int x,int right );
+	// Last clear bit in row before x, left - 1 if there's none after left.
+	static int FindClearBefore( const uint64_t* row,int x,int left );
+	// Zeroes the padding bits past width so word compares stay exact.
+	void TrimRows();
+private:
+	int width;
+	int height;
+	int wordsPerRow;
+	std::vector<uint64_t> words;
+};
\ No newline at end of file
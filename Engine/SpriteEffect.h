@@ -61,12 +61,14 @@ namespace SpriteEffect
 			if( src != chroma )
 			{
 				const Color dest = gfx.GetPixel( xDest,yDest );
+				typedef unsigned char uchar;
 				const Color blend =
 				{
-					unsigned char( ( src.GetR() + dest.GetR() ) / 2 ),
-					unsigned char( ( src.GetG() + dest.GetG() ) / 2 ),
-					unsigned char( ( src.GetB() + dest.GetB() ) / 2 )
+					uchar( ( src.GetR() + dest.GetR() ) / 2 ),
+					uchar( ( src.GetG() + dest.GetG() ) / 2 ),
+					uchar( ( src.GetB() + dest.GetB() ) / 2 )
 				};
+				gfx.PutPixel( xDest,yDest,blend );
 			}
 		}
 	private:
@@ -139,7 +141,8 @@ namespace SpriteEffect
 					float( cSrc.GetG() ) * 0.59f +
 					float( cSrc.GetB() ) * 0.11f;
 
-				const auto uval = unsigned char( val );
+				typedef unsigned char uchar;
+				const auto uval = uchar( val );
 				gfx.PutPixel( xDest,yDest,Colors
 					::MakeRGB( uval,uval,uval ) );
 			}
@@ -0,0 +1,128 @@
+#include "Stroke.h"
+#include <algorithm>
+#include <cstdlib>
+
+void Stroke::Begin( const Vei2& canvSize,Color c )
+{
+	End();
+	active = true;
+	color = c;
+	this->canvSize = canvSize;
+	const size_t nWords = ( size_t( canvSize.x ) * canvSize.y + 31 ) / 32;
+	if( hit.size() != nWords ) hit.assign( nWords,0u );
+}
+
+void Stroke::AddPoint( const Vei2& pos )
+{
+	if( !active ) return;
+	if( !hasLast )
+	{
+		hasLast = true;
+		last = pos;
+		Plot( pos.x,pos.y );
+		return;
+	}
+	if( pos == last ) return;
+
+	// Bresenham, all integer so it's cheap enough to run per event.
+	const int dx = std::abs( pos.x - last.x );
+	const int dy = -std::abs( pos.y - last.y );
+	const int sx = last.x < pos.x ? 1 : -1;
+	const int sy = last.y < pos.y ? 1 : -1;
+	int err = dx + dy;
+	int x = last.x;
+	int y = last.y;
+	while( x != pos.x || y != pos.y )
+	{
+		const int err2 = err * 2;
+		if( err2 >= dy )
+		{
+			err += dy;
+			x += sx;
+		}
+		if( err2 <= dx )
+		{
+			err += dx;
+			y += sy;
+		}
+		Plot( x,y );
+	}
+	last = pos;
+}
+
+void Stroke::Lift()
+{
+	hasLast = false;
+}
+
+void Stroke::Apply( Surface& target,History& history,int layer,
+	const SelectionMask& selection )
+{
+	if( pending.empty() ) return;
+	// Canvas got resized under the stroke, the queued pixels mean nothing.
+	if( target.GetSize() != canvSize )
+	{
+		pending.clear();
+		return;
+	}
+
+	std::sort( pending.begin(),pending.end(),
+		[]( const Vei2& a,const Vei2& b )
+		{
+			return( a.y < b.y || ( a.y == b.y && a.x < b.x ) );
+		} );
+
+	spans.clear();
+	for( const auto& p : pending )
+	{
+		if( !spans.empty() && spans.back().y == p.y &&
+			spans.back().right == p.x )
+		{
+			++spans.back().right;
+		}
+		else spans.emplace_back( Surface::Span{ p.y,p.x,p.x + 1 } );
+	}
+	pending.clear();
+
+	clipped.clear();
+	selection.ClipSpans( spans,clipped );
+	for( const auto& span : clipped )
+	{
+		history.Touch( target,layer,
+			RectI{ span.left,span.right,span.y,span.y + 1 } );
+	}
+	target.FillSpans( clipped,color );
+}
+
+void Stroke::End()
+{
+	for( int word : hitWords ) hit[word] = 0u;
+	hitWords.clear();
+	pending.clear();
+	active = false;
+	hasLast = false;
+}
+
+bool Stroke::IsActive() const
+{
+	return( active );
+}
+
+Color Stroke::GetColor() const
+{
+	return( color );
+}
+
+void Stroke::Plot( int x,int y )
+{
+	if( x < 0 || x >= canvSize.x || y < 0 || y >= canvSize.y ) return;
+
+	const int index = y * canvSize.x + x;
+	auto& word = hit[index / 32];
+	const unsigned int bit = 1u << ( index % 32 );
+	if( ( word & bit ) != 0u ) return;
+
+	if( word == 0u ) hitWords.emplace_back( index / 32 );
+	word |= bit;
+	pending.emplace_back( Vei2{ x,y } );
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "Surface.h"
+#include "History.h"
+#include "SelectionMask.h"
+#include "Vec2.h"
+#include <vector>
+
+// Turns mouse samples into brush pixels.  Each sample gets joined to the
+//  last one so fast strokes don't leave gaps, and a pixel only gets queued
+//  the first time a stroke crosses it.  Queued pixels are written in one
+//  batch by Apply, usually once per frame.
+class Stroke
+{
+public:
+	// Starts a stroke in color c on a canvas of canvSize.
+	void Begin( const Vei2& canvSize,Color c );
+	// Line from the last point to pos, pos is in canvas pixels and can be
+	//  off the canvas.
+	void AddPoint( const Vei2& pos );
+	// Next point starts fresh instead of joining up with the last one.
+	void Lift();
+	// Writes what got queued since last time into target as spans, only
+	//  the selected parts of them.
+	void Apply( Surface& target,History& history,int layer,
+		const SelectionMask& selection );
+	void End();
+
+	bool IsActive() const;
+	Color GetColor() const;
+private:
+	void Plot( int x,int y );
+private:
+	bool active = false;
+	Color color;
+	Vei2 canvSize = { 0,0 };
+	bool hasLast = false;
+	Vei2 last = { 0,0 };
+
+	// One bit per canvas pixel, set once the stroke has queued it.
+	std::vector<unsigned int> hit;
+	// Words of hit that have bits set, so End doesn't clear all of it.
+	std::vector<int> hitWords;
+	std::vector<Vei2> pending;
+	std::vector<Surface::Span> spans;
+	std::vector<Surface::Span> clipped;
+};
\ No newline at end of file
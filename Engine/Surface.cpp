@@ -1,7 +1,10 @@
 #include "Surface.h"
-#include "ChiliWin.h"
+#include "ColorHistogram.h"
 #include <cassert>
+#include <algorithm>
 #include <fstream>
+#include <thread>
+#include <unordered_map>
 #include "Graphics.h"
 
 Surface::Surface( int width,int height ) :
@@ -15,37 +18,76 @@ Surface::Surface( const std::string& filename )
 	std::ifstream file( filename,std::ios::binary );
 	assert( file );
 
-	BITMAPFILEHEADER bmFileHeader;
-	file.read( reinterpret_cast< char* >( &bmFileHeader ),
-		sizeof( bmFileHeader ) );
-
-	BITMAPINFOHEADER bmInfoHeader;
-	file.read( reinterpret_cast< char* >( &bmInfoHeader ),
-		sizeof( bmInfoHeader ) );
-
-	assert( bmInfoHeader.biBitCount == 24 ||
-		bmInfoHeader.biBitCount == 32 );
-	assert( bmInfoHeader.biCompression == BI_RGB );
+	// Read the headers a field at a time so this doesn't depend on
+	//  windows' structs or their packing.
+	const auto readInt = [&file]( int nBytes )
+	{
+		unsigned int value = 0u;
+		for( int i = 0; i < nBytes; ++i )
+		{
+			value |= unsigned( file.get() & 0xFF ) << ( i * 8 );
+		}
+		return( value );
+	};
+
+	// File header.
+	file.seekg( 10 );
+	const unsigned int pixelOffset = readInt( 4 );
+
+	// Info header.
+	file.seekg( 14 + 4 );
+	const int bmWidth = int( readInt( 4 ) );
+	const int bmHeight = int( readInt( 4 ) );
+	file.seekg( 2,std::ios::cur ); // Planes.
+	const unsigned int bitCount = readInt( 2 );
+	[[maybe_unused]] const unsigned int compression = readInt( 4 );
+	file.seekg( 12,std::ios::cur ); // Image size and resolution.
+	const unsigned int nPalColors = readInt( 4 );
+
+	assert( bitCount == 8 || bitCount == 24 || bitCount == 32 );
+	assert( compression == 0u ); // Uncompressed rgb.
+
+	typedef unsigned char uchar;
+
+	// 8 bit images look their pixels up in the color table after the
+	//  info header, 0 colors means all 256.
+	std::vector<Color> palette;
+	if( bitCount == 8 )
+	{
+		file.seekg( 14 );
+		const unsigned int infoSize = readInt( 4 );
+		file.seekg( 14 + infoSize );
+		palette.resize( nPalColors == 0u ? 256u : nPalColors );
+		for( auto& c : palette )
+		{
+			const uchar b = uchar( file.get() );
+			const uchar g = uchar( file.get() );
+			const uchar r = uchar( file.get() );
+			file.get(); // Reserved.
+			c = Color( r,g,b );
+		}
+		palette.resize( 256u,Colors::Black );
+	}
 
-	const bool is32b = bmInfoHeader.biBitCount == 32;
+	const int bytesPerPixel = int( bitCount / 8u );
 
-	width = bmInfoHeader.biWidth;
+	width = bmWidth;
 
 	// Test for reverse row order and
 	//  control y loop accordingly.
 	int yStart;
 	int yEnd;
 	int dy;
-	if( bmInfoHeader.biHeight < 0 )
+	if( bmHeight < 0 )
 	{
-		height = -bmInfoHeader.biHeight;
+		height = -bmHeight;
 		yStart = 0;
 		yEnd = height;
 		dy = 1;
 	}
 	else
 	{
-		height = bmInfoHeader.biHeight;
+		height = bmHeight;
 		yStart = height - 1;
 		yEnd = -1;
 		dy = -1;
@@ -53,24 +95,31 @@ Surface::Surface( const std::string& filename )
 
 	pixels.resize( width * height );
 
-	file.seekg( bmFileHeader.bfOffBits );
-	// Padding is for 24 bit depth only.
-	const int padding = ( 4 - ( width * 3 ) % 4 ) % 4;
+	file.seekg( pixelOffset );
+	// Rows are padded to 4 bytes, 32 bit ones never need it.
+	const int padding = ( 4 - ( width * bytesPerPixel ) % 4 ) % 4;
 
 	for( int y = yStart; y != yEnd; y += dy )
 	{
 		for( int x = 0; x < width; ++x )
 		{
-			PutPixel( x,y,Color( file.get(),file.get(),file.get() ) );
-			if( is32b )
+			if( bytesPerPixel == 1 )
+			{
+				PutPixel( x,y,palette[uchar( file.get() )] );
+				continue;
+			}
+			// Stored as bgr, read one at a time since argument
+			//  evaluation order isn't fixed.
+			const uchar b = uchar( file.get() );
+			const uchar g = uchar( file.get() );
+			const uchar r = uchar( file.get() );
+			PutPixel( x,y,Color( r,g,b ) );
+			if( bytesPerPixel == 4 )
 			{
 				file.seekg( 1,std::ios::cur );
 			}
 		}
-		if( !is32b )
-		{
-			file.seekg( padding,std::ios::cur );
-		}
+		file.seekg( padding,std::ios::cur );
 	}
 }
 
@@ -95,11 +144,34 @@ Surface::Surface( const Surface& other,bool xFlipped,bool yFlipped )
 	*this = guineaPig;
 }
 
+Surface::Surface( const Surface& other )
+	:
+	pixels( other.pixels ),
+	width( other.width ),
+	height( other.height ),
+	version( other.version ),
+	dirtyRect( other.dirtyRect )
+{}
+
 Surface::Surface( Surface&& donor )
 {
 	*this = std::move( donor );
 }
 
+Surface& Surface::operator=( const Surface& rhs )
+{
+	width = rhs.width;
+	height = rhs.height;
+	pixels = rhs.pixels;
+
+	// Keep counting from our own version so anyone watching still sees
+	//  a change.
+	MarkDirty( GetRect() );
+	Recount();
+
+	return( *this );
+}
+
 Surface& Surface::operator=( Surface&& rhs )
 {
 	width = rhs.width;
@@ -108,6 +180,11 @@ Surface& Surface::operator=( Surface&& rhs )
 
 	rhs.width = 0;
 	rhs.height = 0;
+	rhs.pixels.clear();
+	rhs.Recount();
+
+	MarkDirty( GetRect() );
+	Recount();
 
 	return( *this );
 }
@@ -118,7 +195,11 @@ void Surface::PutPixel( int x,int y,Color c )
 	assert( x < width );
 	assert( y >= 0 );
 	assert( y < height );
+	// Writing the same color isn't a change.
+	if( pixels.data()[y * width + x] == c ) return;
+	if( histogram ) histogram->Replace( pixels.data()[y * width + x],c );
 	pixels.data()[y * width + x] = c;
+	MarkDirty( RectI{ x,x + 1,y,y + 1 } );
 }
 
 void Surface::DrawRect( int x,int y,int width,int height,Color c )
@@ -127,9 +208,10 @@ void Surface::DrawRect( int x,int y,int width,int height,Color c )
 	{
 		for( int j = x; j < x + width; ++j )
 		{
-			PutPixel( j,i,c );
+			SetPixel( j,i,c );
 		}
 	}
+	MarkDirty( RectI{ x,x + width,y,y + height } );
 }
 
 void Surface::DrawLine( Vec2 p0,Vec2 p1,Color c )
@@ -184,9 +266,10 @@ void Surface::CopyInto( const Surface& other )
 	{
 		for( int x = 0; x < minWidth; ++x )
 		{
-			PutPixel( x,y,other.GetPixel( x,y ) );
+			SetPixel( x,y,other.GetPixel( x,y ) );
 		}
 	}
+	MarkDirty( RectI{ 0,minWidth,0,minHeight } );
 }
 
 void Surface::LightCopyInto( const Surface& other )
@@ -202,10 +285,11 @@ void Surface::LightCopyInto( const Surface& other )
 		{
 			if( GetPixel( x,y ) == Colors::Magenta )
 			{
-				PutPixel( x,y,other.GetPixel( x,y ) );
+				SetPixel( x,y,other.GetPixel( x,y ) );
 			}
 		}
 	}
+	MarkDirty( RectI{ 0,minWidth,0,minHeight } );
 }
 
 void Surface::LightCopyIntoPos( const Surface& other,const Vei2& pos )
@@ -216,14 +300,106 @@ void Surface::LightCopyIntoPos( const Surface& other,const Vei2& pos )
 		{
 			if( other.GetPixel( x - pos.x,y - pos.y ) != Colors::Magenta )
 			{
-				PutPixel( x,y,other.GetPixel( x - pos.x,y - pos.y ) );
+				SetPixel( x,y,other.GetPixel( x - pos.x,y - pos.y ) );
 			}
 		}
 	}
+	MarkDirty( RectI{ pos,other.GetWidth(),other.GetHeight() } );
+}
+
+void Surface::CopyFrom( const Color* src )
+{
+	std::copy( src,src + pixels.size(),pixels.begin() );
+	MarkDirty( GetRect() );
+	Recount();
+}
+
+void Surface::CopyFrom( const unsigned char* src,const Color* lut )
+{
+	Color* dst = pixels.data();
+	for( size_t i = 0; i < pixels.size(); ++i ) dst[i] = lut[src[i]];
+	MarkDirty( GetRect() );
+	Recount();
+}
+
+void Surface::BlendInto( const Surface& other,BlendMode mode,unsigned char opacity )
+{
+	const int minWidth = std::min( GetWidth(),other.GetWidth() );
+	const int minHeight = std::min( GetHeight(),other.GetHeight() );
+	MarkDirty( RectI{ 0,minWidth,0,minHeight } );
+
+	// Same width means the rows are contiguous in both.
+	if( width == other.width )
+	{
+		Blend::CompositeSpan( pixels.data(),other.pixels.data(),
+			minWidth * minHeight,mode,opacity );
+	}
+	else
+	{
+		for( int y = 0; y < minHeight; ++y )
+		{
+			Blend::CompositeSpan( &pixels[y * width],&other.pixels[y * other.width],
+				minWidth,mode,opacity );
+		}
+	}
+	Recount();
+}
+
+void Surface::BlendUnder( const Surface& other )
+{
+	const int minWidth = std::min( GetWidth(),other.GetWidth() );
+	const int minHeight = std::min( GetHeight(),other.GetHeight() );
+	MarkDirty( RectI{ 0,minWidth,0,minHeight } );
+
+	if( width == other.width )
+	{
+		Blend::UnderSpan( pixels.data(),other.pixels.data(),
+			minWidth * minHeight );
+	}
+	else
+	{
+		for( int y = 0; y < minHeight; ++y )
+		{
+			Blend::UnderSpan( &pixels[y * width],&other.pixels[y * other.width],
+				minWidth );
+		}
+	}
+	Recount();
+}
+
+void Surface::Unpremultiply( Color chroma,unsigned char minAlpha )
+{
+	for( auto& pix : pixels )
+	{
+		if( pix.GetA() == 0 || pix.GetA() < minAlpha ) pix = chroma;
+		else
+		{
+			pix = Blend::Unpremultiply( pix );
+			pix.SetA( 0 );
+		}
+	}
+	MarkDirty( GetRect() );
+	Recount();
+}
+
+int Surface::GetUniformAlpha() const
+{
+	int alpha = 0;
+	for( const auto& pix : pixels )
+	{
+		const int a = pix.GetA();
+		if( a == 0 || a == alpha ) continue;
+		if( alpha != 0 ) return( -1 );
+		alpha = a;
+	}
+	return( alpha );
 }
 
 void Surface::Resize( const Vei2& newSize )
 {
+	// Recounted at the end, the pixels in between are junk.
+	auto* const counts = histogram;
+	histogram = nullptr;
 	Surface temp = *this;
 	// const auto oldSize = GetSize();
 	pixels.resize( newSize.x * newSize.y );
@@ -231,8 +407,11 @@ void Surface::Resize( const Vei2& newSize )
 	width = newSize.x;
 	height = newSize.y;
 
+	// Old dirty area might not fit anymore, all of it changed anyway.
+	ClearDirty();
 	DrawRect( 0,0,width,height,Colors::Magenta );
 	CopyInto( temp );
+	SetHistogram( counts );
 
 	// for( int y = oldSize.y; y < height; ++y )
 	// {
@@ -252,9 +431,187 @@ void Surface::CopyIntoPos( const Surface& other,const Vei2& pos )
 	{
 		for( int x = pos.x; x < minWidth; ++x )
 		{
-			PutPixel( x,y,other.GetPixel( x - pos.x,y - pos.y ) );
+			SetPixel( x,y,other.GetPixel( x - pos.x,y - pos.y ) );
+		}
+	}
+	MarkDirty( RectI{ pos.x,minWidth,pos.y,minHeight } );
+}
+
+void Surface::CopyRect( const Surface& other,const RectI& area )
+{
+	assert( GetSize() == other.GetSize() );
+	assert( area.left >= 0 && area.right <= width );
+	assert( area.top >= 0 && area.bottom <= height );
+
+	for( int y = area.top; y < area.bottom; ++y )
+	{
+		const auto row = other.pixels.begin() + y * width;
+		const size_t first = size_t( y ) * width + area.left;
+		Count( first,area.GetWidth(),-1 );
+		std::copy( row + area.left,row + area.right,
+			pixels.begin() + first );
+		Count( first,area.GetWidth(),1 );
+	}
+	MarkDirty( area );
+}
+
+void Surface::FillSpans( const std::vector<Span>& spans,Color c )
+{
+	if( spans.empty() ) return;
+
+	RectI area = { width,0,height,0 };
+	for( const auto& span : spans )
+	{
+		assert( span.y >= 0 && span.y < height );
+		assert( span.left >= 0 && span.right <= width );
+		auto* row = pixels.data() + span.y * width;
+		Count( size_t( span.y ) * width + span.left,span.right - span.left,-1 );
+		std::fill( row + span.left,row + span.right,c );
+		if( histogram ) histogram->Add( c,span.right - span.left );
+
+		area.left = std::min( area.left,span.left );
+		area.right = std::max( area.right,span.right );
+		area.top = std::min( area.top,span.y );
+		area.bottom = std::max( area.bottom,span.y + 1 );
+	}
+	MarkDirty( area );
+}
+
+void Surface::CopySpans( const std::vector<Span>& spans,const Surface& src,
+	const Vei2& srcPos )
+{
+	if( spans.empty() ) return;
+
+	RectI area = { width,0,height,0 };
+	for( const auto& span : spans )
+	{
+		assert( span.y >= 0 && span.y < height );
+		assert( span.left >= 0 && span.right <= width );
+		const int srcY = span.y - srcPos.y;
+		assert( srcY >= 0 && srcY < src.height );
+		assert( span.left - srcPos.x >= 0 && span.right - srcPos.x <= src.width );
+		const auto* srcRow = src.pixels.data() + srcY * src.width - srcPos.x;
+		const size_t first = size_t( span.y ) * width + span.left;
+		Count( first,span.right - span.left,-1 );
+		std::copy( srcRow + span.left,srcRow + span.right,
+			pixels.data() + first );
+		Count( first,span.right - span.left,1 );
+
+		area.left = std::min( area.left,span.left );
+		area.right = std::max( area.right,span.right );
+		area.top = std::min( area.top,span.y );
+		area.bottom = std::max( area.bottom,span.y + 1 );
+	}
+	MarkDirty( area );
+}
+
+int Surface::ReplaceColor( const std::vector<Span>& spans,Color from,Color to,
+	int tolerance )
+{
+	if( spans.empty() || ( tolerance == 0 && from == to ) ) return( 0 );
+
+	size_t nPixels = 0u;
+	RectI area = { width,0,height,0 };
+	for( const auto& span : spans )
+	{
+		assert( span.y >= 0 && span.y < height );
+		assert( span.left >= 0 && span.right <= width );
+		nPixels += size_t( span.right - span.left );
+		area.left = std::min( area.left,span.left );
+		area.right = std::max( area.right,span.right );
+		area.top = std::min( area.top,span.y );
+		area.bottom = std::max( area.bottom,span.y + 1 );
+	}
+
+	// Spans never overlap so every band owns its pixels.
+	constexpr size_t minBandPixels = size_t( 1 ) << 16;
+	const int nBands = std::max( 1,std::min( int( std::thread::hardware_concurrency() ),
+		int( nPixels / minBandPixels ) ) );
+	std::vector<int> changed( nBands,0 );
+	// Near matches could have come from any number of colors, so with
+	//  counts to keep up each band goes a run at a time and notes what it
+	//  took out.
+	const bool countRuns = histogram && tolerance > 0;
+	std::vector<std::unordered_map<unsigned int,int>> removed( countRuns ? nBands : 0 );
+	const auto replaceBand = [&]( int band )
+	{
+		const size_t first = spans.size() * band / nBands;
+		const size_t last = spans.size() * ( band + 1 ) / nBands;
+		for( size_t i = first; i < last; ++i )
+		{
+			Color* const dst = pixels.data() + size_t( spans[i].y ) * width +
+				spans[i].left;
+			const int n = spans[i].right - spans[i].left;
+			if( !countRuns )
+			{
+				changed[band] += Blend::ReplaceSpan( dst,n,from,to,tolerance );
+				continue;
+			}
+			for( int x = 0; x < n; )
+			{
+				int end = x + 1;
+				while( end < n && dst[end] == dst[x] ) ++end;
+				const Color c = dst[x];
+				if( c != to && Blend::IsNear( c,from,tolerance ) )
+				{
+					std::fill( dst + x,dst + end,to );
+					removed[band][c.dword] += end - x;
+					changed[band] += end - x;
+				}
+				x = end;
+			}
+		}
+	};
+	std::vector<std::thread> workers;
+	for( int i = 1; i < nBands; ++i ) workers.emplace_back( replaceBand,i );
+	replaceBand( 0 );
+	for( auto& worker : workers ) worker.join();
+
+	int total = 0;
+	for( const int n : changed ) total += n;
+	if( total == 0 ) return( 0 );
+
+	// Exact matches all came from one color.
+	if( histogram )
+	{
+		if( tolerance == 0 ) histogram->Add( from,-total );
+		for( const auto& counts : removed )
+		{
+			for( const auto& count : counts )
+			{
+				histogram->Add( Color{ count.first },-count.second );
+			}
 		}
+		histogram->Add( to,total );
 	}
+	MarkDirty( area );
+	return( total );
+}
+
+void Surface::SetHistogram( ColorHistogram* histogram,bool counted )
+{
+	this->histogram = histogram;
+	if( !counted ) Recount();
+}
+
+unsigned int Surface::GetVersion() const
+{
+	return( version );
+}
+
+const RectI& Surface::GetDirtyRect() const
+{
+	return( dirtyRect );
+}
+
+bool Surface::IsDirty() const
+{
+	return( dirtyRect.GetWidth() > 0 && dirtyRect.GetHeight() > 0 );
+}
+
+void Surface::ClearDirty()
+{
+	dirtyRect = RectI{ 0,0,0,0 };
 }
 
 Color Surface::GetPixel( int x,int y ) const
@@ -404,6 +761,44 @@ Surface Surface::GetInterpolatedTo( int width,int height ) const
 	return newImage;
 }
 
+Surface Surface::GetDownscaledTo( int width,int height,Color chroma ) const
+{
+	typedef unsigned char uchar;
+	Surface newImage = Surface( width,height );
+	for( int y = 0; y < height; ++y )
+	{
+		const int top = y * this->height / height;
+		const int bot = std::max( top + 1,( y + 1 ) * this->height / height );
+		for( int x = 0; x < width; ++x )
+		{
+			const int left = x * this->width / width;
+			const int right = std::max( left + 1,( x + 1 ) * this->width / width );
+
+			unsigned int r = 0;
+			unsigned int g = 0;
+			unsigned int b = 0;
+			unsigned int count = 0;
+			for( int sy = top; sy < bot; ++sy )
+			{
+				const Color* row = &pixels[sy * this->width];
+				for( int sx = left; sx < right; ++sx )
+				{
+					// Keyed pixels aren't there, they'd tint edges pink.
+					if( row[sx] == chroma ) continue;
+					r += row[sx].GetR();
+					g += row[sx].GetG();
+					b += row[sx].GetB();
+					++count;
+				}
+			}
+			if( count == 0 ) newImage.PutPixel( x,y,chroma );
+			else newImage.PutPixel( x,y,Colors::MakeRGB( uchar( r / count ),
+				uchar( g / count ),uchar( b / count ) ) );
+		}
+	}
+	return( newImage );
+}
+
 Surface Surface::GetXReversed() const
 {
 	Surface flipped = Surface{ width,height };
@@ -480,3 +875,51 @@ const std::vector<Color>& Surface::GetRawPixelData() const
 {
 	return( pixels );
 }
+
+void Surface::SetPixel( int x,int y,Color c )
+{
+	assert( x >= 0 );
+	assert( x < width );
+	assert( y >= 0 );
+	assert( y < height );
+	if( histogram ) histogram->Replace( pixels.data()[y * width + x],c );
+	pixels.data()[y * width + x] = c;
+}
+
+void Surface::MarkDirty( const RectI& area )
+{
+	const int left = std::max( 0,area.left );
+	const int right = std::min( width,area.right );
+	const int top = std::max( 0,area.top );
+	const int bottom = std::min( height,area.bottom );
+	if( left >= right || top >= bottom ) return;
+
+	++version;
+	if( !IsDirty() ) dirtyRect = RectI{ left,right,top,bottom };
+	else
+	{
+		dirtyRect.left = std::min( dirtyRect.left,left );
+		dirtyRect.right = std::max( dirtyRect.right,right );
+		dirtyRect.top = std::min( dirtyRect.top,top );
+		dirtyRect.bottom = std::max( dirtyRect.bottom,bottom );
+	}
+}
+
+void Surface::Count( size_t first,size_t n,int sign )
+{
+	if( !histogram ) return;
+
+	const Color* pix = pixels.data() + first;
+	for( size_t i = 0; i < n; )
+	{
+		size_t end = i + 1;
+		while( end < n && pix[end] == pix[i] ) ++end;
+		histogram->Add( pix[i],sign * int( end - i ) );
+		i = end;
+	}
+}
+
+void Surface::Recount()
+{
+	if( histogram ) histogram->Rebuild( *this );
+}
\ No newline at end of file
@@ -4,9 +4,20 @@
 #include <string>
 #include "Rect.h"
 #include <vector>
+#include "Blend.h"
+
+class ColorHistogram;
 
 class Surface
 {
+public:
+	// Pixels on row y from left up to but not including right.
+	struct Span
+	{
+		int y;
+		int left;
+		int right;
+	};
 public:
 	// Create blank surface with width and height.
 	Surface( int width,int height );
@@ -20,8 +31,9 @@ public:
 	Surface( const Surface& other,bool xFlipped,bool yFlipped );
 public:
 
-	Surface( const Surface& ) = default;
-	Surface& operator=( const Surface& ) = default;
+	// Copies don't get the histogram, see SetHistogram.
+	Surface( const Surface& other );
+	Surface& operator=( const Surface& rhs );
 
 	Surface( Surface&& donor );
 	Surface& operator=( Surface&& rhs );
@@ -34,9 +46,51 @@ public:
 	// Copies other surf's pixels into my magenta pixels.
 	void LightCopyInto( const Surface& other );
 	void LightCopyIntoPos( const Surface& other,const Vei2& pos );
+	// Copies width * height pixels from a raw buffer with no padding.
+	void CopyFrom( const Color* src );
+	// Same but src is 8 bit indices into a 256 color lut.
+	void CopyFrom( const unsigned char* src,const Color* lut );
+	// Blends other's non magenta pixels over my premultiplied pixels.
+	void BlendInto( const Surface& other,BlendMode mode,unsigned char opacity );
+	// Puts other's premultiplied pixels under my premultiplied pixels.
+	void BlendUnder( const Surface& other );
+	// Turns premultiplied pixels back into chroma keyed ones, pixels with
+	//  less alpha than minAlpha become chroma and the rest opaque.
+	void Unpremultiply( Color chroma,unsigned char minAlpha = 1u );
+	// Alpha every premultiplied pixel that isn't fully clear shares, 0 if
+	//  they're all clear and -1 if they differ.
+	int GetUniformAlpha() const;
 	void Resize( const Vei2& newSize );
 	// Copies other surf into this one at specified pos.
 	void CopyIntoPos( const Surface& other,const Vei2& pos );
+	// Copies area of other into the same area of this one.
+	void CopyRect( const Surface& other,const RectI& area );
+	// Fills every span with c and marks the area they cover once, spans
+	//  have to be inside the surface.
+	void FillSpans( const std::vector<Span>& spans,Color c );
+	// Copies spans from src placed with its top left at srcPos, marks the
+	//  area once.  Spans have to be inside both surfaces.
+	void CopySpans( const std::vector<Span>& spans,const Surface& src,
+		const Vei2& srcPos );
+	// Sets pixels in spans that are near from to to, see Blend::IsNear,
+	//  and marks the area once.  Big jobs get split into bands of spans
+	//  across threads.  Returns how many pixels changed.
+	int ReplaceColor( const std::vector<Span>& spans,Color from,Color to,
+		int tolerance );
+
+	// Every write after this updates histogram's counts, which get
+	//  rebuilt from the current pixels now unless counted says they
+	//  already match them.  nullptr stops the updates and leaves the counts
+	//  alone.  histogram has to outlive the attachment.
+	void SetHistogram( ColorHistogram* histogram,bool counted = false );
+
+	// Goes up on every write, save it and compare later to tell if
+	//  anything changed without looking at the pixels.
+	unsigned int GetVersion() const;
+	// Area written to since the last ClearDirty.
+	const RectI& GetDirtyRect() const;
+	bool IsDirty() const;
+	void ClearDirty();
 
 	Color GetPixel( int x,int y ) const;
 	int GetWidth() const;
@@ -49,6 +103,11 @@ public:
 	Surface GetExpandedBy( const Vei2& amount ) const;
 	// Bilinearly interpolate a surface to be width wide and height high.
 	Surface GetInterpolatedTo( int width,int height ) const;
+	// Box filter a surface down to width by height, cheaper than
+	//  interpolating when shrinking by a lot.  Boxes average their
+	//  pixels that aren't chroma, or are chroma if all of them are.
+	Surface GetDownscaledTo( int width,int height,
+		Color chroma = Colors::Magenta ) const;
 	// Get a surface flipped over the y axis.
 	Surface GetXReversed() const;
 	// Get a surface flipped over the x axis.
@@ -62,7 +121,7 @@ public:
 
 	bool operator!=( const Surface& rhs ) const
 	{
-		if( width != rhs.width || height != rhs.height ) return( false );
+		if( width != rhs.width || height != rhs.height ) return( true );
 
 		for( int i = 0; i < int( pixels.size() ); ++i )
 		{
@@ -73,8 +132,20 @@ public:
 		}
 		return( false );
 	}
+private:
+	// Writes without bumping version, for loops that mark their whole
+	//  area once when they're done.
+	void SetPixel( int x,int y,Color c );
+	void MarkDirty( const RectI& area );
+	// Adds sign times the n pixels starting at first to the histogram.
+	void Count( size_t first,size_t n,int sign );
+	// Whole surface got replaced, counting pixel by pixel isn't worth it.
+	void Recount();
 private:
 	std::vector<Color> pixels;
 	int width;
 	int height;
+	unsigned int version = 0u;
+	RectI dirtyRect = { 0,0,0,0 };
+	ColorHistogram* histogram = nullptr;
 };
\ No newline at end of file
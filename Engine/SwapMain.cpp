@@ -0,0 +1,29 @@
+#include "PaletteSwap.h"
+#include "FrameTimer.h"
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+// Writes palette swapped variants of a folder of sprites, see PaletteSwap
+//  for the mapping file.  Usage: AescSwap <mapping> <in dir> <out dir>
+int main( int argc,char* argv[] )
+{
+	if( argc < 4 )
+	{
+		std::cerr << "usage: AescSwap <mapping> <in dir> <out dir>" << std::endl;
+		return( 1 );
+	}
+	if( !std::filesystem::is_regular_file( argv[1] ) ||
+		!std::filesystem::is_directory( argv[2] ) )
+	{
+		std::cerr << "can't read " << argv[1] << " or " << argv[2] << std::endl;
+		return( 1 );
+	}
+
+	const PaletteSwap palSwap = { std::string( argv[1] ) };
+	FrameTimer ft;
+	const int nFiles = palSwap.ApplyToFolder( argv[2],argv[3] );
+	std::cout << nFiles << " files, " << palSwap.GetVariantCount() <<
+		" variants each, " << ft.Mark() * 1000.0f << " ms" << std::endl;
+	return( 0 );
+}
\ No newline at end of file
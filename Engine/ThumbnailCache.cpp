@@ -0,0 +1,154 @@
+#include "ThumbnailCache.h"
+#include <algorithm>
+#include <cassert>
+
+ThumbnailCache::ThumbnailCache()
+	:
+	worker( &ThumbnailCache::Work,this )
+{}
+
+ThumbnailCache::~ThumbnailCache()
+{
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+		quitting = true;
+	}
+	cvJob.notify_all();
+	worker.join();
+}
+
+void ThumbnailCache::Add( int id )
+{
+	assert( slots.count( id ) == 0 );
+	slots.emplace( id,Slot{} );
+}
+
+void ThumbnailCache::Remove( int id )
+{
+	assert( slots.count( id ) == 1 );
+	slots.erase( id );
+}
+
+void ThumbnailCache::Invalidate( int id )
+{
+	auto& slot = slots.at( id );
+	++slot.version;
+	slot.dirty = true;
+}
+
+void ThumbnailCache::InvalidateAll()
+{
+	for( auto& slot : slots )
+	{
+		++slot.second.version;
+		slot.second.dirty = true;
+	}
+}
+
+bool ThumbnailCache::Update( const std::vector<std::pair<int,const Surface*>>& visible )
+{
+	std::vector<Job> finished;
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+		finished.swap( results );
+	}
+
+	bool changed = false;
+	for( auto& result : finished )
+	{
+		const auto slot = slots.find( result.id );
+		// Layer got deleted while its thumbnail was being made.
+		if( slot == slots.end() ) continue;
+
+		slot->second.thumb = std::move( result.src );
+		slot->second.inFlight = false;
+		// Still dirty if the layer changed again since the job went out.
+		if( slot->second.version == result.version ) slot->second.dirty = false;
+		changed = true;
+	}
+
+	for( auto& slot : slots ) slot.second.visible = false;
+
+	// Only one job per slot at a time, layers that keep changing just
+	//  get picked up again when the last one finishes.
+	bool queued = false;
+	for( const auto& layer : visible )
+	{
+		auto& slot = slots.at( layer.first );
+		slot.visible = true;
+		if( slot.dirty && !slot.inFlight )
+		{
+			std::lock_guard<std::mutex> lock( mutex );
+			jobs.emplace_back( Job{ layer.first,slot.version,*layer.second } );
+			slot.inFlight = true;
+			queued = true;
+		}
+	}
+	if( queued ) cvJob.notify_one();
+
+	return( changed );
+}
+
+bool ThumbnailCache::NeedsSource( int id ) const
+{
+	return( slots.at( id ).dirty );
+}
+
+const Surface& ThumbnailCache::Get( int id ) const
+{
+	return( slots.at( id ).thumb );
+}
+
+bool ThumbnailCache::IsBusy() const
+{
+	for( const auto& slot : slots )
+	{
+		if( slot.second.dirty &&
+			( slot.second.visible || slot.second.inFlight ) )
+		{
+			return( true );
+		}
+	}
+	return( false );
+}
+
+void ThumbnailCache::Work()
+{
+	std::unique_lock<std::mutex> lock( mutex );
+	while( true )
+	{
+		cvJob.wait( lock,[this] { return( quitting || !jobs.empty() ); } );
+		if( quitting ) return;
+
+		auto job = std::move( jobs.front() );
+		jobs.erase( jobs.begin() );
+
+		// Don't hold the lock while downscaling.
+		lock.unlock();
+		job.src = MakeThumbnail( job.src );
+		lock.lock();
+
+		results.emplace_back( std::move( job ) );
+	}
+}
+
+Surface ThumbnailCache::MakeThumbnail( const Surface& layer )
+{
+	if( layer.GetWidth() == 0 || layer.GetHeight() == 0 )
+	{
+		return( Surface{ 0,0 } );
+	}
+
+	const float ratio = float( layer.GetWidth() ) /
+		float( layer.GetHeight() );
+	float width = ratio * float( thumbHeight );
+	float height = float( thumbHeight );
+	if( width > float( maxThumbWidth ) )
+	{
+		width = float( maxThumbWidth );
+		height = width / ratio;
+	}
+
+	return( layer.GetDownscaledTo( std::max( 1,int( width ) ),
+		std::max( 1,int( height ) ) ) );
+}
\ No newline at end of file
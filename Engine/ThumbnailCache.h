@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Surface.h"
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+// Layer preview thumbnails, rebuilt on a worker thread only when their
+//  layer changes.  Slots are keyed by layer id, so add and remove them
+//  alongside the layers.
+class ThumbnailCache
+{
+public:
+	ThumbnailCache();
+	~ThumbnailCache();
+	ThumbnailCache( const ThumbnailCache& ) = delete;
+	ThumbnailCache& operator=( const ThumbnailCache& ) = delete;
+
+	void Add( int id );
+	void Remove( int id );
+	// Mark layer's thumbnail as out of date.
+	void Invalidate( int id );
+	void InvalidateAll();
+	// Picks up finished thumbnails and hands the dirty ones among visible
+	//  layers to the worker, others wait until they're scrolled into view.
+	//  Returns true if any thumbnail changed.
+	bool Update( const std::vector<std::pair<int,const Surface*>>& visible );
+	// True if id's thumbnail is out of date, so Update might want its pixels.
+	bool NeedsSource( int id ) const;
+	// Latest finished thumbnail, might be empty or a bit stale.
+	const Surface& Get( int id ) const;
+	// True while visible thumbnails are still being rebuilt.
+	bool IsBusy() const;
+private:
+	void Work();
+	static Surface MakeThumbnail( const Surface& layer );
+private:
+	static constexpr int thumbHeight = 18;
+	static constexpr int maxThumbWidth = 25 * 3;
+
+	struct Slot
+	{
+		unsigned int version = 0u;
+		bool dirty = true;
+		bool inFlight = false;
+		bool visible = false;
+		Surface thumb = { 0,0 };
+	};
+	// Jobs and results find their slot by id since the layer might be gone
+	//  by the time the worker is done.
+	struct Job
+	{
+		int id;
+		unsigned int version;
+		Surface src;
+	};
+	std::unordered_map<int,Slot> slots;
+
+	std::mutex mutex;
+	std::condition_variable cvJob;
+	std::vector<Job> jobs;
+	std::vector<Job> results;
+	bool quitting = false;
+	std::thread worker;
+};
\ No newline at end of file
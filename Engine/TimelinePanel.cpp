@@ -0,0 +1,157 @@
+#include "TimelinePanel.h"
+#include <algorithm>
+#include <limits>
+
+TimelinePanel::TimelinePanel( const RectI& area )
+	:
+	area( area )
+{}
+
+void TimelinePanel::Update( const Mouse& mouse,const Keyboard& kbd,
+	ImageHandler& imgHand )
+{
+	const bool alt = kbd.KeyIsPressed( VK_MENU );
+	const int nFrames = imgHand.GetFrameCount();
+	int target = imgHand.GetCurFrame();
+
+	const bool prev = kbd.KeyIsPressed( VK_OEM_COMMA );
+	const bool next = kbd.KeyIsPressed( VK_OEM_PERIOD );
+	if( prev || next )
+	{
+		if( canStep )
+		{
+			if( alt )
+			{
+				const float duration = imgHand.GetFrameDuration( target ) +
+					( next ? durationStep : -durationStep );
+				imgHand.SetFrameDuration( target,
+					std::min( maxDuration,std::max( minDuration,duration ) ) );
+			}
+			else target = ( target + ( next ? 1 : nFrames - 1 ) ) % nFrames;
+		}
+		canStep = false;
+	}
+	else canStep = true;
+
+	if( alt && kbd.KeyIsPressed( 'N' ) )
+	{
+		if( canAddFrame )
+		{
+			imgHand.DuplicateFrame();
+			target = imgHand.GetCurFrame();
+		}
+		canAddFrame = false;
+	}
+	else canAddFrame = true;
+
+	if( alt && kbd.KeyIsPressed( 'K' ) )
+	{
+		if( canDeleteFrame )
+		{
+			imgHand.DeleteFrame();
+			target = imgHand.GetCurFrame();
+		}
+		canDeleteFrame = false;
+	}
+	else canDeleteFrame = true;
+
+	if( kbd.KeyIsPressed( VK_RETURN ) )
+	{
+		if( canPlay )
+		{
+			playing = !playing;
+			playTimer.Mark();
+			shownFor = 0.0f;
+		}
+		canPlay = false;
+	}
+	else canPlay = true;
+
+	if( alt && kbd.KeyIsPressed( 'O' ) )
+	{
+		if( canCycleOnion )
+		{
+			imgHand.SetOnionRange( ( imgHand.GetOnionRange() + 1 ) %
+				( maxOnionRange + 1 ) );
+		}
+		canCycleOnion = false;
+	}
+	else canCycleOnion = true;
+
+	hovered = GetCellAt( mouse.GetPos() );
+	if( hovered != -1 && mouse.LeftIsPressed() ) target = hovered;
+
+	// Slow frames skip ahead instead of falling behind.
+	if( playing )
+	{
+		shownFor += playTimer.Mark();
+		while( shownFor >= imgHand.GetFrameDuration( target ) )
+		{
+			shownFor -= imgHand.GetFrameDuration( target );
+			target = ( target + 1 ) % imgHand.GetFrameCount();
+		}
+	}
+	if( target != imgHand.GetCurFrame() ) imgHand.SelectFrame( target );
+
+	durations.clear();
+	for( int i = 0; i < imgHand.GetFrameCount(); ++i )
+	{
+		durations.emplace_back( imgHand.GetFrameDuration( i ) );
+	}
+	curFrame = imgHand.GetCurFrame();
+	// Keep the current frame in view.
+	if( curFrame < scroll ) scroll = curFrame;
+	else if( curFrame >= scroll + GetVisibleCells() )
+	{
+		scroll = curFrame - GetVisibleCells() + 1;
+	}
+	scroll = std::max( 0,std::min( scroll,int( durations.size() ) - GetVisibleCells() ) );
+}
+
+void TimelinePanel::Draw( Graphics& gfx ) const
+{
+	gfx.DrawRect( area.left,area.top,area.GetWidth(),area.GetHeight(),
+		Colors::DarkGray );
+
+	const int maxHeight = area.GetHeight() - padding * 2;
+	const int last = std::min( int( durations.size() ),scroll + GetVisibleCells() );
+	for( int i = scroll; i < last; ++i )
+	{
+		const int height = std::max( 2,int( float( maxHeight ) *
+			std::min( 1.0f,durations[i] / maxDuration ) ) );
+		const Color c = i == curFrame ? Colors::White
+			: i == hovered ? Colors::LightGray : Colors::Gray;
+		gfx.DrawRect( area.left + padding + ( i - scroll ) * cellStep,
+			area.bottom - padding - height,cellWidth,height,c );
+	}
+}
+
+bool TimelinePanel::IsPlaying() const
+{
+	return( playing );
+}
+
+float TimelinePanel::GetTimeLeft() const
+{
+	if( !playing || durations.empty() ) return( std::numeric_limits<float>::max() );
+	return( durations[curFrame] - shownFor - playTimer.Peek() );
+}
+
+int TimelinePanel::GetCellAt( const Vei2& pos ) const
+{
+	if( !area.ContainsPoint( pos ) || pos.x < area.left + padding ) return( -1 );
+
+	const int rel = pos.x - area.left - padding;
+	const int frame = scroll + rel / cellStep;
+	if( rel % cellStep >= cellWidth || frame >= scroll + GetVisibleCells() ||
+		frame >= int( durations.size() ) )
+	{
+		return( -1 );
+	}
+	return( frame );
+}
+
+int TimelinePanel::GetVisibleCells() const
+{
+	return( std::max( 1,( area.GetWidth() - padding * 2 + cellStep - cellWidth ) / cellStep ) );
+}
\ No newline at end of file
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Graphics.h"
+#include "Mouse.h"
+#include "Keyboard.h"
+#include "Rect.h"
+#include "FrameTimer.h"
+#include "ImageHandler.h"
+#include <vector>
+
+// A cell per animation frame, taller for frames that stay up longer.
+//  Click a cell or use comma and period to move between frames, enter
+//  plays them.  Alt+N adds a copy of the current frame, Alt+K deletes it
+//  and alt with comma or period makes it shorter or longer.  Alt+O steps
+//  through how many onion skin frames show on each side.
+class TimelinePanel
+{
+public:
+	TimelinePanel( const RectI& area );
+
+	void Update( const Mouse& mouse,const Keyboard& kbd,ImageHandler& imgHand );
+	void Draw( Graphics& gfx ) const;
+	bool IsPlaying() const;
+	// Seconds until playing moves to the next frame, very large if it
+	//  isn't playing.
+	float GetTimeLeft() const;
+private:
+	// Frame under pos or -1.
+	int GetCellAt( const Vei2& pos ) const;
+	int GetVisibleCells() const;
+private:
+	const RectI area;
+	static constexpr int padding = 4;
+	static constexpr int cellWidth = 8;
+	static constexpr int cellStep = cellWidth + 2;
+	// Seconds, cells are full height at maxDuration.
+	static constexpr float durationStep = 0.02f;
+	static constexpr float minDuration = 0.02f;
+	static constexpr float maxDuration = 1.0f;
+	static constexpr int maxOnionRange = 3;
+
+	std::vector<float> durations;
+	int curFrame = 0;
+	// First frame shown.
+	int scroll = 0;
+	int hovered = -1;
+
+	bool playing = false;
+	FrameTimer playTimer;
+	// Time the current frame has been up while playing.
+	float shownFor = 0.0f;
+
+	bool canStep = false;
+	bool canAddFrame = false;
+	bool canDeleteFrame = false;
+	bool canPlay = false;
+	bool canCycleOnion = false;
+};
\ No newline at end of file
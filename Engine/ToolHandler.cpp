@@ -22,6 +22,8 @@ void ToolHandler::Update( const Mouse& mouse,
 		if( kbd.KeyIsPressed( 'R' ) ) tool = ToolMode::Ruler;
 		if( kbd.KeyIsPressed( 'M' ) ) tool = ToolMode::Selector;
 		if( kbd.KeyIsPressed( 'V' ) ) tool = ToolMode::Pointer;
+		if( kbd.KeyIsPressed( 'L' ) ) tool = ToolMode::Lasso;
+		if( kbd.KeyIsPressed( 'W' ) ) tool = ToolMode::Wand;
 	}
 
 	if( kbd.KeyIsPressed( 'X' ) )
@@ -51,6 +53,8 @@ void ToolHandler::Update( const Mouse& mouse,
 	if( ruler.Update( mouse ) ) tool = ToolMode::Ruler;
 	if( selector.Update( mouse ) ) tool = ToolMode::Selector;
 	if( pointer.Update( mouse ) ) tool = ToolMode::Pointer;
+	if( lasso.Update( mouse ) ) tool = ToolMode::Lasso;
+	if( wand.Update( mouse ) ) tool = ToolMode::Wand;
 }
 
 void ToolHandler::Draw( Graphics& gfx ) const
@@ -68,6 +72,8 @@ void ToolHandler::Draw( Graphics& gfx ) const
 	ruler.Draw( gfx );
 	selector.Draw( gfx );
 	pointer.Draw( gfx );
+	lasso.Draw( gfx );
+	wand.Draw( gfx );
 }
 
 const Surface& ToolHandler::GetToolSurf( ToolMode tool ) const
@@ -94,6 +100,10 @@ const Surface& ToolHandler::GetToolSurf( ToolMode tool ) const
 		return( selectorImg );
 	case ToolMode::Pointer:
 		return( pointerImg );
+	case ToolMode::Lasso:
+		return( lassoImg );
+	case ToolMode::Wand:
+		return( wandImg );
 	default:
 		assert( false );
 		return( brushImg );
@@ -31,6 +31,8 @@ private:
 	const Surface rulerImg = { { "Icons/Ruler.bmp" },Vei2{ 3,3 } };
 	const Surface selectorImg = { { "Icons/Selector.bmp" },Vei2{ 3,3 } };
 	const Surface pointerImg = { { "Icons/Pointer.bmp" },Vei2{ 3,3 } };
+	const Surface lassoImg = { { "Icons/Lasso.bmp" },Vei2{ 3,3 } };
+	const Surface wandImg = { { "Icons/Wand.bmp" },Vei2{ 3,3 } };
 	// Buttons and stuff can go here I guess.
 	Button brush = { brushImg,Vei2{ 55 + 50 * 1,1 } };
 	Button eraser = { eraserImg,Vei2{ 55 + 50 * 2,1 } };
@@ -42,4 +44,6 @@ private:
 	Button ruler = { rulerImg,Vei2{ 55 + 50 * 8,1 } };
 	Button selector = { selectorImg,Vei2{ 55 + 50 * 9,1 } };
 	Button pointer = { pointerImg,Vei2{ 55 + 50 * 10,1 } };
+	Button lasso = { lassoImg,Vei2{ 55 + 50 * 11,1 } };
+	Button wand = { wandImg,Vei2{ 55 + 50 * 12,1 } };
 };
\ No newline at end of file
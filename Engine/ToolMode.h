@@ -11,5 +11,7 @@ enum class ToolMode
 	Bucket,
 	Sampler,
 	Resizer,
-	Ruler
+	Ruler,
+	Lasso,
+	Wand
 };
\ No newline at end of file
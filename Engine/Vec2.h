@@ -78,6 +78,14 @@ public:
 	{
 		return( Vec2_{ -x,-y } );
 	}
+	constexpr bool operator==( const Vec2_& rhs ) const
+	{
+		return( x == rhs.x && y == rhs.y );
+	}
+	constexpr bool operator!=( const Vec2_& rhs ) const
+	{
+		return( !( *this == rhs ) );
+	}
 
 	constexpr T GetLength() const
 	{
@@ -0,0 +1,11 @@
+#pragma once
+
+// Lets a thread of its own get the main loop out of its idle sleep
+//  without knowing about the window behind it.
+class Wakeup
+{
+public:
+	virtual ~Wakeup() = default;
+	// Safe to call from any thread.
+	virtual void Wake() = 0;
+};
\ No newline at end of file
@@ -54,6 +54,59 @@ void WriteToBitmap::Write( const Surface& data,
 	}
 }
 
+void WriteToBitmap::Write( const IndexedSurface& data,const ColorTable& table,
+	const std::string& name )
+{
+	std::ofstream out{ name,std::ios::out | std::ios::binary };
+	assert( out.good() );
+
+	const int nColors = table.GetCount();
+	const int paddingSize = ( 4 - data.GetWidth() % 4 ) % 4;
+	const int pixelStart = 14 + 40 + nColors * 4;
+	const int size = pixelStart +
+		( data.GetWidth() + paddingSize ) * data.GetHeight();
+
+	out.put( 'B' );
+	out.put( 'M' );
+	PutInt( out,size ); // Total file size.
+	PutShort( out,0 );
+	PutShort( out,0 );
+	PutInt( out,pixelStart ); // Starting address of pixel array.
+
+	// DIB header.
+	PutInt( out,40 );
+	PutInt( out,data.GetWidth() );
+	PutInt( out,data.GetHeight() );
+	PutShort( out,1 ); // Number of planes.
+	PutShort( out,8 ); // Number of bits per pixel.
+	PutInt( out,0 ); // Compression.
+	PutInt( out,0 ); // Size of raw pixel data.
+	PutInt( out,0 ); // Pixel per meter BS.
+	PutInt( out,0 );
+	PutInt( out,nColors ); // Number of colors in palette.
+	PutInt( out,0 ); // Important colors.
+
+	// Palette as bgr plus a zero byte.
+	for( int i = 0; i < nColors; ++i )
+	{
+		const auto c = table.GetColor( static_cast<unsigned char>( i ) );
+		out.put( c.GetB() );
+		out.put( c.GetG() );
+		out.put( c.GetR() );
+		out.put( 0 );
+	}
+
+	for( int y = data.GetHeight() - 1; y >= 0; --y )
+	{
+		const auto row = data.GetRawIndices().data() + y * data.GetWidth();
+		out.write( reinterpret_cast<const char*>( row ),data.GetWidth() );
+		for( int i = 0; i < paddingSize; ++i )
+		{
+			out.put( 0 );
+		}
+	}
+}
+
 void WriteToBitmap::PutShort( std::ofstream& out,uint v )
 {
 	out.put( ( v >> 0 ) & 0xFF );
@@ -2,6 +2,7 @@
 
 #include <string>
 #include "Surface.h"
+#include "IndexedSurface.h"
 
 // Used this video to make this:
 //  https://www.youtube.com/watch?v=ldsdJqGr9uc
@@ -12,6 +13,9 @@ private:
 public:
 	static void Write( const Surface& data,
 		const std::string& name );
+	// 8 bit bitmap with table's colors as its palette.
+	static void Write( const IndexedSurface& data,const ColorTable& table,
+		const std::string& name );
 private:
 	static void PutShort( std::ofstream& out,uint v );
 	static void PutInt( std::ofstream& out,uint v );
@@ -0,0 +1,413 @@
+#include "WriteToGif.h"
+#include "Quantize.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <fstream>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+void WriteToGif::Write( const std::vector<Surface>& frames,
+	const std::vector<float>& delays,const std::string& name,
+	PaletteMode mode,DitherMode dither )
+{
+	assert( !frames.empty() && frames.size() == delays.size() );
+
+	std::vector<ColorTable> tables;
+	if( mode == PaletteMode::Global )
+	{
+		std::vector<const Surface*> all;
+		for( const auto& frame : frames ) all.emplace_back( &frame );
+		tables.emplace_back( MakeTable( all ) );
+	}
+	else tables.resize( frames.size() );
+
+	std::vector<IndexedSurface> indexed( frames.size(),IndexedSurface{ 0,0 } );
+	std::unique_ptr<ColorLookup> shared;
+	if( mode == PaletteMode::Global ) shared = std::make_unique<ColorLookup>( tables[0] );
+	ForEach( int( frames.size() ),[&]( int i )
+	{
+		if( mode == PaletteMode::Global )
+		{
+			indexed[i] = shared->Remap( frames[i],dither );
+		}
+		else
+		{
+			tables[i] = MakeTable( { &frames[i] } );
+			indexed[i] = ColorLookup{ tables[i] }.Remap( frames[i],dither );
+		}
+	} );
+	Write( indexed,tables,delays,name );
+}
+
+void WriteToGif::Write( const std::vector<Surface>& frames,
+	const std::vector<float>& delays,const ColorTable& table,
+	const std::string& name )
+{
+	assert( !frames.empty() && frames.size() == delays.size() );
+
+	const ColorLookup lookup = { table };
+	std::vector<IndexedSurface> indexed( frames.size(),IndexedSurface{ 0,0 } );
+	ForEach( int( frames.size() ),[&]( int i )
+	{
+		indexed[i] = lookup.Remap( frames[i],DitherMode::None );
+	} );
+	Write( indexed,{ table },delays,name );
+}
+
+void WriteToGif::Write( const std::vector<IndexedSurface>& frames,
+	const std::vector<ColorTable>& tables,const std::vector<float>& delays,
+	const std::string& name )
+{
+	const int width = frames[0].GetWidth();
+	const int height = frames[0].GetHeight();
+	const bool global = tables.size() == 1u;
+	const auto tableOf = [&]( int i ) -> const ColorTable&
+	{
+		return( tables[global ? 0 : i] );
+	};
+
+	// What goes into the file for each frame.  Index 0 is transparent,
+	//  which after the first frame means leave what's there.
+	struct Plan
+	{
+		RectI rect;
+		// 1 leaves the frame up for the next one to draw over, 2 clears
+		//  its rect first.
+		int disposal;
+		int delay;
+		// Whose table the indices are into.
+		int frame;
+		std::vector<uchar> indices;
+	};
+	std::vector<Plan> plans;
+	// Colors on screen after the last planned frame, chroma where clear.
+	std::vector<Color> shown( width * height,ColorTable::chroma );
+	std::vector<Color> cur( width * height );
+	for( int i = 0; i < int( frames.size() ); ++i )
+	{
+		const auto& raw = frames[i].GetRawIndices();
+		const auto& table = tableOf( i );
+		for( int p = 0; p < width * height; ++p ) cur[p] = table.GetColor( raw[p] );
+		// Hundredths of a second, a lot of viewers treat anything under 2
+		//  as 10.
+		const int delay = std::max( 2,int( delays[i] * 100.0f + 0.5f ) );
+
+		if( plans.empty() )
+		{
+			plans.emplace_back( Plan{ RectI{ 0,width,0,height },1,delay,i,raw } );
+			shown = cur;
+			continue;
+		}
+
+		// Transparent index can't clear a pixel, so if any go clear the
+		//  last frame has to wipe its rect, grown to cover them.
+		auto& last = plans.back();
+		RectI cleared = last.rect;
+		bool clears = false;
+		for( int y = 0; y < height; ++y )
+		{
+			for( int x = 0; x < width; ++x )
+			{
+				const int p = y * width + x;
+				if( cur[p] == ColorTable::chroma && shown[p] != ColorTable::chroma )
+				{
+					cleared.left = std::min( cleared.left,x );
+					cleared.right = std::max( cleared.right,x + 1 );
+					cleared.top = std::min( cleared.top,y );
+					cleared.bottom = std::max( cleared.bottom,y + 1 );
+					clears = true;
+				}
+			}
+		}
+		if( clears )
+		{
+			last.rect = cleared;
+			last.disposal = 2;
+			for( int y = cleared.top; y < cleared.bottom; ++y )
+			{
+				std::fill( shown.begin() + y * width + cleared.left,
+					shown.begin() + y * width + cleared.right,ColorTable::chroma );
+			}
+		}
+
+		RectI changed = { width,0,height,0 };
+		std::vector<uchar> indices( width * height,0u );
+		for( int y = 0; y < height; ++y )
+		{
+			for( int x = 0; x < width; ++x )
+			{
+				const int p = y * width + x;
+				if( cur[p] == shown[p] ) continue;
+				indices[p] = raw[p];
+				changed.left = std::min( changed.left,x );
+				changed.right = std::max( changed.right,x + 1 );
+				changed.top = std::min( changed.top,y );
+				changed.bottom = std::max( changed.bottom,y + 1 );
+			}
+		}
+		// Nothing new just keeps the last frame up longer.
+		if( changed.left == width && !clears )
+		{
+			last.delay += delay;
+			continue;
+		}
+		if( changed.left == width ) changed = RectI{ 0,1,0,1 };
+		plans.emplace_back( Plan{ changed,1,delay,i,std::move( indices ) } );
+		shown = cur;
+	}
+
+	// Cropping and compressing don't depend on other frames.
+	std::vector<std::vector<uchar>> data( plans.size() );
+	std::vector<int> bits( plans.size() );
+	ForEach( int( plans.size() ),[&]( int i )
+	{
+		const auto& plan = plans[i];
+		std::vector<uchar> cropped;
+		cropped.reserve( plan.rect.GetWidth() * plan.rect.GetHeight() );
+		for( int y = plan.rect.top; y < plan.rect.bottom; ++y )
+		{
+			cropped.insert( cropped.end(),
+				plan.indices.begin() + y * width + plan.rect.left,
+				plan.indices.begin() + y * width + plan.rect.right );
+		}
+		bits[i] = GetTableBits( tableOf( plan.frame ).GetCount() );
+		data[i] = Compress( cropped,std::max( 2,bits[i] ) );
+	} );
+
+	std::ofstream out{ name,std::ios::out | std::ios::binary };
+	assert( out.good() );
+
+	out.write( "GIF89a",6 );
+	PutShort( out,width );
+	PutShort( out,height );
+	const int globalBits = GetTableBits( tables[0].GetCount() );
+	// Table flag, 8 bits per channel and how big the table is.
+	out.put( char( global ? 0xF0 | ( globalBits - 1 ) : 0x70 ) );
+	out.put( 0 ); // Background color.
+	out.put( 0 ); // Square pixels.
+	if( global ) PutTable( out,tables[0],globalBits );
+
+	// Netscape extension so it loops forever.
+	out.write( "\x21\xFF\x0BNETSCAPE2.0\x03\x01\x00\x00\x00",19 );
+
+	for( int i = 0; i < int( plans.size() ); ++i )
+	{
+		const auto& plan = plans[i];
+		// Graphic control, disposal and transparency with index 0.
+		out.write( "\x21\xF9\x04",3 );
+		out.put( char( plan.disposal << 2 | 1 ) );
+		PutShort( out,plan.delay );
+		out.put( 0 );
+		out.put( 0 );
+
+		out.put( 0x2C );
+		PutShort( out,plan.rect.left );
+		PutShort( out,plan.rect.top );
+		PutShort( out,plan.rect.GetWidth() );
+		PutShort( out,plan.rect.GetHeight() );
+		if( global ) out.put( 0 );
+		else
+		{
+			out.put( char( 0x80 | ( bits[i] - 1 ) ) );
+			PutTable( out,tableOf( plan.frame ),bits[i] );
+		}
+		out.put( char( std::max( 2,bits[i] ) ) );
+		out.write( reinterpret_cast< const char* >( data[i].data() ),
+			std::streamsize( data[i].size() ) );
+	}
+	out.put( 0x3B );
+}
+
+ColorTable WriteToGif::MakeTable( const std::vector<const Surface*>& frames )
+{
+	// One slot is the transparent index.
+	const size_t maxColors = size_t( ColorTable::maxColors - 1 );
+	std::vector<std::unordered_set<uint>> found( frames.size() );
+	std::atomic<bool> tooMany{ false };
+	ForEach( int( frames.size() ),[&]( int i )
+	{
+		uint last = ColorTable::chroma.dword;
+		for( const auto c : frames[i]->GetRawPixelData() )
+		{
+			if( c.dword == last ) continue;
+			last = c.dword;
+			if( c != ColorTable::chroma ) found[i].emplace( c.dword );
+			if( found[i].size() > maxColors || tooMany )
+			{
+				tooMany = true;
+				return;
+			}
+		}
+	} );
+
+	std::unordered_set<uint> colors;
+	for( const auto& f : found )
+	{
+		if( tooMany ) break;
+		colors.insert( f.begin(),f.end() );
+		tooMany = colors.size() > maxColors;
+	}
+	if( !tooMany )
+	{
+		std::vector<Color> exact;
+		for( const auto c : colors ) exact.emplace_back( Color{ c } );
+		// Same file every time no matter how the set got filled.
+		std::sort( exact.begin(),exact.end(),[]( Color a,Color b )
+		{
+			return( a.dword < b.dword );
+		} );
+		return( ColorTable{ exact } );
+	}
+
+	// Histogram buckets of every frame weighted back together.
+	struct Sum
+	{
+		unsigned long long r = 0u;
+		unsigned long long g = 0u;
+		unsigned long long b = 0u;
+		unsigned long long count = 0u;
+	};
+	std::unordered_map<uint,Sum> sums;
+	for( const auto* frame : frames )
+	{
+		for( const auto& e : Quantize::BuildHistogram( *frame ) )
+		{
+			auto& s = sums[( e.color.dword >> 3 ) & 0x1F1F1Fu];
+			s.r += e.color.GetR() * e.count;
+			s.g += e.color.GetG() * e.count;
+			s.b += e.color.GetB() * e.count;
+			s.count += e.count;
+		}
+	}
+	typedef unsigned char uchar;
+	std::vector<Quantize::Entry> hist;
+	for( const auto& s : sums )
+	{
+		const auto& v = s.second;
+		hist.emplace_back( Quantize::Entry{ Colors::MakeRGB(
+			uchar( v.r / v.count ),uchar( v.g / v.count ),uchar( v.b / v.count ) ),
+			unsigned( std::min( v.count,0xFFFFFFFFull ) ) } );
+	}
+	auto palette = Quantize::MedianCut( hist,int( maxColors ) );
+	Quantize::Refine( hist,palette,4 );
+	return( ColorTable{ palette } );
+}
+
+template<typename Work>
+void WriteToGif::ForEach( int count,Work work )
+{
+	// Workers just take the next one.
+	std::atomic<int> next{ 0 };
+	const auto run = [&]()
+	{
+		for( int i = next++; i < count; i = next++ ) work( i );
+	};
+	const int nWorkers = std::max( 1,std::min( int( std::thread::hardware_concurrency() ),
+		count ) );
+	std::vector<std::thread> workers;
+	for( int i = 1; i < nWorkers; ++i ) workers.emplace_back( run );
+	run();
+	for( auto& worker : workers ) worker.join();
+}
+
+int WriteToGif::GetTableBits( int count )
+{
+	int bits = 1;
+	while( ( 1 << bits ) < count ) ++bits;
+	return( bits );
+}
+
+void WriteToGif::PutTable( std::ofstream& out,const ColorTable& table,int bits )
+{
+	for( int i = 0; i < 1 << bits; ++i )
+	{
+		const Color c = i < table.GetCount() && i > 0
+			? table.GetColor( uchar( i ) ) : Colors::Black;
+		out.put( char( c.GetR() ) );
+		out.put( char( c.GetG() ) );
+		out.put( char( c.GetB() ) );
+	}
+}
+
+std::vector<unsigned char> WriteToGif::Compress( const std::vector<uchar>& indices,
+	int minCodeSize )
+{
+	const uint clearCode = 1u << minCodeSize;
+	const uint endCode = clearCode + 1u;
+	static constexpr uint maxCode = 4095u;
+
+	// Strings seen so far as prefix code and next index, open addressing
+	//  kept at most half full.  Keys are offset by 1 so 0 means empty.
+	static constexpr uint tableBits = 13u;
+	static constexpr uint tableMask = ( 1u << tableBits ) - 1u;
+	std::vector<uint> keys( 1u << tableBits );
+	std::vector<unsigned short> codes( 1u << tableBits );
+
+	std::vector<uchar> packed;
+	unsigned long long buffer = 0u;
+	int nBuffered = 0;
+	int codeSize = minCodeSize + 1;
+	const auto put = [&]( uint code )
+	{
+		buffer |= ( unsigned long long )( code ) << nBuffered;
+		nBuffered += codeSize;
+		for( ; nBuffered >= 8; nBuffered -= 8 )
+		{
+			packed.emplace_back( uchar( buffer & 0xFFu ) );
+			buffer >>= 8;
+		}
+	};
+
+	uint nextCode = endCode + 1u;
+	put( clearCode );
+	uint prefix = indices.empty() ? 0u : indices[0];
+	for( size_t i = 1; i < indices.size(); ++i )
+	{
+		const uint key = ( prefix << 8 | indices[i] ) + 1u;
+		uint slot = ( key * 2654435769u ) >> ( 32u - tableBits );
+		while( keys[slot] != 0u && keys[slot] != key ) slot = ( slot + 1u ) & tableMask;
+		if( keys[slot] == key )
+		{
+			prefix = codes[slot];
+			continue;
+		}
+
+		put( prefix );
+		keys[slot] = key;
+		codes[slot] = static_cast< unsigned short >( nextCode );
+		// Same points the decoder widens codes and starts over at.
+		if( nextCode >= ( 1u << codeSize ) ) ++codeSize;
+		if( nextCode == maxCode )
+		{
+			put( clearCode );
+			std::fill( keys.begin(),keys.end(),0u );
+			codeSize = minCodeSize + 1;
+			nextCode = endCode;
+		}
+		++nextCode;
+		prefix = indices[i];
+	}
+	if( !indices.empty() ) put( prefix );
+	put( endCode );
+	if( nBuffered > 0 ) packed.emplace_back( uchar( buffer & 0xFFu ) );
+
+	// Sub-blocks of at most 255 bytes, then an empty one to end it.
+	std::vector<uchar> blocks;
+	blocks.reserve( packed.size() + packed.size() / 255u + 2u );
+	for( size_t i = 0; i < packed.size(); i += 255u )
+	{
+		const size_t n = std::min( size_t( 255u ),packed.size() - i );
+		blocks.emplace_back( uchar( n ) );
+		blocks.insert( blocks.end(),packed.begin() + i,packed.begin() + i + n );
+	}
+	blocks.emplace_back( 0u );
+	return( blocks );
+}
+
+void WriteToGif::PutShort( std::ofstream& out,uint v )
+{
+	out.put( char( v & 0xFFu ) );
+	out.put( char( ( v >> 8 ) & 0xFFu ) );
+}
\ No newline at end of file
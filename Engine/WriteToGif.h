@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "Surface.h"
+#include "IndexedSurface.h"
+#include "ColorLookup.h"
+
+// GIF89a animations that loop forever.  After the first frame only the
+//  rect that changed gets stored, and pixels in it that stayed the same
+//  are left transparent so they compress to almost nothing.  Frames get
+//  mapped and compressed on as many threads as there are cores.
+class WriteToGif
+{
+private:
+	typedef unsigned int uint;
+	typedef unsigned char uchar;
+public:
+	enum class PaletteMode
+	{
+		// One table shared by every frame.
+		Global,
+		// A table per frame, better when frames don't share many colors.
+		PerFrame
+	};
+public:
+	// frames are chroma keyed and all the same size, delays are in
+	//  seconds.  Tables keep every color if there are 255 or fewer,
+	//  otherwise they're quantized down to that.
+	static void Write( const std::vector<Surface>& frames,
+		const std::vector<float>& delays,const std::string& name,
+		PaletteMode mode = PaletteMode::Global,
+		DitherMode dither = DitherMode::None );
+	// Every frame through table, for indexed documents.
+	static void Write( const std::vector<Surface>& frames,
+		const std::vector<float>& delays,const ColorTable& table,
+		const std::string& name );
+private:
+	// Frames mapped through tables, which has one entry or one per frame.
+	static void Write( const std::vector<IndexedSurface>& frames,
+		const std::vector<ColorTable>& tables,const std::vector<float>& delays,
+		const std::string& name );
+	// Exact colors of frames if they fit, median cut over all of them if not.
+	static ColorTable MakeTable( const std::vector<const Surface*>& frames );
+	// Runs work( i ) for i up to count spread over the cores.
+	template<typename Work>
+	static void ForEach( int count,Work work );
+	// Table bits for count colors, at least 1.
+	static int GetTableBits( int count );
+	static void PutTable( std::ofstream& out,const ColorTable& table,int bits );
+	// LZW codes packed into data sub-blocks, terminator included.
+	static std::vector<uchar> Compress( const std::vector<uchar>& indices,
+		int minCodeSize );
+	static void PutShort( std::ofstream& out,uint v );
+};
\ No newline at end of file